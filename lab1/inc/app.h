@@ -2,6 +2,7 @@
 #include "automaton.h"
 #include "config.h"
 #include "render.h"
+#include "scheduler.h"
 #include "ui.h"
 #include <string>
 #include <windows.h>
@@ -27,6 +28,7 @@ private:
     void OnMouseUp();
 
     void ToggleRun(bool Run);
+    void StartTimer();
     void UpdateTitle() const;
     void ApplyRuleFromEdit();
     void SaveBmpDialog();
@@ -42,6 +44,7 @@ private:
 
     Automaton automaton;
     Renderer renderer;
+    StepScheduler scheduler;
     Ui ui;
 
     bool running;
@@ -1,13 +1,51 @@
 #pragma once
 #include "config.h"
+#include "rulecircuit.h"
 #include "utils.h"
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <unordered_set>
+#include <functional>
 #include <vector>
 
+struct BoundingBox {
+    int minX{0};
+    int minY{0};
+    int maxX{-1};
+    int maxY{-1};
+
+    inline bool Empty() const noexcept
+    {
+        return maxX < minX || maxY < minY;
+    }
+};
+
+enum class UpdateMode : uint8_t {
+    SYNCHRONOUS = 0,
+    // w * h single-cell updates per step at uniformly random positions, each seeing the latest grid.
+    RANDOM_SEQUENTIAL,
+    // Cells are split into colour classes with no two von Neumann neighbours sharing a class
+    // (2 classes, or 3 on a torus with an odd side); classes update one after another in place,
+    // each class in parallel.
+    CHECKERBOARD
+};
+
+// One generation as packed rows: one bit per cell, least significant bit first, each row padded
+// to whole 64-bit words. Only valid during the observer call that receives it.
+struct PackedFrame {
+    const uint64_t *bits;
+    int width;
+    int height;
+    int wordsPerRow;
+    uint32_t iteration;
+    std::size_t population;
+};
+
 class Automaton
 {
 public:
+    using Observer = std::function<void(const PackedFrame &)>;
+
     Automaton();
 
     void Resize(int w, int h);
@@ -30,15 +68,35 @@ public:
         return wrap;
     }
 
-    inline void SetRuleBits(uint16_t bits) noexcept
-    {
-        ruleBits = bits;
-    }
+    void SetRuleBits(uint16_t bits);
     inline uint16_t RuleBits() const noexcept
     {
         return ruleBits;
     }
 
+    inline void SetMode(UpdateMode m) noexcept
+    {
+        mode = m;
+    }
+    inline UpdateMode Mode() const noexcept
+    {
+        return mode;
+    }
+
+    // Probability that a cell in rule row `row` (curr * 5 + live neighbours, as in the rule bits)
+    // takes the rule's output; otherwise it keeps its state. All rows default to 1.
+    void SetTransitionProbability(int row, double p);
+    double TransitionProbability(int row) const;
+    bool Deterministic() const;
+
+    // Seeds Randomize() and the counter-based stream used by stochastic steps.
+    void SetSeed(uint64_t s);
+
+    inline void SetThreads(int n) noexcept
+    {
+        threads = n;
+    }
+
     inline uint32_t Iteration() const noexcept
     {
         return iter;
@@ -59,11 +117,12 @@ public:
         const uint8_t old = grid[i];
         const uint8_t nv = v ? 1u : 0u;
         if (old != nv) {
-            grid[i] = nv;
-            if (nv) {
-                active.insert(i);
-            } else {
-                active.erase(i);
+            ++version;
+            FlipCell(x, y);
+            // The active list may hold dead cells, only never miss a live one.
+            if (nv && activeValid) {
+                active.push_back(i);
+                activeValid = active.size() < grid.size();
             }
         }
     }
@@ -73,16 +132,88 @@ public:
         return grid;
     }
 
+    // Live-cell metrics, maintained by Set() and both step paths.
+    inline std::size_t Population() const noexcept
+    {
+        return population;
+    }
+    // Live cells with at least one dead von Neumann neighbour (off-grid counts as dead).
+    inline std::size_t FrontLength() const noexcept
+    {
+        return front;
+    }
+    inline const BoundingBox &Bounds() const noexcept
+    {
+        return bbox;
+    }
+    inline int RowOccupancy(int y) const
+    {
+        return rowCount[y];
+    }
+    inline int ColOccupancy(int x) const
+    {
+        return colCount[x];
+    }
+
+    // Change tracking for incremental consumers such as DensityPyramid: every mutation bumps
+    // Version(), and each TILE x TILE tile remembers the version that last changed it.
+    inline uint64_t Version() const noexcept
+    {
+        return version;
+    }
+    inline int TilesX() const noexcept
+    {
+        return tilesX;
+    }
+    inline int TilesY() const noexcept
+    {
+        return tilesY;
+    }
+    inline uint64_t TileStamp(int tx, int ty) const
+    {
+        return tileStamp[Utils::Index(tx, ty, tilesX)];
+    }
+
+    // Whole-grid exchange with caller-owned memory, row by row with rows `stride` bytes apart:
+    // one byte per cell (non-zero = live), or one bit per cell, least significant bit first.
+    // Loading keeps the iteration counter and the init grid.
+    void LoadCells(const uint8_t *cells, std::size_t stride);
+    void StoreCells(uint8_t *cells, std::size_t stride) const;
+    void LoadBits(const uint8_t *bits, std::size_t stride);
+    void StoreBits(uint8_t *bits, std::size_t stride) const;
+
     void Clear();
     void Randomize(double p);
     void SetInitFromCurrent();
     void ResetToInit();
-    void Step();
+    // Advances several generations in one call. Dense deterministic runs stay bit-packed
+    // between generations; the byte grid and metrics are exact again when it returns.
+    void Step(int generations);
+    inline void Step()
+    {
+        Step(1);
+    }
+    // Step() calls `fn` after every generation whose iteration is a multiple of `every`, from the
+    // stepping thread; dense runs hand it their packed grid without leaving the packed loop.
+    void SetObserver(Observer fn, int every);
 
 private:
+    friend class EditTransaction;
+    friend class Snapshot;
+
     void RebuildActive();
     int CountNeighbors4(int x, int y) const;
 
+    void FlipCell(int x, int y);
+    int FrontAround(int x, int y) const;
+    int FrontInRow(const std::vector<uint8_t> &g, int y) const;
+    void RecountMetrics();
+    inline void MarkTile(int x, int y)
+    {
+        tileStamp[Utils::Index(x >> Cfg::Pyramid::TILE_SHIFT, y >> Cfg::Pyramid::TILE_SHIFT, tilesX)] = version;
+    }
+    void BoundsFromCounts();
+
     inline uint8_t NextState(uint8_t curr, int nnz) const
     {
         const int idxRow = (curr ? Cfg::Automaton::RULE_ROWS_PER_CURR : 0) + nnz;  // 0..9
@@ -94,8 +225,35 @@ private:
         return ((ruleBits >> Cfg::Automaton::RULE_TOP_BIT_POS) & 1u) != 0u;  // (0,0)
     }
 
+    bool LooksDense() const;
+    void PackGrid();
+    const uint64_t *PackedRow(const std::vector<uint64_t> &g, int y) const;
+    void PackedGeneration();
+    void UnpackGrid();
+    void Notify(bool packedCurrent);
+
     void StepFull();
     void StepSparse();
+    void StepStochastic();
+    void StepRandomSequential();
+    void StepCheckerboard();
+    void FinishBulkStep();
+
+    // Rule output for a cell, accepted with the row's probability using random word `r`.
+    inline uint8_t StochasticState(uint8_t curr, int nnz, uint64_t r) const
+    {
+        const int idxRow = (curr ? Cfg::Automaton::RULE_ROWS_PER_CURR : 0) + nnz;
+        const uint8_t s = NextState(curr, nnz);
+        if (s == curr || accept[idxRow] >= Cfg::Async::ACCEPT_ALWAYS) {
+            return s;
+        }
+        return (r >> 32) < accept[idxRow] ? s : curr;
+    }
+    // Counter for the random word of cell i in the given phase of the current step.
+    inline uint64_t StreamCounter(int phase, int i) const noexcept
+    {
+        return ((static_cast<uint64_t>(iter) << 2 | static_cast<uint64_t>(phase)) << 32) + static_cast<uint64_t>(i);
+    }
 
 private:
     int w{0};
@@ -107,5 +265,39 @@ private:
     std::vector<uint8_t> grid;
     std::vector<uint8_t> next;
     std::vector<uint8_t> init;
-    std::unordered_set<int> active;
+    // Sparse stepping state. `active` lists every live cell (plus possibly stale dead ones) and
+    // is rebuilt lazily, only when a sparse step needs it.
+    std::vector<int> active;
+    bool activeValid{true};
+    std::vector<int> candidates;
+    std::vector<int> nextActive;
+    std::vector<int> changed;
+    std::vector<uint8_t> candMark;
+
+    // Packed-row stepping: one bit per cell, rows padded to whole words.
+    RuleCircuit circuit;
+    std::vector<uint64_t> packed;
+    std::vector<uint64_t> packedNext;
+    std::vector<uint64_t> rowPlanes;
+    std::vector<uint64_t> circuitScratch;
+
+    Observer observer;
+    int observeEvery{1};
+
+    UpdateMode mode{UpdateMode::SYNCHRONOUS};
+    std::array<uint64_t, Cfg::Automaton::RULE_BITS_COUNT> accept;
+    uint64_t seed{0};
+    Utils::SplitMix64 rng;
+    int threads{0};
+
+    std::size_t population{0};
+    std::size_t front{0};
+    BoundingBox bbox;
+    std::vector<int> rowCount;
+    std::vector<int> colCount;
+
+    uint64_t version{0};
+    int tilesX{0};
+    int tilesY{0};
+    std::vector<uint64_t> tileStamp;
 };
@@ -0,0 +1,55 @@
+#pragma once
+#include "config.h"
+#include <cstdint>
+
+// Bit-sliced evaluation of the 10-bit rule: every bit of a word is an independent cell.
+namespace BitRule
+{
+
+// Neighbour count 0..4 of four one-bit inputs as three bit-planes (count = b0 + 2*b1 + 4*b2).
+inline void Count4(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t &b0, uint64_t &b1, uint64_t &b2) noexcept
+{
+    const uint64_t s1 = a ^ b, c1 = a & b;
+    const uint64_t s2 = c ^ d, c2 = c & d;
+    const uint64_t c3 = s1 & s2;
+    b0 = s1 ^ s2;
+    b1 = c1 ^ c2 ^ c3;
+    b2 = (c1 & c2) | (c3 & (c1 | c2));
+}
+
+// Set rule entries as (curr, count) pairs, so the per-word loop only visits minterms that fire.
+struct Minterms {
+    uint64_t currSel[Cfg::Automaton::RULE_BITS_COUNT];
+    int count[Cfg::Automaton::RULE_BITS_COUNT];
+    int n{0};
+};
+
+inline Minterms MintermsOf(uint16_t ruleBits) noexcept
+{
+    Minterms m{};
+    for (int idxRow = 0; idxRow < Cfg::Automaton::RULE_BITS_COUNT; ++idxRow) {
+        const int bitpos = Cfg::Automaton::RULE_TOP_BIT_POS - idxRow;
+        if ((ruleBits >> bitpos) & 1u) {
+            m.currSel[m.n] = idxRow >= Cfg::Automaton::RULE_ROWS_PER_CURR ? ~0ull : 0ull;
+            m.count[m.n] = idxRow % Cfg::Automaton::RULE_ROWS_PER_CURR;
+            ++m.n;
+        }
+    }
+    return m;
+}
+
+inline uint64_t CountEquals(int n, uint64_t b0, uint64_t b1, uint64_t b2) noexcept
+{
+    return ((n & 1) ? b0 : ~b0) & ((n & 2) ? b1 : ~b1) & ((n & 4) ? b2 : ~b2);
+}
+
+inline uint64_t ApplyGeneric(const Minterms &m, uint64_t curr, uint64_t b0, uint64_t b1, uint64_t b2) noexcept
+{
+    uint64_t out = 0;
+    for (int k = 0; k < m.n; ++k) {
+        out |= ~(curr ^ m.currSel[k]) & CountEquals(m.count[k], b0, b1, b2);
+    }
+    return out;
+}
+
+}  // namespace BitRule
@@ -0,0 +1,147 @@
+#pragma once
+#include "automaton.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+enum class Connectivity : uint8_t {
+    FOUR,  // edge neighbours, as in the von Neumann rule
+    EIGHT  // edge and corner neighbours
+};
+
+struct Cluster {
+    int size{0};
+    // On a torus, a cluster connected across an edge is measured from its circular mean: its box
+    // then ends past the far edge (maxX >= width) and covers minX..maxX modulo the width, and
+    // one that wraps all the way round spans 0..width-1.
+    BoundingBox bbox;
+    // Mean cell position. On a torus it is the circular mean, so it lies in [0, width) and
+    // [0, height) and may be fractional near the seam, e.g. width - 0.5.
+    double cx{0.0};
+    double cy{0.0};
+};
+
+// Connected components of the live cells. Every row is split into runs of live cells; rows are
+// labelled in horizontal bands, one union-find over runs per thread, and the bands are then joined
+// along their border rows (and across the edges of a torus). Size, box and centroid come from
+// per-run sums, so only the run extraction touches every cell.
+//
+// Clusters are numbered in raster order of their first cell, whatever the thread count.
+class ClusterLabeller
+{
+public:
+    inline void SetConnectivity(Connectivity c) noexcept
+    {
+        conn = c;
+    }
+    // 0 = one per hardware thread.
+    inline void SetThreads(int t) noexcept
+    {
+        threads = t;
+    }
+
+    // Labels the current generation and returns the number of clusters.
+    int Label(const Automaton &a);
+
+    inline const std::vector<Cluster> &Clusters() const noexcept
+    {
+        return clusters;
+    }
+    // Cluster index of every cell (-1 for dead ones) for the last Label() call, built on first use.
+    const std::vector<int> &LabelMap();
+
+private:
+    struct Run {
+        int y;
+        int x0;  // inclusive
+        int x1;  // inclusive
+        int piece;
+    };
+
+    static constexpr uint8_t SEAM_X = 1;  // connected across the left/right edge
+    static constexpr uint8_t SEAM_Y = 2;  // connected across the top/bottom edge
+
+    // Accumulated over the runs of one band-local piece, then over the pieces of a cluster.
+    struct Sums {
+        int64_t count{0};
+        int64_t sumX{0};
+        int64_t sumY{0};
+        int minX{std::numeric_limits<int>::max()};
+        int maxX{std::numeric_limits<int>::min()};
+        int minY{std::numeric_limits<int>::max()};
+        int maxY{std::numeric_limits<int>::min()};
+        uint8_t seam{0};
+    };
+
+    // Clusters that cross a seam are measured again around their circular mean: first the angle
+    // sums, then offsets from the reference cell nearest that mean.
+    struct SeamSums {
+        double cosX{0.0};
+        double sinX{0.0};
+        double cosY{0.0};
+        double sinY{0.0};
+        int refX{0};
+        int refY{0};
+        int64_t sumDx{0};
+        int64_t sumDy{0};
+        int minDx{std::numeric_limits<int>::max()};
+        int maxDx{std::numeric_limits<int>::min()};
+        int minDy{std::numeric_limits<int>::max()};
+        int maxDy{std::numeric_limits<int>::min()};
+    };
+
+    struct Band {
+        int y0{0};
+        int y1{0};
+        std::vector<Run> runs;
+        std::vector<int> parent;
+        std::vector<int> rowStart;  // first run of every row, plus one past the end
+        std::vector<int> seamRuns;  // runs joined across the left/right edge
+        std::vector<uint64_t> mask;  // the current row packed to bits
+        std::vector<Sums> pieces;
+        std::vector<SeamSums> seam;  // per seam cluster, merged after each pass
+        int roots{0};
+        int firstCluster{0};
+    };
+
+    void PrepareTables();
+    void LabelBand(const Automaton &a, Band &band) const;
+    void JoinBands();
+    void CountRoots(Band &band, int offset) const;
+    void NumberRoots(Band &band, int offset);
+    void NumberClusters();
+    void SeamAngles(Band &band, int offset) const;
+    void SeamOffsets(Band &band, int offset) const;
+    void MergeSeam(bool offsets);
+    Cluster Measure(int k) const;
+    void Finish();
+
+private:
+    Connectivity conn{Connectivity::FOUR};
+    int threads{0};
+
+    int w{0};
+    int h{0};
+    bool wrap{true};
+    std::vector<Band> bands;
+    std::vector<int> pieceOffset;
+    std::vector<int> pieceParent;
+    std::vector<int> touched;  // pieces linked across a band border
+    std::vector<int> pieceCluster;
+    std::vector<Sums> sums;
+    std::vector<int> seamIndex;  // per cluster: index into seam, or -1
+    std::vector<SeamSums> seam;
+    std::vector<Cluster> clusters;
+
+    // Prefix sums of cos/sin of the column angle, and cos/sin of every row angle.
+    int tablesW{0};
+    int tablesH{0};
+    std::vector<double> cosPrefix;
+    std::vector<double> sinPrefix;
+    std::vector<double> cosRow;
+    std::vector<double> sinRow;
+
+    std::vector<int> labels;
+    bool labelsValid{false};
+};
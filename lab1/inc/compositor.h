@@ -0,0 +1,36 @@
+#pragma once
+#include "pyramid.h"
+#include <cstdint>
+#include <vector>
+
+class Automaton;
+
+// Colours are 0xAARRGGBB, the layout of a top-down 32-bit DIB.
+struct FrameStyle {
+    uint32_t color0{0xFFFFFFFFu};
+    uint32_t color1{0xFF000000u};
+    uint32_t gridColor{0xFFDCDCDCu};
+    uint8_t gridAlpha{255};
+    bool showGrid{false};
+};
+
+// Builds the final destination-resolution frame for a grid stretched over dstW x dstH pixels.
+// With at least one pixel per cell, cell colours are expanded 16 at a time (SSE2 where available),
+// replicated for the zoom and overlaid with grid lines; with more cells than pixels every pixel is
+// shaded by the density of the cells under it. The platform layer only has to blit the result.
+class Compositor
+{
+public:
+    void Compose(const Automaton &a, int dstW, int dstH, const FrameStyle &style, std::vector<uint32_t> &frame);
+
+private:
+    void ComposeCells(const Automaton &a, int dstW, int dstH, const FrameStyle &style, uint32_t *frame);
+    void ComposeDensity(const Automaton &a, int dstW, int dstH, const FrameStyle &style, uint32_t *frame);
+    void OverlayGrid(int srcW, int srcH, int dstW, int dstH, const FrameStyle &style, uint32_t *frame) const;
+
+private:
+    DensityPyramid pyramid;
+    std::vector<uint32_t> cellRow;  // one colour per cell of the current source row
+    std::vector<int> colOf;         // source column of every destination column
+    std::vector<uint8_t> density;
+};
@@ -1,6 +1,9 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 namespace Cfg
 {
@@ -53,6 +56,115 @@ inline constexpr int ACTIVE_RESERVE_DIVISOR = 8;
 inline constexpr int SPARSE_CANDIDATE_FACTOR = NEIGHBORS_VON_NEUMANN + 1;
 }  // namespace Automaton
 
+namespace Pyramid
+{
+// Change stamps are kept per TILE x TILE cells; a tile row spans whole packed words.
+inline constexpr int TILE_SHIFT = 6;
+inline constexpr int TILE = 1 << TILE_SHIFT;
+// The finest stored level counts 8x8 blocks; finer zoom levels read the grid directly.
+inline constexpr int BASE_SHIFT = 3;
+}  // namespace Pyramid
+
+namespace Circuit
+{
+inline constexpr int MAX_OPS = 48;
+// Covers are chosen exhaustively up to this many non-essential primes, greedily beyond it.
+inline constexpr int MAX_EXACT_PRIMES = 16;
+}  // namespace Circuit
+
+namespace Async
+{
+// Transition acceptance is compared against the top 32 bits of a counter-based random word.
+inline constexpr uint64_t ACCEPT_ALWAYS = 1ull << 32;
+// Rows below this many cells per thread are not worth a thread of their own.
+inline constexpr int MIN_CELLS_PER_THREAD = 1 << 14;
+}  // namespace Async
+
+namespace Edit
+{
+inline constexpr int BRUSH_RADIUS = 0;
+// A transaction touching at least 1/REBUILD_DIVISOR of the grid recounts the metrics with one
+// linear scan, and leaves the active list to be rebuilt, instead of updating them cell by cell.
+inline constexpr int REBUILD_DIVISOR = 16;
+}  // namespace Edit
+
+namespace Clusters
+{
+// Rows are labelled in bands of at least this many rows, one band per thread.
+inline constexpr int MIN_ROWS_PER_BAND = 64;
+inline constexpr int MIN_CLUSTERS_PER_THREAD = 1 << 14;
+}  // namespace Clusters
+
+namespace Schedule
+{
+// Weight of the newest frame in the seconds-per-generation estimate.
+inline constexpr double SMOOTHING = 0.25;
+inline constexpr int MAX_GROWTH = 2;
+inline constexpr int MAX_GENERATIONS_PER_FRAME = 1 << 16;
+inline constexpr double RATE_WINDOW_SECONDS = 0.5;
+}  // namespace Schedule
+
+namespace Snapshot
+{
+inline constexpr char MAGIC[8] = {'C', 'R', 'Y', 'S', 'T', 'A', 'L', 'I'};
+inline constexpr uint32_t VERSION = 1;
+}  // namespace Snapshot
+
+namespace Publish
+{
+inline constexpr char MAGIC[8] = {'C', 'R', 'Y', 'S', 'R', 'I', 'N', 'G'};
+inline constexpr uint32_t VERSION = 1;
+// Slots and the ring header start on their own cache lines.
+inline constexpr std::size_t CACHE_LINE = 64;
+inline constexpr int DEFAULT_SLOTS = 8;
+inline constexpr int MAX_SLOTS = 1 << 16;
+}  // namespace Publish
+
+namespace Run
+{
+inline constexpr int DEFAULT_GENERATIONS = 1000;
+inline constexpr int CHECKPOINT_SECONDS = 300;
+inline constexpr int PROGRESS_SECONDS = 5;
+// Generations per Step(n) call between progress and checkpoint checks.
+inline constexpr int BATCH_GENERATIONS = 16;
+}  // namespace Run
+
+namespace Bench
+{
+inline constexpr int GRID_SIZES[] = {1024, 2048, 4096, 8192};
+inline constexpr int VIEW_W = 1920;
+inline constexpr int VIEW_H = 1080;
+inline constexpr int MAX_ZOOMED_SIDE = 4096;
+inline constexpr double SECONDS_PER_CASE = 1.0;
+}  // namespace Bench
+
+namespace Ensemble
+{
+inline constexpr int WORD_BITS = 64;
+inline constexpr int DEFAULT_LANES = 64;
+inline constexpr int RANDOM_PRECISION_BITS = 16;
+}  // namespace Ensemble
+
+namespace Search
+{
+inline constexpr int DEFAULT_BOX = 4;
+inline constexpr int DEFAULT_PERIOD = 2;
+inline constexpr int MAX_BOX_CELLS = 40;
+inline constexpr int LANES = 256;
+inline constexpr uint64_t CHUNK_SIZE = 1ull << 14;
+inline constexpr int CHECKPOINT_SECONDS = 60;
+inline constexpr int PROGRESS_SECONDS = 5;
+}  // namespace Search
+
+namespace Predecessor
+{
+inline constexpr int BRANCHES_PER_THREAD = 8;
+inline constexpr uint64_t NODES_PER_FLUSH = 1024;
+inline constexpr int POLL_MS = 50;
+inline constexpr int PROGRESS_SECONDS = 1;
+}  // namespace Predecessor
+
+#ifdef _WIN32
 namespace Render
 {
 inline constexpr COLORREF COLOR0 = RGB(255, 255, 255);
@@ -74,12 +186,18 @@ namespace Timer
 {
 inline constexpr UINT ID = 1;
 inline constexpr UINT DEFAULT_TICK_MS = 120;
-inline constexpr int SPEED_OPTIONS[] = {25, 60, 120, 250, 500};
-inline constexpr int SPEED_DEFAULT_INDEX = 2;
+// SPEED_MAX ticks every FRAME_MS and runs as many generations as fit in MAX_SPEED_BUDGET_MS.
+inline constexpr int SPEED_MAX = 0;
+inline constexpr UINT FRAME_MS = 16;
+inline constexpr int MAX_SPEED_BUDGET_MS = 12;
+inline constexpr int SPEED_OPTIONS[] = {SPEED_MAX, 25, 60, 120, 250, 500};
+inline constexpr int SPEED_DEFAULT_INDEX = 3;
 }  // namespace Timer
+#endif
 
 }  // namespace Cfg
 
+#ifdef _WIN32
 enum class CtrlId : int {
     RULE_EDIT = 1001,
     RULE_APPLY,
@@ -94,3 +212,4 @@ enum class CtrlId : int {
     WRAP,
     GRID
 };
+#endif
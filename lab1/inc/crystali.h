@@ -0,0 +1,99 @@
+#pragma once
+/* C interface to the simulation core, for embedding in other hosts and languages.
+ *
+ * An automaton is an opaque handle. Every call on a handle takes that instance's lock, so
+ * separate instances can be stepped from separate threads and one instance can be shared
+ * between threads. Nothing here allocates on behalf of the caller: state is read from and
+ * written to caller-owned buffers.
+ *
+ * Link against crystali_shared (defines CRYSTALI_SHARED for importers) or crystali_core. */
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(CRYSTALI_EXPORTS)
+#define CRYSTALI_API __declspec(dllexport)
+#elif defined(CRYSTALI_SHARED)
+#define CRYSTALI_API __declspec(dllimport)
+#else
+#define CRYSTALI_API
+#endif
+#else
+#define CRYSTALI_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct crystali_automaton crystali_automaton;
+
+typedef enum crystali_status {
+    CRYSTALI_OK = 0,
+    CRYSTALI_INVALID_ARGUMENT = 1,
+    CRYSTALI_OUT_OF_MEMORY = 2,
+    CRYSTALI_IO_ERROR = 3,
+    CRYSTALI_INTERNAL_ERROR = 4
+} crystali_status;
+
+typedef enum crystali_mode {
+    CRYSTALI_MODE_SYNCHRONOUS = 0,
+    CRYSTALI_MODE_RANDOM_SEQUENTIAL = 1,
+    CRYSTALI_MODE_CHECKERBOARD = 2
+} crystali_mode;
+
+/* Cell layout of a state buffer: rows of `stride` bytes, row 0 first. */
+typedef enum crystali_layout {
+    CRYSTALI_LAYOUT_BYTES = 0, /* one byte per cell, non-zero = live; stride >= width */
+    CRYSTALI_LAYOUT_BITS = 1   /* one bit per cell, LSB first; stride >= (width + 7) / 8 */
+} crystali_layout;
+
+typedef struct crystali_stats {
+    uint32_t iteration;
+    uint64_t population;
+    uint64_t front;   /* live cells with a dead von Neumann neighbour */
+    uint64_t version; /* changes whenever the grid does */
+    int32_t min_x;    /* bounding box of the live cells; max < min when empty */
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+} crystali_stats;
+
+/* Returns NULL if the size is not positive or memory runs out. The grid starts empty, as a
+ * torus, with the default rule. */
+CRYSTALI_API crystali_automaton *crystali_create(int32_t width, int32_t height);
+CRYSTALI_API void crystali_destroy(crystali_automaton *a);
+
+/* Clears the grid and resets the iteration counter. */
+CRYSTALI_API crystali_status crystali_resize(crystali_automaton *a, int32_t width, int32_t height);
+CRYSTALI_API crystali_status crystali_get_size(crystali_automaton *a, int32_t *width, int32_t *height);
+
+/* rule: 0..1023, the 10-bit rule number. */
+CRYSTALI_API crystali_status crystali_set_rule(crystali_automaton *a, uint32_t rule);
+CRYSTALI_API crystali_status crystali_set_wrap(crystali_automaton *a, int wrap);
+CRYSTALI_API crystali_status crystali_set_mode(crystali_automaton *a, crystali_mode mode);
+CRYSTALI_API crystali_status crystali_set_seed(crystali_automaton *a, uint64_t seed);
+/* Threads used by the parallel update modes; 0 = one per hardware thread. */
+CRYSTALI_API crystali_status crystali_set_threads(crystali_automaton *a, int32_t threads);
+
+/* Replaces the grid from `size` bytes at `cells`. The iteration counter is kept. */
+CRYSTALI_API crystali_status crystali_load_state(crystali_automaton *a, const void *cells, size_t size,
+                                                 size_t stride, crystali_layout layout);
+/* Writes the grid to `size` bytes at `cells`; padding past the last cell of a row is left alone
+ * in the byte layout and zeroed within the last byte in the bit layout. */
+CRYSTALI_API crystali_status crystali_store_state(crystali_automaton *a, void *cells, size_t size, size_t stride,
+                                                  crystali_layout layout);
+
+CRYSTALI_API crystali_status crystali_step(crystali_automaton *a, int32_t generations);
+CRYSTALI_API crystali_status crystali_get_stats(crystali_automaton *a, crystali_stats *stats);
+
+/* Checkpoints in the crystali_run snapshot format. */
+CRYSTALI_API crystali_status crystali_save_snapshot(crystali_automaton *a, const char *path);
+CRYSTALI_API crystali_status crystali_load_snapshot(crystali_automaton *a, const char *path);
+
+/* Static string for a status code. */
+CRYSTALI_API const char *crystali_status_string(crystali_status status);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+#include "automaton.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+enum class BlitMode : uint8_t {
+    REPLACE = 0,
+    OR,
+    XOR
+};
+
+// Batched editing of an Automaton. Operations write straight into the grid and log the cells
+// they change; Commit() (or the destructor) brings the active set and the live-cell metrics up
+// to date once for the whole batch. Coordinates outside the grid are clipped.
+class EditTransaction
+{
+public:
+    explicit EditTransaction(Automaton &target);
+    ~EditTransaction();
+
+    EditTransaction(const EditTransaction &) = delete;
+    EditTransaction &operator=(const EditTransaction &) = delete;
+
+    void Cell(int x, int y, uint8_t v);
+    void Rect(int x0, int y0, int x1, int y1, uint8_t v);  // inclusive corners, any order
+    void Line(int x0, int y0, int x1, int y1, uint8_t v);
+    void Disc(int cx, int cy, int radius, uint8_t v);
+    // Brush of the given radius swept from one mouse sample to the next (a capsule).
+    void Stroke(int x0, int y0, int x1, int y1, int radius, uint8_t v);
+    // Row-major pattern of pw x ph bytes with its top-left corner at (x, y).
+    void Blit(const uint8_t *pattern, int pw, int ph, int x, int y, BlitMode mode);
+
+    void Commit();
+
+private:
+    inline void Put(int i, uint8_t v)
+    {
+        const uint8_t old = a.grid[i];
+        if (old != v) {
+            log.emplace_back(i, old);
+            a.grid[i] = v;
+        }
+    }
+    void Span(int y, int x0, int x1, uint8_t v);
+
+private:
+    Automaton &a;
+    std::vector<std::pair<int, uint8_t>> log;  // (cell index, value before its first change)
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include "config.h"
+#include "rulecircuit.h"
+#include "utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Many independent automata of the same size and rule, stepped together. Every cell holds
+// `blocks` 64-bit words and bit k of the cell is that cell's state in lane k, so one pass of
+// bitwise logic advances all lanes. Blocks of a cell are contiguous, which lets the compiler
+// widen the per-cell loop to SSE/AVX registers for 128 or 256 lanes.
+class Ensemble
+{
+public:
+    struct LaneResult {
+        uint32_t population{0};
+        int32_t haltedAt{-1};  // iteration at which the lane became periodic, -1 while running
+        uint8_t period{0};     // 1 for still states (including extinction), 2 for blinkers
+    };
+
+    Ensemble();
+
+    void Resize(int w, int h, int lanes);
+
+    inline int Width() const noexcept
+    {
+        return w;
+    }
+    inline int Height() const noexcept
+    {
+        return h;
+    }
+    inline int Lanes() const noexcept
+    {
+        return blocks * Cfg::Ensemble::WORD_BITS;
+    }
+
+    inline void SetWrap(bool Wrap) noexcept
+    {
+        wrap = Wrap;
+    }
+    inline bool Wrap() const noexcept
+    {
+        return wrap;
+    }
+
+    void SetRuleBits(uint16_t bits);
+    inline uint16_t RuleBits() const noexcept
+    {
+        return ruleBits;
+    }
+
+    inline uint32_t Iteration() const noexcept
+    {
+        return iter;
+    }
+
+    inline void Seed(uint64_t seed) noexcept
+    {
+        rng.state = seed;
+    }
+
+    uint8_t Cell(int lane, int x, int y) const;
+    void Set(int lane, int x, int y, uint8_t v);
+
+    // Lane contents as one byte per cell in row-major order, the layout of Automaton::Data().
+    void LoadLane(int lane, const std::vector<uint8_t> &cells);
+    void StoreLane(int lane, std::vector<uint8_t> &cells) const;
+
+    void Clear();
+    void Randomize(double p);
+    void Step();
+    int Run(int maxGens);
+
+    inline bool Halted(int lane) const
+    {
+        return haltedAt[lane] >= 0;
+    }
+    inline int RunningLanes() const noexcept
+    {
+        return running;
+    }
+
+    // Raw lane words, `blocks` consecutive words per cell in row-major cell order.
+    inline const std::vector<uint64_t> &Words() const noexcept
+    {
+        return grid;
+    }
+
+    std::vector<uint32_t> Populations() const;
+    std::vector<LaneResult> Results() const;
+
+private:
+    inline std::size_t WordIndex(int x, int y) const noexcept
+    {
+        return static_cast<std::size_t>(Utils::Index(x, y, w)) * static_cast<std::size_t>(blocks);
+    }
+
+    void ResetHalting();
+    void ResetLaneHalting(int lane);
+
+private:
+    int w{0};
+    int h{0};
+    int blocks{0};
+    bool wrap{true};
+    uint16_t ruleBits{Cfg::Automaton::DEFAULT_RULE};
+    uint32_t iter{0};
+    int running{0};
+
+    std::vector<uint64_t> grid;
+    std::vector<uint64_t> next;
+    std::vector<uint64_t> prev;
+    std::vector<uint64_t> zeros;
+    std::vector<uint64_t> prevValid;
+
+    std::vector<int32_t> haltedAt;
+    std::vector<uint8_t> period;
+
+    Utils::SplitMix64 rng;
+
+    RuleCircuit circuit;
+    std::vector<uint64_t> planes;  // neighbour-count bit-planes of one row
+    std::vector<uint64_t> circuitScratch;
+};
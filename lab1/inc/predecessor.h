@@ -0,0 +1,70 @@
+#pragma once
+#include "config.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Automaton;
+
+enum class PredecessorStatus : int {
+    FOUND = 0,
+    NONE,  // proved: the target has no predecessor (Garden of Eden for k = 1)
+    TIMEOUT
+};
+
+struct PredecessorOptions {
+    uint16_t ruleBits{Cfg::Automaton::DEFAULT_RULE};
+    bool wrap{true};
+    int generations{1};
+    int threads{0};          // 0 = one per hardware thread
+    double timeoutSec{0.0};  // 0 = no limit
+};
+
+struct PredecessorProgress {
+    uint64_t nodes{0};
+    int deepest{0};  // most decisions on one search path so far
+    int pendingBranches{0};
+    double elapsedSec{0.0};
+};
+
+// Backward search: finds a grid that reaches the target after `generations` steps under the
+// given rule and wrap mode, or proves that none exists. Every cell of every earlier generation
+// is a boolean variable and every cell of every later generation a constraint
+// rule(x_c, sum of x over N(c)) = y_c, where y is the target or the next generation's variable.
+// It is solved by propagation over the 5-cell scopes and depth-first branching; the root is split
+// into independent branches that worker threads explore in parallel.
+class PredecessorSearch
+{
+public:
+    explicit PredecessorSearch(const PredecessorOptions &opt);
+
+    static PredecessorOptions OptionsFrom(const Automaton &a, int generations);
+
+    PredecessorStatus Run(const std::vector<uint8_t> &target,
+                          int w,
+                          int h,
+                          std::vector<uint8_t> &out,
+                          const std::function<void(const PredecessorProgress &)> &onProgress);
+
+    inline uint64_t Nodes() const noexcept
+    {
+        return nodes.load();
+    }
+
+private:
+    bool Expired() const;
+
+private:
+    PredecessorOptions opt;
+    int w{0};
+    int h{0};
+    std::vector<int> nb;  // 4 neighbour indices per cell, -1 outside a bounded grid
+
+    std::atomic<uint64_t> nodes{0};
+    std::atomic<bool> timedOut{false};
+    std::atomic<int> pending{0};
+    std::atomic<int> deepest{0};
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class Automaton;
+
+// Mip levels of live-cell counts: level k holds the count of every 2^k x 2^k block, for
+// k = Cfg::Pyramid::BASE_SHIFT up to the level where one block covers the whole grid. Update()
+// only recounts the tiles the automaton stamped as changed since the previous update, and their
+// ancestors; Resample() then shades a destination raster in time proportional to its size.
+class DensityPyramid
+{
+public:
+    void Update(const Automaton &a);
+
+    // Live-cell density 0..255 of the grid area under every pixel of a dstW x dstH raster that
+    // shows the whole grid. Meant for zoomed-out views (more than one cell per pixel).
+    void Resample(const Automaton &a, int dstW, int dstH, std::vector<uint8_t> &density) const;
+
+    inline int Levels() const noexcept
+    {
+        return static_cast<int>(levels.size());
+    }
+    // Count of block (bx, by) at level BASE_SHIFT + index.
+    uint32_t Count(int index, int bx, int by) const;
+
+private:
+    struct Level {
+        int w{0};
+        int h{0};
+        std::vector<uint32_t> counts;
+    };
+
+    void Rebuild(const Automaton &a);
+    void CountBaseBlocks(const Automaton &a, int bx0, int by0, int bx1, int by1);
+    void SumChildren(int k, int bx0, int by0, int bx1, int by1);
+
+private:
+    int w{0};
+    int h{0};
+    uint64_t builtVersion{0};
+    std::vector<Level> levels;
+};
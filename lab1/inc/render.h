@@ -1,5 +1,7 @@
 #pragma once
 #include "automaton.h"
+#include "compositor.h"
+#include <vector>
 #include <windows.h>
 
 class Renderer
@@ -10,4 +12,8 @@ public:
     void Paint(HDC hdc, const RECT &drawRc, const Automaton &a, COLORREF c0, COLORREF c1, bool showGrid) const;
 
     bool SaveGridBmp(const Automaton &a, const wchar_t *path, int scale, COLORREF c0, COLORREF c1) const;
+
+private:
+    mutable Compositor compositor;
+    mutable std::vector<uint32_t> frame;
 };
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A rule compiled to a straight-line bitwise program over the bit-planes of one generation:
+// the current state and the neighbour count as b0 + 2*b1 + 4*b2. The truth table over
+// (curr, b2, b1, b0) is minimised with Quine-McCluskey, treating the impossible counts 5..7 as
+// don't-cares, and the cheaper of the function and its complement is emitted.
+class RuleCircuit
+{
+public:
+    enum class Op : uint8_t {
+        AND = 0,
+        OR,
+        ANDNOT,  // a & ~b
+        NOT,
+        ZERO,
+        ONE
+    };
+
+    struct Instr {
+        Op op;
+        uint8_t dst;
+        uint8_t a;
+        uint8_t b;
+    };
+
+    // Registers 0..3 hold the inputs; every instruction writes a fresh register.
+    static constexpr int REG_CURR = 0;
+    static constexpr int REG_B0 = 1;
+    static constexpr int REG_B1 = 2;
+    static constexpr int REG_B2 = 3;
+    static constexpr int INPUTS = 4;
+
+    // Returns false (and leaves the circuit unusable) if the program would exceed
+    // Cfg::Circuit::MAX_OPS; callers then fall back to BitRule::ApplyGeneric.
+    bool Compile(uint16_t ruleBits);
+
+    inline bool Valid() const noexcept
+    {
+        return valid;
+    }
+    inline int Ops() const noexcept
+    {
+        return static_cast<int>(code.size());
+    }
+
+    // Evaluates the program over n words of each input plane. `scratch` is resized as needed and
+    // can be reused between calls to avoid allocation.
+    void Run(const uint64_t *curr,
+             const uint64_t *b0,
+             const uint64_t *b1,
+             const uint64_t *b2,
+             uint64_t *out,
+             std::size_t n,
+             std::vector<uint64_t> &scratch) const;
+
+    // The program as an expression, e.g. "b0 | b1 | b2".
+    std::string ToString() const;
+
+private:
+    std::vector<Instr> code;
+    int result{0};
+    bool valid{false};
+};
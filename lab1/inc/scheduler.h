@@ -0,0 +1,55 @@
+#pragma once
+#include <functional>
+
+// Decides how many generations each frame runs so that stepping fills a time budget. The cost of
+// a generation is a moving average over the previous frames; the achieved rate is measured over
+// Cfg::Schedule::RATE_WINDOW_SECONDS of wall time, rendering included. The clock is injectable so
+// the policy can be driven by a fake one.
+class StepScheduler
+{
+public:
+    using Clock = std::function<double()>;  // monotonic seconds
+
+    StepScheduler();
+    explicit StepScheduler(Clock clock);
+
+    // Seconds of stepping per frame; 0 runs exactly one generation per frame.
+    inline void SetBudget(double seconds) noexcept
+    {
+        budget = seconds;
+    }
+    inline double Budget() const noexcept
+    {
+        return budget;
+    }
+
+    // Forgets the cost estimate and the rate, e.g. when a run is restarted.
+    void Reset();
+
+    // Generations the next frame will run.
+    int Plan() const;
+    // Runs this frame's generations as one step(n) call and returns n.
+    int RunFrame(const std::function<void(int)> &step);
+
+    inline double GenerationsPerSecond() const noexcept
+    {
+        return rate;
+    }
+    // 0 until a frame took measurable time.
+    inline double SecondsPerGeneration() const noexcept
+    {
+        return perGen;
+    }
+
+    static double SteadySeconds();
+
+private:
+    Clock clock;
+    double budget{0.0};
+    double perGen{0.0};
+    int lastBatch{0};
+
+    double windowStart{-1.0};
+    long long windowGens{0};
+    double rate{0.0};
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include "config.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+struct SearchPattern {
+    int w{0};
+    int h{0};
+    int period{0};
+    std::vector<uint8_t> cells;  // row-major, one byte per cell
+};
+
+struct SearchOptions {
+    uint16_t ruleBits{Cfg::Automaton::DEFAULT_RULE};
+    int boxW{Cfg::Search::DEFAULT_BOX};
+    int boxH{Cfg::Search::DEFAULT_BOX};
+    int maxPeriod{Cfg::Search::DEFAULT_PERIOD};
+    int threads{0};  // 0 = one per hardware thread
+    std::string checkpointPath;
+    int checkpointSeconds{Cfg::Search::CHECKPOINT_SECONDS};
+};
+
+struct SearchProgress {
+    uint64_t done{0};
+    uint64_t total{0};
+    std::size_t found{0};
+};
+
+// Exhaustive search for still lifes and oscillators (period <= maxPeriod) that fit in a
+// boxW x boxH box on an empty plane. Candidates are pruned by translation and by the box
+// symmetries, evaluated 256 at a time on the bit-parallel Ensemble, and deduplicated across
+// symmetries and oscillator phases in a result set shared by all worker threads. Progress is
+// checkpointed as "every candidate below index N is done" plus the results so far.
+class PatternSearch
+{
+public:
+    explicit PatternSearch(const SearchOptions &opt);
+
+    bool Validate(std::string &err) const;
+
+    // Loads the checkpoint if one exists for the same rule, box and period.
+    bool Resume(std::string &err);
+
+    bool Run(std::string &err);
+
+    SearchProgress Progress() const;
+    std::vector<SearchPattern> Results() const;
+
+private:
+    void Worker();
+    bool Accept(uint64_t idx) const;
+    void Evaluate(class Ensemble &e, const std::vector<uint64_t> &cands);
+    void AddResult(uint64_t idx, int period);
+    void MarkDone(uint64_t chunk);
+    bool WriteCheckpoint(std::string &err) const;
+
+private:
+    SearchOptions opt;
+    int margin{0};
+    uint64_t total{0};
+    uint64_t numChunks{0};
+    std::vector<std::vector<int>> symmetries;
+
+    std::atomic<uint64_t> nextChunk{0};
+
+    mutable std::mutex mtx;
+    uint64_t watermark{0};  // every chunk below this one has been evaluated
+    std::set<uint64_t> doneAbove;
+    std::map<std::string, SearchPattern> results;
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Automaton;
+struct PackedFrame;
+
+// Ring of published generations in a named shared-memory segment (POSIX shm_open, or a
+// pagefile-backed mapping on Windows). One writer, any number of readers, no locks: every slot is
+// a seqlock whose counter is odd while the slot is being written, so the writer never waits and
+// a reader that falls more than a ring behind just skips the frames it missed.
+//
+//   ShmRingHeader | slot 0 | slot 1 | ...      slot = ShmSlotHeader | grid bits
+//
+// Grid bits are row-major, one bit per cell with the least significant bit first, and every row
+// padded to whole 64-bit words. Shared fields are read and written with atomic word accesses.
+struct ShmRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+    int32_t width;
+    int32_t height;
+    uint32_t wordsPerRow;
+    uint32_t headerSize;
+    uint64_t slotBytes;  // distance between slots, a multiple of the cache line
+    uint64_t published;  // frames published so far; frame f lives in slot f % slots
+};
+
+struct ShmSlotHeader {
+    uint64_t seq;  // 2f + 1 while frame f is written into the slot, 2f + 2 once it is complete
+    uint64_t iteration;
+    uint64_t population;
+    uint64_t reserved;
+};
+
+// A frame copied out of the ring.
+struct ShmFrame {
+    uint64_t sequence{0};  // publication number, from 0
+    uint64_t iteration{0};
+    uint64_t population{0};
+    int width{0};
+    int height{0};
+    int wordsPerRow{0};
+    std::vector<uint64_t> bits;
+
+    inline bool Cell(int x, int y) const
+    {
+        return (bits[static_cast<std::size_t>(y) * wordsPerRow + (x >> 6)] >> (x & 63)) & 1u;
+    }
+};
+
+class ShmRingWriter
+{
+public:
+    ShmRingWriter() = default;
+    ShmRingWriter(const ShmRingWriter &) = delete;
+    ShmRingWriter &operator=(const ShmRingWriter &) = delete;
+    ~ShmRingWriter();
+
+    // Creates (or replaces) the segment for a w x h grid. Readers of a replaced segment keep
+    // their old mapping and stop seeing new frames.
+    bool Create(const std::string &name, int w, int h, int slots, std::string &err);
+    // Unmaps and removes the segment.
+    void Close();
+    inline bool IsOpen() const noexcept
+    {
+        return base != nullptr;
+    }
+
+    // Writes a generation into the next slot, packing the byte grid or copying the packed rows
+    // an Automaton observer receives. Fails only if the grid size no longer matches the ring.
+    bool Publish(const Automaton &a);
+    bool Publish(const PackedFrame &frame);
+
+private:
+    ShmSlotHeader *BeginSlot(uint64_t iteration, uint64_t population);
+    void EndSlot(ShmSlotHeader *slot);
+
+    std::string name;
+    uint8_t *base{nullptr};
+    std::size_t size{0};
+    ShmRingHeader *hdr{nullptr};
+    uint64_t next{0};
+#ifdef _WIN32
+    void *mapping{nullptr};
+#endif
+};
+
+class ShmRingReader
+{
+public:
+    ShmRingReader() = default;
+    ShmRingReader(const ShmRingReader &) = delete;
+    ShmRingReader &operator=(const ShmRingReader &) = delete;
+    ~ShmRingReader();
+
+    bool Attach(const std::string &name, std::string &err);
+    void Detach();
+
+    // Copies the frame after the last one read. A reader that fell behind resumes at the oldest
+    // frame still in the ring. Returns false if no newer frame is complete yet.
+    bool Next(ShmFrame &out);
+    // Copies the newest complete frame, skipping everything in between.
+    bool Latest(ShmFrame &out);
+
+    // Frames published but never returned because this reader was too slow.
+    inline uint64_t Skipped() const noexcept
+    {
+        return skipped;
+    }
+
+private:
+    bool TryRead(uint64_t frame, ShmFrame &out) const;
+    bool ReadFrom(uint64_t frame, ShmFrame &out);
+
+    const uint8_t *base{nullptr};
+    std::size_t size{0};
+    const ShmRingHeader *hdr{nullptr};
+    uint64_t next{0};
+    uint64_t skipped{0};
+#ifdef _WIN32
+    void *mapping{nullptr};
+#endif
+};
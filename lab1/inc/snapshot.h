@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class Automaton;
+
+// Versioned binary checkpoint of a whole Automaton: grid and init as packed bits, rule, wrap,
+// update mode, transition probabilities, iteration and RNG state. Integers are stored in the
+// native (little-endian) byte order.
+//
+//   SnapshotHeader | grid bits | init bits      (each ceil(w*h / 64) words, row-major)
+class Snapshot
+{
+public:
+    // Writes next to the target and renames over it, so a crash never leaves a torn file.
+    static bool Save(const Automaton &a, const std::string &path, std::string &err);
+
+    // Maps the file and unpacks it straight into the automaton.
+    static bool Load(Automaton &a, const std::string &path, std::string &err);
+};
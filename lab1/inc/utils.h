@@ -20,4 +20,31 @@ inline constexpr int Index(int x, int y, int w) noexcept
     return y * w + x;
 }
 
+// Runs fn over [0, n) split into contiguous ranges, one per thread (0 = one per hardware
+// thread). Small ranges run on the calling thread.
+void ParallelFor(int n, int threads, int minPerThread, const std::function<void(int begin, int end)> &fn);
+
+// SplitMix64: seedable 64-bit generator whose whole state is a single word.
+struct SplitMix64 {
+    uint64_t state{0};
+
+    inline uint64_t Next() noexcept
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+// Counter-based generator: the value for a counter depends only on (seed, counter), so bulk
+// draws can be made in any order and on any thread with reproducible results.
+inline uint64_t CounterRandom(uint64_t seed, uint64_t counter) noexcept
+{
+    uint64_t z = seed + (counter + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
 }  // namespace Utils
@@ -1,5 +1,6 @@
 #include "app.h"
 #include "config.h"
+#include "edit.h"
 #include "utils.h"
 
 #include <algorithm>
@@ -189,7 +190,8 @@ void App::OnTimer()
     if (!running) {
         return;
     }
-    automaton.Step();
+    // Only the last of the frame's generations gets painted.
+    scheduler.RunFrame([this](int n) { automaton.Step(n); });
     UpdateTitle();
     InvalidateRect(hwnd, &drawRc, FALSE);
 }
@@ -246,7 +248,7 @@ void App::OnCommand(WORD id, WORD code)
                 tickMs = (UINT)ui.SpeedMs();
                 if (running) {
                     KillTimer(hwnd, Cfg::Timer::ID);
-                    SetTimer(hwnd, Cfg::Timer::ID, tickMs, nullptr);
+                    StartTimer();
                 }
             }
             break;
@@ -276,12 +278,10 @@ void App::OnMouseDown(UINT msg, LPARAM lParam)
     const int sy = GET_Y_LPARAM(lParam);
     int gx, gy;
     if (ScreenToCell(sx, sy, gx, gy)) {
-        if (gx != lastGx || gy != lastGy) {
-            automaton.Set(gx, gy, paintVal);
-            lastGx = gx;
-            lastGy = gy;
-            InvalidateRect(hwnd, &drawRc, FALSE);
-        }
+        EditTransaction(automaton).Disc(gx, gy, Cfg::Edit::BRUSH_RADIUS, paintVal);
+        lastGx = gx;
+        lastGy = gy;
+        InvalidateRect(hwnd, &drawRc, FALSE);
     }
 }
 
@@ -295,7 +295,13 @@ void App::OnMouseMove(LPARAM lParam)
     int gx, gy;
     if (ScreenToCell(sx, sy, gx, gy)) {
         if (gx != lastGx || gy != lastGy) {
-            automaton.Set(gx, gy, paintVal);
+            // Mouse samples can be many cells apart on a fast drag; sweep the brush between them.
+            EditTransaction edit(automaton);
+            if (lastGx < 0) {
+                edit.Disc(gx, gy, Cfg::Edit::BRUSH_RADIUS, paintVal);
+            } else {
+                edit.Stroke(lastGx, lastGy, gx, gy, Cfg::Edit::BRUSH_RADIUS, paintVal);
+            }
             lastGx = gx;
             lastGy = gy;
             InvalidateRect(hwnd, &drawRc, FALSE);
@@ -318,7 +324,7 @@ void App::ToggleRun(bool run)
     running = run;
     if (running) {
         tickMs = (UINT)ui.SpeedMs();
-        SetTimer(hwnd, Cfg::Timer::ID, tickMs, nullptr);
+        StartTimer();
     } else {
         KillTimer(hwnd, Cfg::Timer::ID);
     }
@@ -326,11 +332,25 @@ void App::ToggleRun(bool run)
     UpdateTitle();
 }
 
+void App::StartTimer()
+{
+    // Fixed speeds run one generation per tick; Max ticks every frame and fills a time budget.
+    const bool maxSpeed = static_cast<int>(tickMs) == Cfg::Timer::SPEED_MAX;
+    scheduler.Reset();
+    scheduler.SetBudget(maxSpeed ? Cfg::Timer::MAX_SPEED_BUDGET_MS / 1000.0 : 0.0);
+    SetTimer(hwnd, Cfg::Timer::ID, maxSpeed ? Cfg::Timer::FRAME_MS : tickMs, nullptr);
+}
+
 void App::UpdateTitle() const
 {
+    wchar_t rate[64] = L"";
+    if (running && scheduler.GenerationsPerSecond() > 0.0) {
+        swprintf(rate, 64, L" — %.0f gen/s", scheduler.GenerationsPerSecond());
+    }
     wchar_t buf[256];
-    swprintf(buf, 256, L"Crystali — Rule %u — Iteration %u%s%s", (unsigned)automaton.RuleBits(),
-             (unsigned)automaton.Iteration(), automaton.Wrap() ? L" — Wrap" : L"", showGrid ? L" — Grid" : L"");
+    swprintf(buf, 256, L"Crystali — Rule %u — Iteration %u%s%s%s", (unsigned)automaton.RuleBits(),
+             (unsigned)automaton.Iteration(), automaton.Wrap() ? L" — Wrap" : L"", showGrid ? L" — Grid" : L"",
+             rate);
     SetWindowTextW(hwnd, buf);
 }
 
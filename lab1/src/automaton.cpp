@@ -1,32 +1,68 @@
 #include "automaton.h"
+#include "bitrule.h"
 #include "config.h"
 #include "utils.h"
 
 #include <algorithm>
-#include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <unordered_set>
+#include <utility>
+
+namespace
+{
+constexpr int WORD_BITS = 64;
+static_assert(Cfg::Pyramid::TILE % WORD_BITS == 0, "packed words must not straddle tiles");
+
+// Horizontal neighbours of a packed row: bit x of l is cell x-1, bit x of r is cell x+1.
+void ShiftRow(const uint64_t *row, int w, bool wrap, uint64_t *l, uint64_t *r)
+{
+    const int words = (w + WORD_BITS - 1) / WORD_BITS;
+    for (int j = 0; j < words; ++j) {
+        l[j] = (row[j] << 1) | (j > 0 ? row[j - 1] >> (WORD_BITS - 1) : 0ull);
+        r[j] = (row[j] >> 1) | (j + 1 < words ? row[j + 1] << (WORD_BITS - 1) : 0ull);
+    }
+    if (wrap) {
+        const int last = w - 1;
+        l[0] |= (row[last / WORD_BITS] >> (last % WORD_BITS)) & 1ull;
+        r[last / WORD_BITS] |= (row[0] & 1ull) << (last % WORD_BITS);
+    }
+}
+}  // namespace
 
 Automaton::Automaton()
 {
-    std::srand(static_cast<unsigned>(std::time(nullptr)));
+    circuit.Compile(ruleBits);
+    accept.fill(Cfg::Async::ACCEPT_ALWAYS);
+    SetSeed(static_cast<uint64_t>(std::time(nullptr)));
 }
 
 void Automaton::Resize(int W, int H)
 {
+    ++version;
     w = std::max(1, W);
     h = std::max(1, H);
+    tilesX = (w + Cfg::Pyramid::TILE - 1) / Cfg::Pyramid::TILE;
+    tilesY = (h + Cfg::Pyramid::TILE - 1) / Cfg::Pyramid::TILE;
+    tileStamp.assign(static_cast<std::size_t>(tilesX) * tilesY, version);
     grid.assign(w * h, 0);
     next.assign(w * h, 0);
     init = grid;
+    candMark.assign(w * h, 0);
     active.clear();
+    activeValid = true;
+    rowCount.assign(h, 0);
+    colCount.assign(w, 0);
+    RecountMetrics();
     iter = 0;
 }
 
 void Automaton::Clear()
 {
+    ++version;
     std::fill(grid.begin(), grid.end(), 0);
     active.clear();
+    activeValid = true;
+    RecountMetrics();
     iter = 0;
 }
 
@@ -40,16 +76,104 @@ void Automaton::Randomize(double p)
     }
 
     const unsigned threshold = static_cast<unsigned>(p * Cfg::Automaton::RANDOM_SCALE);
+    ++version;
 
     for (int i = 0; i < w * h; ++i) {
-        const unsigned r = static_cast<unsigned>(std::rand());
+        const uint64_t r = rng.Next();
         grid[i] = (r % Cfg::Automaton::RANDOM_SCALE) < threshold ? 1u : 0u;
     }
 
-    RebuildActive();
+    activeValid = false;
+    RecountMetrics();
     iter = 0;
 }
 
+void Automaton::LoadCells(const uint8_t *cells, std::size_t stride)
+{
+    ++version;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *src = cells + static_cast<std::size_t>(y) * stride;
+        uint8_t *dst = grid.data() + static_cast<std::size_t>(y) * w;
+        for (int x = 0; x < w; ++x) {
+            dst[x] = src[x] ? 1u : 0u;
+        }
+    }
+    activeValid = false;
+    RecountMetrics();
+}
+
+void Automaton::StoreCells(uint8_t *cells, std::size_t stride) const
+{
+    for (int y = 0; y < h; ++y) {
+        std::copy_n(grid.data() + static_cast<std::size_t>(y) * w, w, cells + static_cast<std::size_t>(y) * stride);
+    }
+}
+
+void Automaton::LoadBits(const uint8_t *bits, std::size_t stride)
+{
+    ++version;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *src = bits + static_cast<std::size_t>(y) * stride;
+        uint8_t *dst = grid.data() + static_cast<std::size_t>(y) * w;
+        for (int x = 0; x < w; ++x) {
+            dst[x] = (src[x >> 3] >> (x & 7)) & 1u;
+        }
+    }
+    activeValid = false;
+    RecountMetrics();
+}
+
+void Automaton::StoreBits(uint8_t *bits, std::size_t stride) const
+{
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *src = grid.data() + static_cast<std::size_t>(y) * w;
+        uint8_t *dst = bits + static_cast<std::size_t>(y) * stride;
+        std::fill_n(dst, (w + 7) / 8, 0);
+        for (int x = 0; x < w; ++x) {
+            dst[x >> 3] |= static_cast<uint8_t>(src[x] << (x & 7));
+        }
+    }
+}
+
+void Automaton::SetTransitionProbability(int row, double p)
+{
+    if (row < 0 || row >= Cfg::Automaton::RULE_BITS_COUNT) {
+        return;
+    }
+    p = std::clamp(p, 0.0, 1.0);
+    accept[row] = static_cast<uint64_t>(p * static_cast<double>(Cfg::Async::ACCEPT_ALWAYS) + 0.5);
+}
+
+void Automaton::SetRuleBits(uint16_t bits)
+{
+    ruleBits = bits;
+    circuit.Compile(bits);
+}
+
+double Automaton::TransitionProbability(int row) const
+{
+    if (row < 0 || row >= Cfg::Automaton::RULE_BITS_COUNT) {
+        return 1.0;
+    }
+    return static_cast<double>(accept[row]) / static_cast<double>(Cfg::Async::ACCEPT_ALWAYS);
+}
+
+bool Automaton::Deterministic() const
+{
+    for (uint64_t a : accept) {
+        if (a < Cfg::Async::ACCEPT_ALWAYS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Automaton::SetSeed(uint64_t s)
+{
+    seed = s;
+    rng.state = s;
+}
+
 void Automaton::SetInitFromCurrent()
 {
     init = grid;
@@ -57,21 +181,39 @@ void Automaton::SetInitFromCurrent()
 
 void Automaton::ResetToInit()
 {
+    ++version;
     grid = init;
-    RebuildActive();
+    activeValid = false;
+    RecountMetrics();
     iter = 0;
 }
 
 void Automaton::RebuildActive()
 {
     active.clear();
-    active.reserve(static_cast<size_t>((w * h) / Cfg::Automaton::ACTIVE_RESERVE_DIVISOR + 1));
+    active.reserve(std::max(population, static_cast<std::size_t>(w * h) / Cfg::Automaton::ACTIVE_RESERVE_DIVISOR));
 
-    for (int i = 0; i < w * h; ++i) {
+    // One linear scan; runs of eight dead cells are skipped a word at a time.
+    const int n = w * h;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v = 0;
+        std::memcpy(&v, grid.data() + i, sizeof(v));
+        if (v == 0) {
+            continue;
+        }
+        for (int k = 0; k < 8; ++k) {
+            if (grid[i + k]) {
+                active.push_back(i + k);
+            }
+        }
+    }
+    for (; i < n; ++i) {
         if (grid[i]) {
-            active.insert(i);
+            active.push_back(i);
         }
     }
+    activeValid = true;
 }
 
 int Automaton::CountNeighbors4(int x, int y) const
@@ -103,102 +245,500 @@ int Automaton::CountNeighbors4(int x, int y) const
     return cnt;
 }
 
-void Automaton::StepFull()
+int Automaton::FrontAround(int x, int y) const
+{
+    int idx[Cfg::Automaton::NEIGHBORS_VON_NEUMANN + 1];
+    int n = 0;
+    auto add = [&](int cx, int cy) {
+        const int i = Utils::Index(cx, cy, w);
+        for (int k = 0; k < n; ++k) {
+            if (idx[k] == i) {
+                return;
+            }
+        }
+        idx[n++] = i;
+    };
+
+    add(x, y);
+    if (wrap) {
+        add(x == 0 ? w - 1 : x - 1, y);
+        add(x == w - 1 ? 0 : x + 1, y);
+        add(x, y == 0 ? h - 1 : y - 1);
+        add(x, y == h - 1 ? 0 : y + 1);
+    } else {
+        if (x > 0) {
+            add(x - 1, y);
+        }
+        if (x < w - 1) {
+            add(x + 1, y);
+        }
+        if (y > 0) {
+            add(x, y - 1);
+        }
+        if (y < h - 1) {
+            add(x, y + 1);
+        }
+    }
+
+    int cnt = 0;
+    for (int k = 0; k < n; ++k) {
+        const int i = idx[k];
+        if (grid[i] && CountNeighbors4(i % w, i / w) < Cfg::Automaton::NEIGHBORS_VON_NEUMANN) {
+            ++cnt;
+        }
+    }
+    return cnt;
+}
+
+int Automaton::FrontInRow(const std::vector<uint8_t> &g, int y) const
+{
+    const uint8_t *row = g.data() + Utils::Index(0, y, w);
+    const uint8_t *up = nullptr;
+    const uint8_t *down = nullptr;
+    if (y > 0 || wrap) {
+        up = g.data() + Utils::Index(0, y == 0 ? h - 1 : y - 1, w);
+    }
+    if (y < h - 1 || wrap) {
+        down = g.data() + Utils::Index(0, y == h - 1 ? 0 : y + 1, w);
+    }
+
+    int cnt = 0;
+    for (int x = 0; x < w; ++x) {
+        if (!row[x]) {
+            continue;
+        }
+        uint8_t l = 0;
+        uint8_t r = 0;
+        if (wrap) {
+            l = row[x == 0 ? w - 1 : x - 1];
+            r = row[x == w - 1 ? 0 : x + 1];
+        } else {
+            l = x > 0 ? row[x - 1] : 0;
+            r = x < w - 1 ? row[x + 1] : 0;
+        }
+        const bool surrounded = l && r && up && up[x] && down && down[x];
+        cnt += surrounded ? 0 : 1;
+    }
+    return cnt;
+}
+
+void Automaton::FlipCell(int x, int y)
 {
+    const int i = Utils::Index(x, y, w);
+    MarkTile(x, y);
+    front -= FrontAround(x, y);
+    grid[i] ^= 1u;
+    front += FrontAround(x, y);
+
+    if (grid[i]) {
+        ++population;
+        ++rowCount[y];
+        ++colCount[x];
+        if (population == 1) {
+            bbox = BoundingBox{x, y, x, y};
+        } else {
+            bbox.minX = std::min(bbox.minX, x);
+            bbox.minY = std::min(bbox.minY, y);
+            bbox.maxX = std::max(bbox.maxX, x);
+            bbox.maxY = std::max(bbox.maxY, y);
+        }
+        return;
+    }
+
+    --population;
+    --rowCount[y];
+    --colCount[x];
+    if (population == 0) {
+        bbox = BoundingBox{};
+        return;
+    }
+    while (rowCount[bbox.minY] == 0) {
+        ++bbox.minY;
+    }
+    while (rowCount[bbox.maxY] == 0) {
+        --bbox.maxY;
+    }
+    while (colCount[bbox.minX] == 0) {
+        ++bbox.minX;
+    }
+    while (colCount[bbox.maxX] == 0) {
+        --bbox.maxX;
+    }
+}
+
+void Automaton::BoundsFromCounts()
+{
+    bbox = BoundingBox{};
+    if (population == 0) {
+        return;
+    }
+    bbox.minY = 0;
+    while (rowCount[bbox.minY] == 0) {
+        ++bbox.minY;
+    }
+    bbox.maxY = h - 1;
+    while (rowCount[bbox.maxY] == 0) {
+        --bbox.maxY;
+    }
+    bbox.minX = 0;
+    while (colCount[bbox.minX] == 0) {
+        ++bbox.minX;
+    }
+    bbox.maxX = w - 1;
+    while (colCount[bbox.maxX] == 0) {
+        --bbox.maxX;
+    }
+}
+
+// Full rescan after arbitrary grid changes, so every tile is stamped as changed too.
+void Automaton::RecountMetrics()
+{
+    std::fill(tileStamp.begin(), tileStamp.end(), version);
+    std::fill(rowCount.begin(), rowCount.end(), 0);
+    std::fill(colCount.begin(), colCount.end(), 0);
+    population = 0;
+    front = 0;
     for (int y = 0; y < h; ++y) {
+        const uint8_t *row = grid.data() + Utils::Index(0, y, w);
+        int cnt = 0;
         for (int x = 0; x < w; ++x) {
-            const int i = Utils::Index(x, y, w);
-            const int n = CountNeighbors4(x, y);
-            next[i] = NextState(grid[i], n);
+            cnt += row[x];
+            colCount[x] += row[x];
         }
+        rowCount[y] = cnt;
+        population += static_cast<std::size_t>(cnt);
+        front += static_cast<std::size_t>(FrontInRow(grid, y));
     }
-    grid.swap(next);
-    RebuildActive();
-    ++iter;
+    BoundsFromCounts();
 }
 
-void Automaton::StepSparse()
+void Automaton::PackGrid()
 {
-    if (active.empty() && !ZeroZeroSpawnsOne()) {
-        ++iter;
+    const int words = (w + WORD_BITS - 1) / WORD_BITS;
+    const std::size_t total = static_cast<std::size_t>(words) * h;
+    packed.assign(total, 0);
+    packedNext.resize(total);
+    rowPlanes.assign(static_cast<std::size_t>(words) * 6, 0);
+
+    // Eight 0/1 bytes at a time: the multiply gathers byte k into bit 56 + k.
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *src = grid.data() + Utils::Index(0, y, w);
+        uint64_t *dst = packed.data() + static_cast<std::size_t>(y) * words;
+        int x = 0;
+        for (; x + 8 <= w; x += 8) {
+            uint64_t v = 0;
+            std::memcpy(&v, src + x, 8);
+            dst[x / WORD_BITS] |= ((v * 0x0102040810204080ull) >> 56) << (x % WORD_BITS);
+        }
+        for (; x < w; ++x) {
+            dst[x / WORD_BITS] |= static_cast<uint64_t>(src[x] != 0) << (x % WORD_BITS);
+        }
+    }
+}
+
+const uint64_t *Automaton::PackedRow(const std::vector<uint64_t> &g, int y) const
+{
+    const int words = (w + WORD_BITS - 1) / WORD_BITS;
+    if (y < 0 || y >= h) {
+        if (!wrap) {
+            return rowPlanes.data() + static_cast<std::size_t>(words) * 5;  // all zero
+        }
+        y = (y + h) % h;
+    }
+    return g.data() + static_cast<std::size_t>(y) * words;
+}
+
+void Automaton::PackedGeneration()
+{
+    const int words = (w + WORD_BITS - 1) / WORD_BITS;
+    const uint64_t tail = (w % WORD_BITS) ? ((1ull << (w % WORD_BITS)) - 1) : ~0ull;
+    uint64_t *l = rowPlanes.data();
+    uint64_t *r = l + words;
+    uint64_t *b0 = r + words;
+    uint64_t *b1 = b0 + words;
+    uint64_t *b2 = b1 + words;
+
+    const BitRule::Minterms generic = BitRule::MintermsOf(ruleBits);
+    std::size_t pop = 0;
+    for (int y = 0; y < h; ++y) {
+        const uint64_t *row = PackedRow(packed, y);
+        const uint64_t *up = PackedRow(packed, y - 1);
+        const uint64_t *down = PackedRow(packed, y + 1);
+        uint64_t *out = packedNext.data() + static_cast<std::size_t>(y) * words;
+        ShiftRow(row, w, wrap, l, r);
+        for (int j = 0; j < words; ++j) {
+            BitRule::Count4(l[j], r[j], up[j], down[j], b0[j], b1[j], b2[j]);
+        }
+        if (circuit.Valid()) {
+            circuit.Run(row, b0, b1, b2, out, static_cast<std::size_t>(words), circuitScratch);
+        } else {
+            for (int j = 0; j < words; ++j) {
+                out[j] = BitRule::ApplyGeneric(generic, row[j], b0[j], b1[j], b2[j]);
+            }
+        }
+        out[words - 1] &= tail;
+
+        const std::size_t stampRow = static_cast<std::size_t>(y >> Cfg::Pyramid::TILE_SHIFT) * tilesX;
+        for (int j = 0; j < words; ++j) {
+            pop += static_cast<std::size_t>(__builtin_popcountll(out[j]));
+            if (out[j] != row[j]) {
+                tileStamp[stampRow + static_cast<std::size_t>(j) * WORD_BITS / Cfg::Pyramid::TILE] = version;
+            }
+        }
+    }
+
+    packed.swap(packedNext);
+    population = pop;
+}
+
+void Automaton::UnpackGrid()
+{
+    const int words = (w + WORD_BITS - 1) / WORD_BITS;
+    uint64_t *l = rowPlanes.data();
+    uint64_t *r = l + words;
+
+    // Metrics come from the packed grid: a front cell is live and not surrounded.
+    std::fill(colCount.begin(), colCount.end(), 0);
+    population = 0;
+    front = 0;
+    for (int y = 0; y < h; ++y) {
+        const uint64_t *row = PackedRow(packed, y);
+        const uint64_t *up = PackedRow(packed, y - 1);
+        const uint64_t *down = PackedRow(packed, y + 1);
+        ShiftRow(row, w, wrap, l, r);
+        int cnt = 0;
+        for (int j = 0; j < words; ++j) {
+            cnt += __builtin_popcountll(row[j]);
+            front += static_cast<std::size_t>(__builtin_popcountll(row[j] & ~(l[j] & r[j] & up[j] & down[j])));
+        }
+        rowCount[y] = cnt;
+        population += static_cast<std::size_t>(cnt);
+
+        uint8_t *dst = grid.data() + Utils::Index(0, y, w);
+        for (int x = 0; x < w; ++x) {
+            const uint8_t v = static_cast<uint8_t>((row[x / WORD_BITS] >> (x % WORD_BITS)) & 1ull);
+            dst[x] = v;
+            colCount[x] += v;
+        }
+    }
+
+    BoundsFromCounts();
+    activeValid = false;
+}
+
+void Automaton::SetObserver(Observer fn, int every)
+{
+    observer = std::move(fn);
+    observeEvery = std::max(1, every);
+}
+
+void Automaton::Notify(bool packedCurrent)
+{
+    if (!observer || iter % static_cast<uint32_t>(observeEvery) != 0) {
         return;
     }
+    if (!packedCurrent) {
+        PackGrid();
+    }
+    observer(PackedFrame{packed.data(), w, h, (w + WORD_BITS - 1) / WORD_BITS, iter, population});
+}
+
+void Automaton::StepFull()
+{
+    PackGrid();
+    PackedGeneration();
+    UnpackGrid();
+    ++iter;
+}
+
+void Automaton::StepSparse()
+{
     if (ZeroZeroSpawnsOne()) {
         StepFull();
         return;
     }
+    if (!activeValid) {
+        RebuildActive();
+    }
+    if (active.empty()) {
+        ++iter;
+        return;
+    }
 
+    // Live cells and their neighbours, deduplicated with one mark byte per cell.
     const int W = w, H = h;
-    std::unordered_set<int> cand;
-    cand.reserve(active.size() * static_cast<size_t>(Cfg::Automaton::SPARSE_CANDIDATE_FACTOR) + 8u);
-
-    auto push = [&](int x, int y) {
-        if (x >= 0 && x < W && y >= 0 && y < H) {
-            cand.insert(Utils::Index(x, y, W));
+    candidates.clear();
+    candidates.reserve(active.size() * static_cast<size_t>(Cfg::Automaton::SPARSE_CANDIDATE_FACTOR));
+    auto push = [&](int i) {
+        if (!candMark[i]) {
+            candMark[i] = 1;
+            candidates.push_back(i);
         }
     };
-    auto wrapx = [&](int x) { return x < 0 ? W - 1 : (x >= W ? 0 : x); };
-    auto wrapy = [&](int y) { return y < 0 ? H - 1 : (y >= H ? 0 : y); };
-
     for (int i : active) {
         const int y = i / W;
         const int x = i % W;
-        cand.insert(i);
+        push(i);
         if (wrap) {
-            push(wrapx(x - 1), y);
-            push(wrapx(x + 1), y);
-            push(x, wrapy(y - 1));
-            push(x, wrapy(y + 1));
+            push(Utils::Index(x == 0 ? W - 1 : x - 1, y, W));
+            push(Utils::Index(x == W - 1 ? 0 : x + 1, y, W));
+            push(Utils::Index(x, y == 0 ? H - 1 : y - 1, W));
+            push(Utils::Index(x, y == H - 1 ? 0 : y + 1, W));
         } else {
             if (x > 0) {
-                push(x - 1, y);
+                push(i - 1);
             }
             if (x < W - 1) {
-                push(x + 1, y);
+                push(i + 1);
             }
             if (y > 0) {
-                push(x, y - 1);
+                push(i - W);
             }
             if (y < H - 1) {
-                push(x, y + 1);
+                push(i + W);
             }
         }
     }
 
-    std::unordered_set<int> nextActive;
-    nextActive.reserve(cand.size());
-
-    for (int i : cand) {
-        const int y = i / W;
-        const int x = i % W;
-        const int nnz = CountNeighbors4(x, y);
-        const uint8_t ns = NextState(grid[i], nnz);
+    nextActive.clear();
+    changed.clear();
+    for (int i : candidates) {
+        candMark[i] = 0;
+        const uint8_t ns = NextState(grid[i], CountNeighbors4(i % W, i / W));
         if (ns) {
-            nextActive.insert(i);
+            nextActive.push_back(i);
         }
-    }
-
-    for (int i : active) {
-        if (nextActive.find(i) == nextActive.end()) {
-            grid[i] = 0;
+        if (ns != grid[i]) {
+            changed.push_back(i);
         }
     }
-    for (int i : nextActive) {
-        grid[i] = 1;
+    for (int i : changed) {
+        FlipCell(i % W, i / W);
     }
 
     active.swap(nextActive);
     ++iter;
 }
 
-void Automaton::Step()
+void Automaton::FinishBulkStep()
+{
+    RecountMetrics();
+    activeValid = false;
+    ++iter;
+}
+
+void Automaton::StepStochastic()
+{
+    const int minRows = std::max(1, Cfg::Async::MIN_CELLS_PER_THREAD / w);
+    Utils::ParallelFor(h, threads, minRows, [this](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const int i = Utils::Index(x, y, w);
+                const uint64_t r = Utils::CounterRandom(seed, StreamCounter(0, i));
+                next[i] = StochasticState(grid[i], CountNeighbors4(x, y), r);
+            }
+        }
+    });
+    grid.swap(next);
+    FinishBulkStep();
+}
+
+void Automaton::StepRandomSequential()
+{
+    const bool det = Deterministic();
+    const uint64_t n = static_cast<uint64_t>(w) * static_cast<uint64_t>(h);
+    for (uint64_t t = 0; t < n; ++t) {
+        // High half picks the cell (multiply-shift range reduction), low half decides acceptance.
+        const uint64_t r = Utils::CounterRandom(seed, StreamCounter(0, static_cast<int>(t)));
+        const int i = static_cast<int>(((r >> 32) * n) >> 32);
+        const int nnz = CountNeighbors4(i % w, i / w);
+        grid[i] = det ? NextState(grid[i], nnz) : StochasticState(grid[i], nnz, r << 32);
+    }
+    FinishBulkStep();
+}
+
+void Automaton::StepCheckerboard()
+{
+    // Colour (cx[x] + cy[y]) mod K, where cx and cy properly colour the row and column cycles.
+    // An odd cycle needs a third colour on its seam, which makes the plane need K = 3.
+    auto colourCycle = [this](int n, std::vector<int> &c) {
+        c.resize(n);
+        for (int k = 0; k < n; ++k) {
+            c[k] = k & 1;
+        }
+        if (wrap && n > 1 && (n & 1)) {
+            c[n - 1] = 2;
+            return true;
+        }
+        return false;
+    };
+    std::vector<int> cx, cy;
+    const bool seamX = colourCycle(w, cx);
+    const bool seamY = colourCycle(h, cy);
+    const int K = (seamX || seamY) ? 3 : 2;
+
+    const bool det = Deterministic();
+    const int minRows = std::max(1, Cfg::Async::MIN_CELLS_PER_THREAD / w);
+    for (int k = 0; k < K; ++k) {
+        // Cells of class k only read cells of other classes, so rows can be split freely.
+        Utils::ParallelFor(h, threads, minRows, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    if ((cx[x] + cy[y]) % K != k) {
+                        continue;
+                    }
+                    const int i = Utils::Index(x, y, w);
+                    const int nnz = CountNeighbors4(x, y);
+                    if (det) {
+                        grid[i] = NextState(grid[i], nnz);
+                    } else {
+                        grid[i] = StochasticState(grid[i], nnz, Utils::CounterRandom(seed, StreamCounter(k, i)));
+                    }
+                }
+            }
+        });
+    }
+    FinishBulkStep();
+}
+
+bool Automaton::LooksDense() const
 {
     const std::size_t total = static_cast<std::size_t>(w) * static_cast<std::size_t>(h);
-    const std::size_t k = active.size();
-    const bool looksDense = (k * static_cast<std::size_t>(Cfg::Automaton::SPARSE_CANDIDATE_FACTOR) >= total);
-    if (looksDense) {
-        StepFull();
-    } else {
-        StepSparse();
+    return ZeroZeroSpawnsOne() ||
+           population * static_cast<std::size_t>(Cfg::Automaton::SPARSE_CANDIDATE_FACTOR) >= total;
+}
+
+void Automaton::Step(int generations)
+{
+    ++version;
+    while (generations > 0) {
+        if (mode == UpdateMode::RANDOM_SEQUENTIAL) {
+            StepRandomSequential();
+            --generations;
+            Notify(false);
+        } else if (mode == UpdateMode::CHECKERBOARD) {
+            StepCheckerboard();
+            --generations;
+            Notify(false);
+        } else if (!Deterministic()) {
+            StepStochastic();
+            --generations;
+            Notify(false);
+        } else if (!LooksDense()) {
+            StepSparse();
+            --generations;
+            Notify(false);
+        } else {
+            // Stay packed for as long as the grid stays dense; metrics and the byte grid are
+            // brought up to date once at the end of the run.
+            PackGrid();
+            do {
+                PackedGeneration();
+                ++iter;
+                --generations;
+                Notify(true);
+            } while (generations > 0 && LooksDense());
+            UnpackGrid();
+        }
     }
 }
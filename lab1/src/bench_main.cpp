@@ -0,0 +1,54 @@
+#include "automaton.h"
+#include "compositor.h"
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+
+// Frames per second for composing `a` into a dstW x dstH frame, measured over about a second.
+double FramesPerSecond(Compositor &comp, const Automaton &a, int dstW, int dstH, const FrameStyle &style)
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<uint32_t> frame;
+    comp.Compose(a, dstW, dstH, style, frame);
+
+    int frames = 0;
+    const Clock::time_point start = Clock::now();
+    double sec = 0.0;
+    do {
+        comp.Compose(a, dstW, dstH, style, frame);
+        ++frames;
+        sec = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (sec < Cfg::Bench::SECONDS_PER_CASE);
+    return frames / sec;
+}
+
+}  // namespace
+
+int main()
+{
+    FrameStyle plain;
+    FrameStyle grid;
+    grid.showGrid = true;
+
+    std::printf("%-8s %14s %14s %16s\n", "grid", "fit 1920x1080", "native", "zoom + grid");
+    for (int n : Cfg::Bench::GRID_SIZES) {
+        Automaton a;
+        a.Resize(n, n);
+        a.Randomize(0.5);
+
+        Compositor comp;
+        const double fit = FramesPerSecond(comp, a, Cfg::Bench::VIEW_W, Cfg::Bench::VIEW_H, plain);
+        const double native = FramesPerSecond(comp, a, n, n, plain);
+        // Zoomed frames are capped at MAX_ZOOMED_SIDE pixels per side.
+        const int zoom = std::max(1, Cfg::Bench::MAX_ZOOMED_SIDE / n);
+        const double zoomed = FramesPerSecond(comp, a, zoom * n, zoom * n, grid);
+        std::printf("%-8d %14.1f %14.1f %12.1f (%dx)\n", n, fit, native, zoomed, zoom);
+    }
+    return 0;
+}
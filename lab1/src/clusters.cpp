@@ -0,0 +1,539 @@
+#include "clusters.h"
+#include "config.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+constexpr uint64_t BYTE_ONES = 0x0101010101010101ull;
+// Gathers the low bit of each of the eight bytes of a word into the top byte of the product.
+constexpr uint64_t GATHER_BITS = 0x0102040810204080ull;
+constexpr double TWO_PI = 6.283185307179586476925286766559;
+
+int Find(std::vector<int> &parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Keeps the smaller index as the root, so a set's root is its first element in scan order.
+void Unite(std::vector<int> &parent, int a, int b)
+{
+    a = Find(parent, a);
+    b = Find(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
+
+// Calls link(i, j, acrossSeam) for every run a[i] of one row that touches run b[j] of the row above
+// or below. Both rows are sorted by x.
+template <typename Run, typename Fn>
+void LinkRows(const Run *a, int na, const Run *b, int nb, int w, bool wrap, bool diag, Fn &&link)
+{
+    const int e = diag ? 1 : 0;
+    int j0 = 0;
+    for (int i = 0; i < na; ++i) {
+        while (j0 < nb && b[j0].x1 + e < a[i].x0) {
+            ++j0;
+        }
+        for (int j = j0; j < nb && b[j].x0 <= a[i].x1 + e; ++j) {
+            link(i, j, false);
+        }
+    }
+    // Corner neighbours across the left/right edge.
+    if (wrap && diag && w > 1 && na > 0 && nb > 0) {
+        if (a[0].x0 == 0 && b[nb - 1].x1 == w - 1) {
+            link(0, nb - 1, true);
+        }
+        if (a[na - 1].x1 == w - 1 && b[0].x0 == 0) {
+            link(na - 1, 0, true);
+        }
+    }
+}
+
+// Signed distance from ref to v the short way round a torus axis, in [-n/2, n - n/2).
+int Offset(int v, int ref, int n)
+{
+    int d = ((v - ref) % n + n) % n;
+    if (d >= n - n / 2) {
+        d -= n;
+    }
+    return d;
+}
+
+// Nearest cell to the circular mean of angles whose cos/sin sums are c and s; 0 if undefined.
+int CircularRef(double c, double s, int n)
+{
+    if (std::abs(c) + std::abs(s) < 1e-9) {
+        return 0;
+    }
+    double a = std::atan2(s, c);
+    if (a < 0.0) {
+        a += TWO_PI;
+    }
+    const int r = static_cast<int>(std::lround(a * n / TWO_PI));
+    return r % n;
+}
+
+// Box lo..hi around ref on an axis of n cells: it starts inside the grid and may run past the far
+// edge; one that covers the whole axis is 0..n-1.
+void PlaceBox(int ref, int lo, int hi, int n, int &outLo, int &outHi)
+{
+    if (hi - lo + 1 >= n) {
+        outLo = 0;
+        outHi = n - 1;
+        return;
+    }
+    outLo = ref + lo;
+    outHi = ref + hi;
+    const int shift = ((outLo % n) + n) % n - outLo;
+    outLo += shift;
+    outHi += shift;
+}
+
+double WrapMean(double v, int n)
+{
+    v = std::fmod(v, static_cast<double>(n));
+    return v < 0.0 ? v + n : v;
+}
+
+template <typename SeamSums>
+void AddSpan(SeamSums &s, int d0, int len)
+{
+    const int64_t n = len;
+    s.sumDx += n * d0 + n * (n - 1) / 2;
+    s.minDx = std::min(s.minDx, d0);
+    s.maxDx = std::max(s.maxDx, d0 + len - 1);
+}
+}  // namespace
+
+void ClusterLabeller::PrepareTables()
+{
+    if (tablesW == w && tablesH == h) {
+        return;
+    }
+    tablesW = w;
+    tablesH = h;
+    cosPrefix.assign(w + 1, 0.0);
+    sinPrefix.assign(w + 1, 0.0);
+    for (int x = 0; x < w; ++x) {
+        const double a = TWO_PI * x / w;
+        cosPrefix[x + 1] = cosPrefix[x] + std::cos(a);
+        sinPrefix[x + 1] = sinPrefix[x] + std::sin(a);
+    }
+    cosRow.resize(h);
+    sinRow.resize(h);
+    for (int y = 0; y < h; ++y) {
+        const double a = TWO_PI * y / h;
+        cosRow[y] = std::cos(a);
+        sinRow[y] = std::sin(a);
+    }
+}
+
+void ClusterLabeller::LabelBand(const Automaton &a, Band &band) const
+{
+    const uint8_t *g = a.Data().data();
+    const bool diag = conn == Connectivity::EIGHT;
+    std::vector<Run> &runs = band.runs;
+    std::vector<int> &parent = band.parent;
+    runs.clear();
+    parent.clear();
+    band.rowStart.clear();
+    band.seamRuns.clear();
+    const int words = (w + 63) / 64;
+    std::vector<uint64_t> &mask = band.mask;
+    mask.resize(words);
+
+    int prev = 0;
+    for (int y = band.y0; y < band.y1; ++y) {
+        const int begin = static_cast<int>(runs.size());
+        band.rowStart.push_back(begin);
+
+        // Pack the row to bits, then walk it run by run.
+        const uint8_t *row = g + Utils::Index(0, y, w);
+        for (int j = 0; j < words; ++j) {
+            uint64_t bits = 0;
+            const int base = j << 6;
+            for (int k = 0; k < 64; k += 8) {
+                const int x = base + k;
+                if (x + 8 <= w) {
+                    uint64_t v = 0;
+                    std::memcpy(&v, row + x, sizeof(v));
+                    bits |= (((v & BYTE_ONES) * GATHER_BITS) >> 56) << k;
+                } else {
+                    for (int i = x; i < w; ++i) {
+                        bits |= static_cast<uint64_t>(row[i] != 0) << (i - base);
+                    }
+                    break;
+                }
+            }
+            mask[j] = bits;
+        }
+        // Run starts and ends within each word; a run still open at the end of a word carries over.
+        int open = -1;
+        for (int j = 0; j < words; ++j) {
+            const uint64_t m = mask[j];
+            const uint64_t before = j > 0 ? mask[j - 1] >> 63 : 0ull;
+            const uint64_t after = j + 1 < words ? mask[j + 1] << 63 : 0ull;
+            uint64_t starts = m & ~((m << 1) | before);
+            uint64_t ends = m & ~((m >> 1) | after);
+            const int base = j << 6;
+            while (ends) {
+                int x0 = open;
+                if (x0 < 0) {
+                    x0 = base + __builtin_ctzll(starts);
+                    starts &= starts - 1;
+                }
+                open = -1;
+                parent.push_back(static_cast<int>(runs.size()));
+                runs.push_back(Run{y, x0, base + __builtin_ctzll(ends), 0});
+                ends &= ends - 1;
+            }
+            if (starts) {
+                open = base + __builtin_ctzll(starts);
+            }
+        }
+        const int end = static_cast<int>(runs.size());
+
+        if (wrap && end - begin >= 2 && runs[begin].x0 == 0 && runs[end - 1].x1 == w - 1) {
+            Unite(parent, begin, end - 1);
+            band.seamRuns.push_back(begin);
+        }
+        if (y > band.y0) {
+            LinkRows(runs.data() + begin, end - begin, runs.data() + prev, begin - prev, w, wrap, diag,
+                     [&](int i, int j, bool across) {
+                         Unite(parent, begin + i, prev + j);
+                         if (across) {
+                             band.seamRuns.push_back(begin + i);
+                         }
+                     });
+        }
+        prev = begin;
+    }
+    band.rowStart.push_back(static_cast<int>(runs.size()));
+
+    // Pieces are numbered in order of their first run.
+    int pieces = 0;
+    for (int r = 0; r < static_cast<int>(runs.size()); ++r) {
+        const int root = Find(parent, r);
+        runs[r].piece = root == r ? pieces++ : runs[root].piece;
+    }
+
+    band.pieces.assign(pieces, Sums{});
+    for (const Run &r : runs) {
+        Sums &s = band.pieces[r.piece];
+        const int64_t len = r.x1 - r.x0 + 1;
+        s.count += len;
+        s.sumX += len * (r.x0 + r.x1) / 2;
+        s.sumY += len * r.y;
+        s.minX = std::min(s.minX, r.x0);
+        s.maxX = std::max(s.maxX, r.x1);
+        s.minY = std::min(s.minY, r.y);
+        s.maxY = std::max(s.maxY, r.y);
+    }
+    for (int r : band.seamRuns) {
+        band.pieces[runs[r].piece].seam |= SEAM_X;
+    }
+}
+
+void ClusterLabeller::JoinBands()
+{
+    const int nb = static_cast<int>(bands.size());
+    pieceOffset.assign(nb + 1, 0);
+    for (int b = 0; b < nb; ++b) {
+        pieceOffset[b + 1] = pieceOffset[b] + static_cast<int>(bands[b].pieces.size());
+    }
+    const int total = pieceOffset[nb];
+    pieceParent.resize(total);
+    for (int i = 0; i < total; ++i) {
+        pieceParent[i] = i;
+    }
+    pieceCluster.resize(total);
+
+    // Last row of every band against the first row of the next; on a torus the last band wraps
+    // round to the first. Only the pieces touched here can end up in a cluster of several pieces.
+    const bool diag = conn == Connectivity::EIGHT;
+    touched.clear();
+    for (int b = 0; b < nb; ++b) {
+        int c = b + 1;
+        if (c == nb) {
+            if (!wrap) {
+                break;
+            }
+            c = 0;
+        }
+        Band &lo = bands[b];
+        Band &hi = bands[c];
+        const bool acrossY = c == 0;
+        const int rows = lo.y1 - lo.y0;
+        const Run *last = lo.runs.data() + lo.rowStart[rows - 1];
+        const Run *first = hi.runs.data() + hi.rowStart[0];
+        LinkRows(last, lo.rowStart[rows] - lo.rowStart[rows - 1], first, hi.rowStart[1] - hi.rowStart[0], w, wrap,
+                 diag, [&](int i, int j, bool acrossX) {
+                     const int p = pieceOffset[b] + last[i].piece;
+                     const int q = pieceOffset[c] + first[j].piece;
+                     Unite(pieceParent, p, q);
+                     touched.push_back(p);
+                     touched.push_back(q);
+                     const uint8_t flags = (acrossX ? SEAM_X : 0) | (acrossY ? SEAM_Y : 0);
+                     lo.pieces[last[i].piece].seam |= flags;
+                     hi.pieces[first[j].piece].seam |= flags;
+                 });
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (int i : touched) {
+        pieceParent[i] = Find(pieceParent, i);
+    }
+}
+
+void ClusterLabeller::CountRoots(Band &band, int offset) const
+{
+    band.roots = 0;
+    for (std::size_t p = 0; p < band.pieces.size(); ++p) {
+        const int i = offset + static_cast<int>(p);
+        band.roots += pieceParent[i] == i ? 1 : 0;
+    }
+}
+
+// Roots are the first piece of their cluster, so clusters come out in raster order.
+void ClusterLabeller::NumberRoots(Band &band, int offset)
+{
+    int next = band.firstCluster;
+    for (std::size_t p = 0; p < band.pieces.size(); ++p) {
+        const int i = offset + static_cast<int>(p);
+        if (pieceParent[i] == i) {
+            pieceCluster[i] = next;
+            sums[next++] = band.pieces[p];
+        }
+    }
+}
+
+void ClusterLabeller::NumberClusters()
+{
+    const int nb = static_cast<int>(bands.size());
+    int n = 0;
+    for (Band &band : bands) {
+        band.firstCluster = n;
+        n += band.roots;
+    }
+    sums.resize(n);
+    Utils::ParallelFor(nb, nb, 1, [&](int begin, int end) {
+        for (int b = begin; b < end; ++b) {
+            NumberRoots(bands[b], pieceOffset[b]);
+        }
+    });
+
+    // The remaining pieces were all touched by a border link; fold them into their roots.
+    for (int i : touched) {
+        const int root = pieceParent[i];
+        if (root == i) {
+            continue;
+        }
+        const auto band = std::upper_bound(pieceOffset.begin(), pieceOffset.end(), i) - 1;
+        const int b = static_cast<int>(band - pieceOffset.begin());
+        const Sums &from = bands[b].pieces[i - pieceOffset[b]];
+        Sums &to = sums[pieceCluster[root]];
+        pieceCluster[i] = pieceCluster[root];
+        to.count += from.count;
+        to.sumX += from.sumX;
+        to.sumY += from.sumY;
+        to.minX = std::min(to.minX, from.minX);
+        to.maxX = std::max(to.maxX, from.maxX);
+        to.minY = std::min(to.minY, from.minY);
+        to.maxY = std::max(to.maxY, from.maxY);
+        to.seam |= from.seam;
+    }
+
+    seamIndex.assign(n, -1);
+    int seamCount = 0;
+    for (int k = 0; k < n; ++k) {
+        if (sums[k].seam) {
+            seamIndex[k] = seamCount++;
+        }
+    }
+    seam.assign(seamCount, SeamSums{});
+}
+
+void ClusterLabeller::SeamAngles(Band &band, int offset) const
+{
+    band.seam.assign(seam.size(), SeamSums{});
+    for (const Run &r : band.runs) {
+        const int k = seamIndex[pieceCluster[offset + r.piece]];
+        if (k < 0) {
+            continue;
+        }
+        SeamSums &s = band.seam[k];
+        const int len = r.x1 - r.x0 + 1;
+        s.cosX += cosPrefix[r.x1 + 1] - cosPrefix[r.x0];
+        s.sinX += sinPrefix[r.x1 + 1] - sinPrefix[r.x0];
+        s.cosY += len * cosRow[r.y];
+        s.sinY += len * sinRow[r.y];
+    }
+}
+
+void ClusterLabeller::SeamOffsets(Band &band, int offset) const
+{
+    band.seam.assign(seam.size(), SeamSums{});
+    const int half = w / 2;
+    for (const Run &r : band.runs) {
+        const int k = seamIndex[pieceCluster[offset + r.piece]];
+        if (k < 0) {
+            continue;
+        }
+        SeamSums &s = band.seam[k];
+        const int len = r.x1 - r.x0 + 1;
+        const int dx = Offset(r.x0, seam[k].refX, w);
+        const int dy = Offset(r.y, seam[k].refY, h);
+
+        // Offsets jump from w - w/2 - 1 to -w/2 at most once along a run.
+        const int before = (w - half) - dx;
+        if (len <= before) {
+            AddSpan(s, dx, len);
+        } else {
+            AddSpan(s, dx, before);
+            AddSpan(s, -half, len - before);
+        }
+        s.sumDy += static_cast<int64_t>(len) * dy;
+        s.minDy = std::min(s.minDy, dy);
+        s.maxDy = std::max(s.maxDy, dy);
+    }
+}
+
+void ClusterLabeller::MergeSeam(bool offsets)
+{
+    for (const Band &band : bands) {
+        for (std::size_t k = 0; k < seam.size(); ++k) {
+            const SeamSums &from = band.seam[k];
+            SeamSums &to = seam[k];
+            if (offsets) {
+                to.sumDx += from.sumDx;
+                to.sumDy += from.sumDy;
+                to.minDx = std::min(to.minDx, from.minDx);
+                to.maxDx = std::max(to.maxDx, from.maxDx);
+                to.minDy = std::min(to.minDy, from.minDy);
+                to.maxDy = std::max(to.maxDy, from.maxDy);
+            } else {
+                to.cosX += from.cosX;
+                to.sinX += from.sinX;
+                to.cosY += from.cosY;
+                to.sinY += from.sinY;
+            }
+        }
+    }
+    if (!offsets) {
+        for (SeamSums &s : seam) {
+            s.refX = CircularRef(s.cosX, s.sinX, w);
+            s.refY = CircularRef(s.cosY, s.sinY, h);
+        }
+    }
+}
+
+Cluster ClusterLabeller::Measure(int k) const
+{
+    const Sums &s = sums[k];
+    const double count = static_cast<double>(s.count);
+    Cluster c;
+    c.size = static_cast<int>(s.count);
+    c.cx = static_cast<double>(s.sumX) / count;
+    c.cy = static_cast<double>(s.sumY) / count;
+    c.bbox = BoundingBox{s.minX, s.minY, s.maxX, s.maxY};
+    if (seamIndex[k] < 0) {
+        return c;
+    }
+    const SeamSums &t = seam[seamIndex[k]];
+    if (s.seam & SEAM_X) {
+        c.cx = WrapMean(t.refX + static_cast<double>(t.sumDx) / count, w);
+        PlaceBox(t.refX, t.minDx, t.maxDx, w, c.bbox.minX, c.bbox.maxX);
+    }
+    if (s.seam & SEAM_Y) {
+        c.cy = WrapMean(t.refY + static_cast<double>(t.sumDy) / count, h);
+        PlaceBox(t.refY, t.minDy, t.maxDy, h, c.bbox.minY, c.bbox.maxY);
+    }
+    return c;
+}
+
+void ClusterLabeller::Finish()
+{
+    const int n = static_cast<int>(sums.size());
+    clusters.resize(n);
+    Utils::ParallelFor(n, static_cast<int>(bands.size()), Cfg::Clusters::MIN_CLUSTERS_PER_THREAD,
+                       [this](int begin, int end) {
+                           for (int k = begin; k < end; ++k) {
+                               clusters[k] = Measure(k);
+                           }
+                       });
+}
+
+int ClusterLabeller::Label(const Automaton &a)
+{
+    w = a.Width();
+    h = a.Height();
+    wrap = a.Wrap();
+    labelsValid = false;
+
+    int t = threads;
+    if (t <= 0) {
+        t = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    const int nb = std::max(1, std::min(t, h / Cfg::Clusters::MIN_ROWS_PER_BAND));
+    bands.resize(nb);
+    for (int b = 0; b < nb; ++b) {
+        bands[b].y0 = static_cast<int>(static_cast<int64_t>(h) * b / nb);
+        bands[b].y1 = static_cast<int>(static_cast<int64_t>(h) * (b + 1) / nb);
+    }
+    auto forBands = [&](auto &&fn) {
+        Utils::ParallelFor(nb, nb, 1, [&](int begin, int end) {
+            for (int b = begin; b < end; ++b) {
+                fn(bands[b], pieceOffset[b]);
+            }
+        });
+    };
+
+    Utils::ParallelFor(nb, nb, 1, [&](int begin, int end) {
+        for (int b = begin; b < end; ++b) {
+            LabelBand(a, bands[b]);
+        }
+    });
+    JoinBands();
+    forBands([this](Band &band, int offset) { CountRoots(band, offset); });
+    NumberClusters();
+    if (!seam.empty()) {
+        PrepareTables();
+        forBands([this](Band &band, int offset) { SeamAngles(band, offset); });
+        MergeSeam(false);
+        forBands([this](Band &band, int offset) { SeamOffsets(band, offset); });
+        MergeSeam(true);
+    }
+    Finish();
+    return static_cast<int>(clusters.size());
+}
+
+const std::vector<int> &ClusterLabeller::LabelMap()
+{
+    if (labelsValid) {
+        return labels;
+    }
+    labels.assign(static_cast<std::size_t>(w) * h, -1);
+    const int nb = static_cast<int>(bands.size());
+    Utils::ParallelFor(nb, nb, 1, [&](int begin, int end) {
+        for (int b = begin; b < end; ++b) {
+            for (const Run &r : bands[b].runs) {
+                int *row = labels.data() + Utils::Index(0, r.y, w);
+                std::fill(row + r.x0, row + r.x1 + 1, pieceCluster[pieceOffset[b] + r.piece]);
+            }
+        }
+    });
+    labelsValid = true;
+    return labels;
+}
@@ -0,0 +1,180 @@
+#include "compositor.h"
+#include "automaton.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CRYSTALI_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// One colour per cell: c1 where the cell is live, c0 elsewhere.
+void ExpandRow(const uint8_t *cells, int n, uint32_t c0, uint32_t c1, uint32_t *out)
+{
+    int x = 0;
+#ifdef CRYSTALI_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v0 = _mm_set1_epi32(static_cast<int>(c0));
+    const __m128i v1 = _mm_set1_epi32(static_cast<int>(c1));
+    for (; x + 16 <= n; x += 16) {
+        const __m128i dead8 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + x)), zero);
+        const __m128i dead16lo = _mm_unpacklo_epi8(dead8, dead8);
+        const __m128i dead16hi = _mm_unpackhi_epi8(dead8, dead8);
+        const __m128i dead[4] = {_mm_unpacklo_epi16(dead16lo, dead16lo), _mm_unpackhi_epi16(dead16lo, dead16lo),
+                                 _mm_unpacklo_epi16(dead16hi, dead16hi), _mm_unpackhi_epi16(dead16hi, dead16hi)};
+        for (int k = 0; k < 4; ++k) {
+            const __m128i px = _mm_or_si128(_mm_and_si128(dead[k], v0), _mm_andnot_si128(dead[k], v1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x + 4 * k), px);
+        }
+    }
+#endif
+    for (; x < n; ++x) {
+        out[x] = cells[x] ? c1 : c0;
+    }
+}
+
+// Every colour repeated `zoom` times.
+void Replicate(const uint32_t *in, int n, int zoom, uint32_t *out)
+{
+    int x = 0;
+#ifdef CRYSTALI_SSE2
+    if (zoom == 2) {
+        for (; x + 4 <= n; x += 4) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * x), _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * x + 4), _mm_unpackhi_epi32(v, v));
+        }
+    } else if (zoom >= 4) {
+        for (; x < n; ++x) {
+            const __m128i v = _mm_set1_epi32(static_cast<int>(in[x]));
+            uint32_t *o = out + static_cast<std::size_t>(x) * zoom;
+            int k = 0;
+            for (; k + 4 <= zoom; k += 4) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(o + k), v);
+            }
+            std::fill(o + k, o + zoom, in[x]);
+        }
+    }
+#endif
+    for (; x < n; ++x) {
+        std::fill_n(out + static_cast<std::size_t>(x) * zoom, zoom, in[x]);
+    }
+}
+
+inline uint32_t Blend(uint32_t dst, uint32_t src, uint32_t alpha)
+{
+    uint32_t out = 0xFF000000u;
+    for (int shift = 0; shift < 24; shift += 8) {
+        const uint32_t t = ((src >> shift) & 0xFFu) * alpha + ((dst >> shift) & 0xFFu) * (255 - alpha) + 128;
+        out |= ((t + (t >> 8)) >> 8) << shift;  // t / 255, rounded
+    }
+    return out;
+}
+
+}  // namespace
+
+void Compositor::Compose(const Automaton &a, int dstW, int dstH, const FrameStyle &style, std::vector<uint32_t> &frame)
+{
+    frame.resize(static_cast<std::size_t>(std::max(0, dstW)) * std::max(0, dstH));
+    if (dstW <= 0 || dstH <= 0 || a.Width() <= 0 || a.Height() <= 0) {
+        return;
+    }
+    if (a.Width() > dstW || a.Height() > dstH) {
+        ComposeDensity(a, dstW, dstH, style, frame.data());
+        return;
+    }
+    ComposeCells(a, dstW, dstH, style, frame.data());
+    if (style.showGrid) {
+        OverlayGrid(a.Width(), a.Height(), dstW, dstH, style, frame.data());
+    }
+}
+
+void Compositor::ComposeCells(const Automaton &a, int dstW, int dstH, const FrameStyle &style, uint32_t *frame)
+{
+    const int srcW = a.Width();
+    const int srcH = a.Height();
+    const uint8_t *grid = a.Data().data();
+    const bool integerZoom = dstW % srcW == 0;
+
+    cellRow.resize(srcW);
+    if (!integerZoom) {
+        colOf.resize(dstW);
+        for (int px = 0; px < dstW; ++px) {
+            colOf[px] = static_cast<int>(static_cast<long long>(px) * srcW / dstW);
+        }
+    }
+
+    int lastY = -1;
+    for (int py = 0; py < dstH; ++py) {
+        uint32_t *out = frame + static_cast<std::size_t>(py) * dstW;
+        const int y = static_cast<int>(static_cast<long long>(py) * srcH / dstH);
+        if (y == lastY) {
+            std::memcpy(out, out - dstW, static_cast<std::size_t>(dstW) * sizeof(uint32_t));
+            continue;
+        }
+        lastY = y;
+
+        const uint8_t *cells = grid + Utils::Index(0, y, srcW);
+        if (integerZoom && dstW == srcW) {
+            ExpandRow(cells, srcW, style.color0, style.color1, out);
+            continue;
+        }
+        ExpandRow(cells, srcW, style.color0, style.color1, cellRow.data());
+        if (integerZoom) {
+            Replicate(cellRow.data(), srcW, dstW / srcW, out);
+        } else {
+            for (int px = 0; px < dstW; ++px) {
+                out[px] = cellRow[colOf[px]];
+            }
+        }
+    }
+}
+
+void Compositor::ComposeDensity(const Automaton &a, int dstW, int dstH, const FrameStyle &style, uint32_t *frame)
+{
+    pyramid.Update(a);
+    pyramid.Resample(a, dstW, dstH, density);
+
+    uint32_t palette[256];
+    for (uint32_t d = 0; d < 256; ++d) {
+        palette[d] = Blend(style.color0, style.color1, d);
+    }
+    const std::size_t n = density.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        frame[i] = palette[density[i]];
+    }
+}
+
+void Compositor::OverlayGrid(int srcW, int srcH, int dstW, int dstH, const FrameStyle &style, uint32_t *frame) const
+{
+    const uint32_t alpha = style.gridAlpha;
+    // Lines sit on the first pixel of every cell after the first, as the GDI version drew them.
+    for (int y = 1; y < srcH; ++y) {
+        uint32_t *row = frame + static_cast<std::size_t>(static_cast<long long>(y) * dstH / srcH) * dstW;
+        for (int px = 0; px < dstW; ++px) {
+            row[px] = Blend(row[px], style.gridColor, alpha);
+        }
+    }
+    std::vector<int> cols;
+    cols.reserve(srcW);
+    for (int x = 1; x < srcW; ++x) {
+        cols.push_back(static_cast<int>(static_cast<long long>(x) * dstW / srcW));
+    }
+    int lineRow = 1;
+    for (int py = 0; py < dstH; ++py) {
+        // Skip the pixels of horizontal lines, which are blended already.
+        if (lineRow < srcH && py == static_cast<int>(static_cast<long long>(lineRow) * dstH / srcH)) {
+            ++lineRow;
+            continue;
+        }
+        uint32_t *row = frame + static_cast<std::size_t>(py) * dstW;
+        for (int px : cols) {
+            row[px] = Blend(row[px], style.gridColor, alpha);
+        }
+    }
+}
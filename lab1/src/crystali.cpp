@@ -0,0 +1,269 @@
+#include "crystali.h"
+#include "automaton.h"
+#include "config.h"
+#include "snapshot.h"
+
+#include <limits>
+#include <mutex>
+#include <new>
+#include <string>
+
+struct crystali_automaton {
+    std::mutex lock;
+    Automaton automaton;
+};
+
+namespace
+{
+
+// Runs fn under the instance lock; no exception crosses the C boundary.
+template <typename Fn>
+crystali_status Locked(crystali_automaton *a, Fn &&fn)
+{
+    if (!a) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    try {
+        std::lock_guard<std::mutex> guard(a->lock);
+        return fn(a->automaton);
+    } catch (const std::bad_alloc &) {
+        return CRYSTALI_OUT_OF_MEMORY;
+    } catch (...) {
+        return CRYSTALI_INTERNAL_ERROR;
+    }
+}
+
+bool ValidSize(int32_t width, int32_t height)
+{
+    return width > 0 && height > 0 &&
+           static_cast<int64_t>(width) * height <= std::numeric_limits<int32_t>::max();
+}
+
+// Checks that a caller buffer of `size` bytes holds the whole grid in the given layout.
+bool FitsBuffer(const Automaton &a, const void *cells, size_t size, size_t stride, crystali_layout layout)
+{
+    size_t row = 0;
+    if (layout == CRYSTALI_LAYOUT_BYTES) {
+        row = static_cast<size_t>(a.Width());
+    } else if (layout == CRYSTALI_LAYOUT_BITS) {
+        row = (static_cast<size_t>(a.Width()) + 7) / 8;
+    } else {
+        return false;
+    }
+    if (!cells || stride < row) {
+        return false;
+    }
+    const size_t rows = static_cast<size_t>(a.Height()) - 1;
+    return rows <= (std::numeric_limits<size_t>::max() - row) / stride && rows * stride + row <= size;
+}
+
+}  // namespace
+
+extern "C" {
+
+crystali_automaton *crystali_create(int32_t width, int32_t height)
+{
+    if (!ValidSize(width, height)) {
+        return nullptr;
+    }
+    try {
+        crystali_automaton *a = new crystali_automaton;
+        a->automaton.Resize(width, height);
+        return a;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void crystali_destroy(crystali_automaton *a)
+{
+    delete a;
+}
+
+crystali_status crystali_resize(crystali_automaton *a, int32_t width, int32_t height)
+{
+    if (!ValidSize(width, height)) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        au.Resize(width, height);
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_get_size(crystali_automaton *a, int32_t *width, int32_t *height)
+{
+    if (!width || !height) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        *width = au.Width();
+        *height = au.Height();
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_set_rule(crystali_automaton *a, uint32_t rule)
+{
+    if (rule >= (1u << Cfg::Automaton::RULE_BITS_COUNT)) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        au.SetRuleBits(static_cast<uint16_t>(rule));
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_set_wrap(crystali_automaton *a, int wrap)
+{
+    return Locked(a, [&](Automaton &au) {
+        au.SetWrap(wrap != 0);
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_set_mode(crystali_automaton *a, crystali_mode mode)
+{
+    UpdateMode m = UpdateMode::SYNCHRONOUS;
+    switch (mode) {
+        case CRYSTALI_MODE_SYNCHRONOUS:
+            m = UpdateMode::SYNCHRONOUS;
+            break;
+        case CRYSTALI_MODE_RANDOM_SEQUENTIAL:
+            m = UpdateMode::RANDOM_SEQUENTIAL;
+            break;
+        case CRYSTALI_MODE_CHECKERBOARD:
+            m = UpdateMode::CHECKERBOARD;
+            break;
+        default:
+            return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        au.SetMode(m);
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_set_seed(crystali_automaton *a, uint64_t seed)
+{
+    return Locked(a, [&](Automaton &au) {
+        au.SetSeed(seed);
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_set_threads(crystali_automaton *a, int32_t threads)
+{
+    if (threads < 0) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        au.SetThreads(threads);
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_load_state(crystali_automaton *a, const void *cells, size_t size, size_t stride,
+                                    crystali_layout layout)
+{
+    return Locked(a, [&](Automaton &au) {
+        if (!FitsBuffer(au, cells, size, stride, layout)) {
+            return CRYSTALI_INVALID_ARGUMENT;
+        }
+        if (layout == CRYSTALI_LAYOUT_BITS) {
+            au.LoadBits(static_cast<const uint8_t *>(cells), stride);
+        } else {
+            au.LoadCells(static_cast<const uint8_t *>(cells), stride);
+        }
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_store_state(crystali_automaton *a, void *cells, size_t size, size_t stride,
+                                     crystali_layout layout)
+{
+    return Locked(a, [&](Automaton &au) {
+        if (!FitsBuffer(au, cells, size, stride, layout)) {
+            return CRYSTALI_INVALID_ARGUMENT;
+        }
+        if (layout == CRYSTALI_LAYOUT_BITS) {
+            au.StoreBits(static_cast<uint8_t *>(cells), stride);
+        } else {
+            au.StoreCells(static_cast<uint8_t *>(cells), stride);
+        }
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_step(crystali_automaton *a, int32_t generations)
+{
+    if (generations < 0) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        if (generations > 0) {
+            au.Step(generations);
+        }
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_get_stats(crystali_automaton *a, crystali_stats *stats)
+{
+    if (!stats) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        const BoundingBox &b = au.Bounds();
+        stats->iteration = au.Iteration();
+        stats->population = au.Population();
+        stats->front = au.FrontLength();
+        stats->version = au.Version();
+        stats->min_x = b.minX;
+        stats->min_y = b.minY;
+        stats->max_x = b.maxX;
+        stats->max_y = b.maxY;
+        return CRYSTALI_OK;
+    });
+}
+
+crystali_status crystali_save_snapshot(crystali_automaton *a, const char *path)
+{
+    if (!path) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        std::string err;
+        return Snapshot::Save(au, path, err) ? CRYSTALI_OK : CRYSTALI_IO_ERROR;
+    });
+}
+
+crystali_status crystali_load_snapshot(crystali_automaton *a, const char *path)
+{
+    if (!path) {
+        return CRYSTALI_INVALID_ARGUMENT;
+    }
+    return Locked(a, [&](Automaton &au) {
+        std::string err;
+        return Snapshot::Load(au, path, err) ? CRYSTALI_OK : CRYSTALI_IO_ERROR;
+    });
+}
+
+const char *crystali_status_string(crystali_status status)
+{
+    switch (status) {
+        case CRYSTALI_OK:
+            return "ok";
+        case CRYSTALI_INVALID_ARGUMENT:
+            return "invalid argument";
+        case CRYSTALI_OUT_OF_MEMORY:
+            return "out of memory";
+        case CRYSTALI_IO_ERROR:
+            return "cannot read or write the snapshot";
+        case CRYSTALI_INTERNAL_ERROR:
+            return "internal error";
+    }
+    return "unknown status";
+}
+
+}  // extern "C"
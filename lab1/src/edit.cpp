@@ -0,0 +1,224 @@
+#include "edit.h"
+#include "config.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+// Narrows [lo, hi] to the x satisfying L <= a * x + c <= U.
+void ClipLinear(double a, double c, double L, double U, double &lo, double &hi)
+{
+    if (a == 0.0) {
+        if (c < L || c > U) {
+            hi = lo - 1.0;
+        }
+        return;
+    }
+    double x0 = (L - c) / a;
+    double x1 = (U - c) / a;
+    if (a < 0.0) {
+        std::swap(x0, x1);
+    }
+    lo = std::max(lo, x0);
+    hi = std::min(hi, x1);
+}
+
+// Widens [lo, hi] by the chord of the disc of radius r around (cx, cy) on row y.
+void UniteDisc(int cx, int cy, int r, int y, double &lo, double &hi)
+{
+    const double dy = static_cast<double>(y - cy);
+    const double rest = static_cast<double>(r) * r - dy * dy;
+    if (rest < 0.0) {
+        return;
+    }
+    const double s = std::sqrt(rest);
+    lo = std::min(lo, cx - s);
+    hi = std::max(hi, cx + s);
+}
+}  // namespace
+
+EditTransaction::EditTransaction(Automaton &target) : a(target)
+{
+}
+
+EditTransaction::~EditTransaction()
+{
+    Commit();
+}
+
+void EditTransaction::Cell(int x, int y, uint8_t v)
+{
+    if (x < 0 || y < 0 || x >= a.w || y >= a.h) {
+        return;
+    }
+    Put(Utils::Index(x, y, a.w), v ? 1u : 0u);
+}
+
+void EditTransaction::Span(int y, int x0, int x1, uint8_t v)
+{
+    if (y < 0 || y >= a.h) {
+        return;
+    }
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, a.w - 1);
+    const int base = Utils::Index(0, y, a.w);
+    for (int x = x0; x <= x1; ++x) {
+        Put(base + x, v);
+    }
+}
+
+void EditTransaction::Rect(int x0, int y0, int x1, int y1, uint8_t v)
+{
+    const uint8_t nv = v ? 1u : 0u;
+    const int top = std::max(std::min(y0, y1), 0);
+    const int bottom = std::min(std::max(y0, y1), a.h - 1);
+    for (int y = top; y <= bottom; ++y) {
+        Span(y, std::min(x0, x1), std::max(x0, x1), nv);
+    }
+}
+
+void EditTransaction::Line(int x0, int y0, int x1, int y1, uint8_t v)
+{
+    const uint8_t nv = v ? 1u : 0u;
+    const int dx = std::abs(x1 - x0);
+    const int dy = -std::abs(y1 - y0);
+    const int sx = x0 < x1 ? 1 : -1;
+    const int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+        Cell(x0, y0, nv);
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        const int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void EditTransaction::Disc(int cx, int cy, int radius, uint8_t v)
+{
+    Stroke(cx, cy, cx, cy, radius, v);
+}
+
+void EditTransaction::Stroke(int x0, int y0, int x1, int y1, int radius, uint8_t v)
+{
+    const uint8_t nv = v ? 1u : 0u;
+    if (radius <= 0) {
+        Line(x0, y0, x1, y1, nv);
+        return;
+    }
+
+    // The capsule is convex, so each row meets it in one run of cells: the union of the chords
+    // of both end discs and of the band swept by the segment (points whose projection falls on
+    // the segment within `radius` of it).
+    const double dx = x1 - x0;
+    const double dy = y1 - y0;
+    const double len2 = dx * dx + dy * dy;
+    const double len = std::sqrt(len2);
+    const double r = radius;
+
+    const int top = std::max(std::min(y0, y1) - radius, 0);
+    const int bottom = std::min(std::max(y0, y1) + radius, a.h - 1);
+    for (int y = top; y <= bottom; ++y) {
+        double lo = static_cast<double>(a.w);
+        double hi = -1.0;
+        UniteDisc(x0, y0, radius, y, lo, hi);
+        UniteDisc(x1, y1, radius, y, lo, hi);
+
+        if (len2 > 0.0) {
+            const double ry = y - y0;
+            double blo = -static_cast<double>(a.w);
+            double bhi = 2.0 * a.w;
+            // |cross(d, p - p0)| <= r * |d| and 0 <= dot(d, p - p0) <= |d|^2, linear in x.
+            ClipLinear(-dy, dx * ry + dy * x0, -r * len, r * len, blo, bhi);
+            ClipLinear(dx, dy * ry - dx * x0, 0.0, len2, blo, bhi);
+            if (blo <= bhi) {
+                lo = std::min(lo, blo);
+                hi = std::max(hi, bhi);
+            }
+        }
+
+        if (lo <= hi) {
+            Span(y, static_cast<int>(std::ceil(lo)), static_cast<int>(std::floor(hi)), nv);
+        }
+    }
+}
+
+void EditTransaction::Blit(const uint8_t *pattern, int pw, int ph, int x, int y, BlitMode mode)
+{
+    const int px0 = std::max(0, -x);
+    const int py0 = std::max(0, -y);
+    const int px1 = std::min(pw, a.w - x);
+    const int py1 = std::min(ph, a.h - y);
+    for (int py = py0; py < py1; ++py) {
+        const uint8_t *src = pattern + Utils::Index(0, py, pw);
+        const int base = Utils::Index(x, y + py, a.w);
+        for (int px = px0; px < px1; ++px) {
+            const uint8_t s = src[px] ? 1u : 0u;
+            const int i = base + px;
+            switch (mode) {
+                case BlitMode::REPLACE:
+                    Put(i, s);
+                    break;
+                case BlitMode::OR:
+                    if (s) {
+                        Put(i, 1u);
+                    }
+                    break;
+                case BlitMode::XOR:
+                    if (s) {
+                        Put(i, a.grid[i] ^ 1u);
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+void EditTransaction::Commit()
+{
+    if (log.empty()) {
+        return;
+    }
+
+    // Keep the first logged value of every cell: that is its state before the transaction.
+    std::stable_sort(log.begin(), log.end(), [](const auto &l, const auto &r) { return l.first < r.first; });
+    log.erase(std::unique(log.begin(), log.end(), [](const auto &l, const auto &r) { return l.first == r.first; }),
+              log.end());
+    log.erase(std::remove_if(log.begin(), log.end(), [this](const auto &e) { return a.grid[e.first] == e.second; }),
+              log.end());
+
+    ++a.version;
+    const std::size_t total = static_cast<std::size_t>(a.w) * static_cast<std::size_t>(a.h);
+    if (log.size() * static_cast<std::size_t>(Cfg::Edit::REBUILD_DIVISOR) >= total) {
+        a.activeValid = false;
+        a.RecountMetrics();
+        log.clear();
+        return;
+    }
+
+    // Small batch: roll the grid back and replay the changes as single flips, which keeps the
+    // front length exact without rescanning.
+    for (const auto &e : log) {
+        a.grid[e.first] = e.second;
+    }
+    for (const auto &e : log) {
+        const int i = e.first;
+        a.FlipCell(i % a.w, i / a.w);
+        if (a.grid[i] && a.activeValid) {
+            a.active.push_back(i);
+            a.activeValid = a.active.size() < a.grid.size();
+        }
+    }
+    log.clear();
+}
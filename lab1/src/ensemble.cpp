@@ -0,0 +1,273 @@
+#include "ensemble.h"
+#include "bitrule.h"
+#include "config.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <ctime>
+
+Ensemble::Ensemble()
+{
+    circuit.Compile(ruleBits);
+    rng.state = static_cast<uint64_t>(std::time(nullptr));
+}
+
+void Ensemble::Resize(int W, int H, int lanes)
+{
+    w = std::max(1, W);
+    h = std::max(1, H);
+    blocks = std::max(1, (lanes + Cfg::Ensemble::WORD_BITS - 1) / Cfg::Ensemble::WORD_BITS);
+
+    const std::size_t words = static_cast<std::size_t>(w) * h * blocks;
+    grid.assign(words, 0);
+    next.assign(words, 0);
+    prev.assign(words, 0);
+    zeros.assign(static_cast<std::size_t>(w) * blocks, 0);
+    haltedAt.assign(Lanes(), -1);
+    period.assign(Lanes(), 0);
+    prevValid.assign(blocks, 0);
+    ResetHalting();
+    iter = 0;
+}
+
+void Ensemble::SetRuleBits(uint16_t bits)
+{
+    ruleBits = bits;
+    circuit.Compile(bits);
+}
+
+uint8_t Ensemble::Cell(int lane, int x, int y) const
+{
+    const uint64_t word = grid[WordIndex(x, y) + lane / Cfg::Ensemble::WORD_BITS];
+    return static_cast<uint8_t>((word >> (lane % Cfg::Ensemble::WORD_BITS)) & 1u);
+}
+
+void Ensemble::Set(int lane, int x, int y, uint8_t v)
+{
+    uint64_t &word = grid[WordIndex(x, y) + lane / Cfg::Ensemble::WORD_BITS];
+    const uint64_t bit = 1ull << (lane % Cfg::Ensemble::WORD_BITS);
+    word = v ? (word | bit) : (word & ~bit);
+    ResetLaneHalting(lane);
+}
+
+void Ensemble::LoadLane(int lane, const std::vector<uint8_t> &cells)
+{
+    const int b = lane / Cfg::Ensemble::WORD_BITS;
+    const uint64_t bit = 1ull << (lane % Cfg::Ensemble::WORD_BITS);
+    const int n = std::min(w * h, static_cast<int>(cells.size()));
+    for (int i = 0; i < w * h; ++i) {
+        uint64_t &word = grid[static_cast<std::size_t>(i) * blocks + b];
+        word = (i < n && cells[i]) ? (word | bit) : (word & ~bit);
+    }
+    ResetLaneHalting(lane);
+}
+
+void Ensemble::StoreLane(int lane, std::vector<uint8_t> &cells) const
+{
+    const int b = lane / Cfg::Ensemble::WORD_BITS;
+    const int shift = lane % Cfg::Ensemble::WORD_BITS;
+    cells.resize(static_cast<std::size_t>(w) * h);
+    for (int i = 0; i < w * h; ++i) {
+        cells[i] = static_cast<uint8_t>((grid[static_cast<std::size_t>(i) * blocks + b] >> shift) & 1u);
+    }
+}
+
+void Ensemble::Clear()
+{
+    std::fill(grid.begin(), grid.end(), 0);
+    ResetHalting();
+    iter = 0;
+}
+
+void Ensemble::Randomize(double p)
+{
+    if (p < 0.0) {
+        p = 0.0;
+    }
+    if (p > 1.0) {
+        p = 1.0;
+    }
+
+    // Each lane bit is Bernoulli(t / 2^P): fold fresh random words into the result with OR for the
+    // set bits of t and AND for the clear ones, least significant bit first.
+    const int precision = Cfg::Ensemble::RANDOM_PRECISION_BITS;
+    const uint64_t t = static_cast<uint64_t>(p * static_cast<double>(1ull << precision) + 0.5);
+    if (t == 0 || t >= (1ull << precision)) {
+        std::fill(grid.begin(), grid.end(), t == 0 ? 0ull : ~0ull);
+    } else {
+        int low = 0;
+        while (((t >> low) & 1u) == 0) {
+            ++low;
+        }
+        for (uint64_t &word : grid) {
+            uint64_t x = 0;
+            for (int k = low; k < precision; ++k) {
+                const uint64_t r = rng.Next();
+                x = ((t >> k) & 1u) ? (x | r) : (x & r);
+            }
+            word = x;
+        }
+    }
+
+    ResetHalting();
+    iter = 0;
+}
+
+void Ensemble::ResetHalting()
+{
+    std::fill(haltedAt.begin(), haltedAt.end(), -1);
+    std::fill(period.begin(), period.end(), 0);
+    running = Lanes();
+    std::fill(prevValid.begin(), prevValid.end(), 0);
+}
+
+void Ensemble::ResetLaneHalting(int lane)
+{
+    prevValid[lane / Cfg::Ensemble::WORD_BITS] &= ~(1ull << (lane % Cfg::Ensemble::WORD_BITS));
+    if (haltedAt[lane] >= 0) {
+        haltedAt[lane] = -1;
+        period[lane] = 0;
+        ++running;
+    }
+}
+
+void Ensemble::Step()
+{
+    const int B = blocks;
+    const BitRule::Minterms rule = BitRule::MintermsOf(ruleBits);
+
+    // Per-lane "changed since last generation" and "changed since two generations ago".
+    std::vector<uint64_t> diff1(B, 0);
+    std::vector<uint64_t> diff2(B, 0);
+
+    const std::size_t rowWords = static_cast<std::size_t>(w) * B;
+    planes.resize(rowWords * 3);
+    uint64_t *b0 = planes.data();
+    uint64_t *b1 = b0 + rowWords;
+    uint64_t *b2 = b1 + rowWords;
+
+    for (int y = 0; y < h; ++y) {
+        const uint64_t *row = grid.data() + WordIndex(0, y);
+        const uint64_t *up = zeros.data();
+        const uint64_t *down = zeros.data();
+        if (y > 0 || wrap) {
+            up = grid.data() + WordIndex(0, y == 0 ? h - 1 : y - 1);
+        }
+        if (y < h - 1 || wrap) {
+            down = grid.data() + WordIndex(0, y == h - 1 ? 0 : y + 1);
+        }
+        const uint64_t *old = prev.data() + WordIndex(0, y);
+        uint64_t *out = next.data() + WordIndex(0, y);
+
+        for (int x = 0; x < w; ++x) {
+            const std::size_t o = static_cast<std::size_t>(x) * B;
+            const uint64_t *l = zeros.data();
+            const uint64_t *r = zeros.data();
+            if (x > 0 || wrap) {
+                l = row + static_cast<std::size_t>(x == 0 ? w - 1 : x - 1) * B;
+            }
+            if (x < w - 1 || wrap) {
+                r = row + static_cast<std::size_t>(x == w - 1 ? 0 : x + 1) * B;
+            }
+            for (int b = 0; b < B; ++b) {
+                BitRule::Count4(l[b], r[b], up[o + b], down[o + b], b0[o + b], b1[o + b], b2[o + b]);
+            }
+        }
+
+        if (circuit.Valid()) {
+            circuit.Run(row, b0, b1, b2, out, rowWords, circuitScratch);
+        } else {
+            for (std::size_t j = 0; j < rowWords; ++j) {
+                out[j] = BitRule::ApplyGeneric(rule, row[j], b0[j], b1[j], b2[j]);
+            }
+        }
+
+        for (std::size_t o = 0; o < rowWords; o += B) {
+            for (int b = 0; b < B; ++b) {
+                diff1[b] |= out[o + b] ^ row[o + b];
+                diff2[b] |= out[o + b] ^ old[o + b];
+            }
+        }
+    }
+
+    // prev <- grid <- next; the old prev buffer becomes scratch for the next step.
+    prev.swap(grid);
+    grid.swap(next);
+    ++iter;
+
+    for (int lane = 0; lane < Lanes(); ++lane) {
+        if (haltedAt[lane] >= 0) {
+            continue;
+        }
+        const int b = lane / Cfg::Ensemble::WORD_BITS;
+        const uint64_t bit = 1ull << (lane % Cfg::Ensemble::WORD_BITS);
+        if (!(diff1[b] & bit)) {
+            haltedAt[lane] = static_cast<int32_t>(iter);
+            period[lane] = 1;
+            --running;
+        } else if ((prevValid[b] & bit) && !(diff2[b] & bit)) {
+            haltedAt[lane] = static_cast<int32_t>(iter);
+            period[lane] = 2;
+            --running;
+        }
+    }
+    std::fill(prevValid.begin(), prevValid.end(), ~0ull);
+}
+
+int Ensemble::Run(int maxGens)
+{
+    int gens = 0;
+    while (gens < maxGens && running > 0) {
+        Step();
+        ++gens;
+    }
+    return gens;
+}
+
+std::vector<uint32_t> Ensemble::Populations() const
+{
+    const int B = blocks;
+    const std::size_t cells = static_cast<std::size_t>(w) * h;
+    int planes = 1;
+    while ((static_cast<std::size_t>(1) << planes) <= cells) {
+        ++planes;
+    }
+
+    // Bit-sliced vertical counters: word cnt[k * B + b] holds bit k of the count of every lane.
+    std::vector<uint64_t> cnt(static_cast<std::size_t>(planes) * B, 0);
+    for (std::size_t i = 0; i < cells; ++i) {
+        for (int b = 0; b < B; ++b) {
+            uint64_t carry = grid[i * B + b];
+            for (int k = 0; k < planes && carry; ++k) {
+                uint64_t &c = cnt[static_cast<std::size_t>(k) * B + b];
+                const uint64_t t = c & carry;
+                c ^= carry;
+                carry = t;
+            }
+        }
+    }
+
+    std::vector<uint32_t> pop(Lanes(), 0);
+    for (int lane = 0; lane < Lanes(); ++lane) {
+        const int b = lane / Cfg::Ensemble::WORD_BITS;
+        const int shift = lane % Cfg::Ensemble::WORD_BITS;
+        uint32_t v = 0;
+        for (int k = 0; k < planes; ++k) {
+            v |= static_cast<uint32_t>((cnt[static_cast<std::size_t>(k) * B + b] >> shift) & 1u) << k;
+        }
+        pop[lane] = v;
+    }
+    return pop;
+}
+
+std::vector<Ensemble::LaneResult> Ensemble::Results() const
+{
+    const std::vector<uint32_t> pop = Populations();
+    std::vector<LaneResult> out(Lanes());
+    for (int lane = 0; lane < Lanes(); ++lane) {
+        out[lane].population = pop[lane];
+        out[lane].haltedAt = haltedAt[lane];
+        out[lane].period = period[lane];
+    }
+    return out;
+}
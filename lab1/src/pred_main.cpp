@@ -0,0 +1,145 @@
+#include "automaton.h"
+#include "config.h"
+#include "predecessor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void PrintUsage()
+{
+    std::printf("Usage:\n");
+    std::printf("  crystali_pred [options] <target.cells>\n");
+    std::printf("    --rule N        rule number 0..1023 (default %u)\n", Cfg::Automaton::DEFAULT_RULE);
+    std::printf("    --no-wrap       bounded grid instead of a torus\n");
+    std::printf("    --gens K        search K generations back (default 1)\n");
+    std::printf("    --threads T     worker threads (default: all cores)\n");
+    std::printf("    --timeout S     give up after S seconds (default: no limit)\n");
+    std::printf("  Target: one row per line, 'O'/'o'/'1'/'#'/'*' alive, anything else dead, '!' comments.\n");
+}
+
+bool ParseInt(const char *s, int &out)
+{
+    char *end = nullptr;
+    const long v = std::strtol(s, &end, 10);
+    if (!end || *end != '\0') {
+        return false;
+    }
+    out = static_cast<int>(v);
+    return true;
+}
+
+bool LoadTarget(const std::string &path, std::vector<uint8_t> &cells, int &w, int &h)
+{
+    std::ifstream ifs(path);
+    if (!ifs) {
+        return false;
+    }
+    std::vector<std::string> rows;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] == '!') {
+            continue;
+        }
+        rows.push_back(line);
+    }
+    while (!rows.empty() && rows.back().empty()) {
+        rows.pop_back();
+    }
+
+    w = 0;
+    for (const std::string &r : rows) {
+        w = std::max(w, static_cast<int>(r.size()));
+    }
+    h = static_cast<int>(rows.size());
+    if (w == 0 || h == 0) {
+        return false;
+    }
+    cells.assign(static_cast<std::size_t>(w) * h, 0);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < static_cast<int>(rows[y].size()); ++x) {
+            const char c = rows[y][x];
+            cells[Utils::Index(x, y, w)] = (c == 'O' || c == 'o' || c == '1' || c == '#' || c == '*') ? 1u : 0u;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    PredecessorOptions opt;
+    std::string path;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool hasValue = i + 1 < argc;
+        int v = 0;
+        bool ok = true;
+        if (a == "--rule" && hasValue) {
+            ok = ParseInt(argv[++i], v) && v >= 0 && v < (1 << Cfg::Automaton::RULE_BITS_COUNT);
+            opt.ruleBits = static_cast<uint16_t>(v);
+        } else if (a == "--no-wrap") {
+            opt.wrap = false;
+        } else if (a == "--gens" && hasValue) {
+            ok = ParseInt(argv[++i], opt.generations) && opt.generations >= 1;
+        } else if (a == "--threads" && hasValue) {
+            ok = ParseInt(argv[++i], opt.threads);
+        } else if (a == "--timeout" && hasValue) {
+            ok = ParseInt(argv[++i], v) && v >= 0;
+            opt.timeoutSec = v;
+        } else if (path.empty() && a.rfind("--", 0) != 0) {
+            path = a;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage();
+            std::fprintf(stderr, "Error: invalid argument %s\n", a.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<uint8_t> target;
+    int w = 0, h = 0;
+    if (path.empty() || !LoadTarget(path, target, w, h)) {
+        PrintUsage();
+        std::fprintf(stderr, "Error: cannot read target %s\n", path.c_str());
+        return 1;
+    }
+
+    PredecessorSearch search(opt);
+    std::vector<uint8_t> pred;
+    const PredecessorStatus st = search.Run(target, w, h, pred, [](const PredecessorProgress &p) {
+        std::fprintf(stderr, "[pred] %llu nodes, depth %d, %d branches left, %.1fs\n",
+                     static_cast<unsigned long long>(p.nodes), p.deepest, p.pendingBranches, p.elapsedSec);
+    });
+
+    switch (st) {
+        case PredecessorStatus::FOUND:
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    std::putchar(pred[Utils::Index(x, y, w)] ? 'O' : '.');
+                }
+                std::putchar('\n');
+            }
+            std::fprintf(stderr, "Found after %llu nodes\n", static_cast<unsigned long long>(search.Nodes()));
+            return 0;
+        case PredecessorStatus::NONE:
+            std::printf("No predecessor exists (%llu nodes)\n", static_cast<unsigned long long>(search.Nodes()));
+            return 3;
+        case PredecessorStatus::TIMEOUT:
+        default:
+            std::fprintf(stderr, "Timed out after %llu nodes\n", static_cast<unsigned long long>(search.Nodes()));
+            return 4;
+    }
+}
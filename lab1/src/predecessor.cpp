@@ -0,0 +1,416 @@
+#include "predecessor.h"
+#include "automaton.h"
+#include "config.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+
+// Partial assignment of all searched generations: -1 unknown, otherwise the cell state. The trail
+// records assignment order so a branch can be undone to any earlier point.
+struct Branch {
+    std::vector<int8_t> val;
+    std::vector<int> trail;
+};
+
+// Variable (j - 1) * n + c is cell c, j generations before the target; constraint (j - 1) * n + c
+// says that stepping generation j yields cell c of generation j - 1 (the target when j == 1).
+class Solver
+{
+public:
+    Solver(const std::vector<int> &nb, const std::vector<uint8_t> &target, uint16_t ruleBits, int gens)
+        : nb(nb), target(target), n(static_cast<int>(target.size())), inQueue(static_cast<std::size_t>(n) * gens, 0)
+    {
+        for (int idxRow = 0; idxRow < Cfg::Automaton::RULE_BITS_COUNT; ++idxRow) {
+            table[idxRow] = static_cast<uint8_t>((ruleBits >> (Cfg::Automaton::RULE_TOP_BIT_POS - idxRow)) & 1u);
+        }
+        // Decide cell by cell in row-major order, all generations of a cell together, earliest first.
+        order.reserve(inQueue.size());
+        for (int c = 0; c < n; ++c) {
+            for (int j = gens - 1; j >= 0; --j) {
+                order.push_back(j * n + c);
+            }
+        }
+    }
+
+    bool Start(Branch &b)
+    {
+        b.val.assign(inQueue.size(), -1);
+        b.trail.clear();
+        for (int q = 0; q < static_cast<int>(inQueue.size()); ++q) {
+            Enqueue(q);
+        }
+        return Propagate(b);
+    }
+
+    bool Assign(Branch &b, int var, int8_t v)
+    {
+        Set(b, var, v);
+        return Propagate(b);
+    }
+
+    void Undo(Branch &b, std::size_t mark)
+    {
+        while (b.trail.size() > mark) {
+            b.val[b.trail.back()] = -1;
+            b.trail.pop_back();
+        }
+    }
+
+    // Position in the decision order of the first unknown variable at or after `from`, or -1.
+    int FirstUnknown(const Branch &b, int from) const
+    {
+        for (int i = from; i < static_cast<int>(order.size()); ++i) {
+            if (b.val[order[i]] < 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    inline int VarAt(int pos) const
+    {
+        return order[pos];
+    }
+
+private:
+    void Enqueue(int q)
+    {
+        if (!inQueue[q]) {
+            inQueue[q] = 1;
+            queue.push_back(q);
+        }
+    }
+
+    void Set(Branch &b, int var, int8_t v)
+    {
+        b.val[var] = v;
+        b.trail.push_back(var);
+
+        // Constraints reading var as an input: its own cell and its neighbours in the same generation.
+        const int base = var - var % n;
+        const int c = var % n;
+        Enqueue(var);
+        for (int k = 0; k < Cfg::Automaton::NEIGHBORS_VON_NEUMANN; ++k) {
+            const int m = nb[c * Cfg::Automaton::NEIGHBORS_VON_NEUMANN + k];
+            if (m >= 0) {
+                Enqueue(base + m);
+            }
+        }
+        // The constraint one generation earlier whose output is var.
+        if (var + n < static_cast<int>(inQueue.size())) {
+            Enqueue(var + n);
+        }
+    }
+
+    bool Propagate(Branch &b)
+    {
+        while (!queue.empty()) {
+            const int q = queue.back();
+            queue.pop_back();
+            inQueue[q] = 0;
+            if (!Revise(b, q)) {
+                for (int r : queue) {
+                    inQueue[r] = 0;
+                }
+                queue.clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Checks constraint q against every completion of its unknown cells and assigns the cells
+    // that take the same value in all satisfying completions.
+    bool Revise(Branch &b, int q)
+    {
+        const int base = q - q % n;
+        const int c = q % n;
+        const int outVar = q >= n ? q - n : -1;
+        const int *nbc = &nb[c * Cfg::Automaton::NEIGHBORS_VON_NEUMANN];
+
+        int vars[Cfg::Automaton::NEIGHBORS_VON_NEUMANN + 2];
+        int nv = 0;
+        auto addUnknown = [&](int v) {
+            if (v < 0 || b.val[v] >= 0) {
+                return;
+            }
+            for (int k = 0; k < nv; ++k) {
+                if (vars[k] == v) {
+                    return;
+                }
+            }
+            vars[nv++] = v;
+        };
+        addUnknown(q);
+        for (int k = 0; k < Cfg::Automaton::NEIGHBORS_VON_NEUMANN; ++k) {
+            addUnknown(nbc[k] >= 0 ? base + nbc[k] : -1);
+        }
+        addUnknown(outVar);
+
+        auto value = [&](int v, int combo) -> int {
+            if (b.val[v] >= 0) {
+                return b.val[v];
+            }
+            for (int k = 0; k < nv; ++k) {
+                if (vars[k] == v) {
+                    return (combo >> k) & 1;
+                }
+            }
+            return 0;
+        };
+
+        const int combos = 1 << nv;
+        int any1 = 0;
+        int all1 = combos - 1;
+        bool sat = false;
+        for (int combo = 0; combo < combos; ++combo) {
+            int cnt = 0;
+            for (int k = 0; k < Cfg::Automaton::NEIGHBORS_VON_NEUMANN; ++k) {
+                cnt += nbc[k] >= 0 ? value(base + nbc[k], combo) : 0;
+            }
+            const int idxRow = (value(q, combo) ? Cfg::Automaton::RULE_ROWS_PER_CURR : 0) + cnt;
+            const int want = outVar >= 0 ? value(outVar, combo) : target[c];
+            if (table[idxRow] == want) {
+                sat = true;
+                any1 |= combo;
+                all1 &= combo;
+            }
+        }
+        if (!sat) {
+            return false;
+        }
+        for (int k = 0; k < nv; ++k) {
+            if ((all1 >> k) & 1) {
+                Set(b, vars[k], 1);
+            } else if (!((any1 >> k) & 1)) {
+                Set(b, vars[k], 0);
+            }
+        }
+        return true;
+    }
+
+private:
+    const std::vector<int> &nb;
+    const std::vector<uint8_t> &target;
+    const int n;
+    uint8_t table[Cfg::Automaton::RULE_BITS_COUNT]{};
+    std::vector<int> order;
+    std::vector<uint8_t> inQueue;
+    std::vector<int> queue;
+};
+
+}  // namespace
+
+PredecessorSearch::PredecessorSearch(const PredecessorOptions &o) : opt(o)
+{
+}
+
+PredecessorOptions PredecessorSearch::OptionsFrom(const Automaton &a, int generations)
+{
+    PredecessorOptions o;
+    o.ruleBits = a.RuleBits();
+    o.wrap = a.Wrap();
+    o.generations = generations;
+    return o;
+}
+
+bool PredecessorSearch::Expired() const
+{
+    if (opt.timeoutSec <= 0.0) {
+        return false;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= opt.timeoutSec;
+}
+
+PredecessorStatus PredecessorSearch::Run(const std::vector<uint8_t> &targetIn,
+                                         int W,
+                                         int H,
+                                         std::vector<uint8_t> &out,
+                                         const std::function<void(const PredecessorProgress &)> &onProgress)
+{
+    w = std::max(1, W);
+    h = std::max(1, H);
+    nodes = 0;
+    deepest = 0;
+    timedOut = false;
+    start = std::chrono::steady_clock::now();
+
+    const int gens = std::max(1, opt.generations);
+    const int cells = w * h;
+    std::vector<uint8_t> target(targetIn);
+    target.resize(static_cast<std::size_t>(cells), 0);
+
+    // Neighbour table with the same multiplicities as Automaton::CountNeighbors4.
+    const int K = Cfg::Automaton::NEIGHBORS_VON_NEUMANN;
+    nb.assign(static_cast<std::size_t>(cells) * K, -1);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int *n = &nb[static_cast<std::size_t>(Utils::Index(x, y, w)) * K];
+            if (opt.wrap) {
+                n[0] = Utils::Index(x, y == 0 ? h - 1 : y - 1, w);
+                n[1] = Utils::Index(x, y == h - 1 ? 0 : y + 1, w);
+                n[2] = Utils::Index(x == 0 ? w - 1 : x - 1, y, w);
+                n[3] = Utils::Index(x == w - 1 ? 0 : x + 1, y, w);
+            } else {
+                n[0] = y > 0 ? Utils::Index(x, y - 1, w) : -1;
+                n[1] = y < h - 1 ? Utils::Index(x, y + 1, w) : -1;
+                n[2] = x > 0 ? Utils::Index(x - 1, y, w) : -1;
+                n[3] = x < w - 1 ? Utils::Index(x + 1, y, w) : -1;
+            }
+        }
+    }
+
+    int threads = opt.threads;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    auto extract = [&](const Branch &b) {
+        const std::size_t first = static_cast<std::size_t>(gens - 1) * cells;
+        out.resize(static_cast<std::size_t>(cells));
+        for (int c = 0; c < cells; ++c) {
+            out[c] = static_cast<uint8_t>(b.val[first + c]);
+        }
+    };
+
+    Solver root(nb, target, opt.ruleBits, gens);
+    Branch first;
+    if (!root.Start(first)) {
+        return PredecessorStatus::NONE;
+    }
+
+    // Breadth-first split of the root into independent branches for the workers.
+    const std::size_t wanted = static_cast<std::size_t>(threads) * Cfg::Predecessor::BRANCHES_PER_THREAD;
+    std::deque<Branch> split{first};
+    while (!split.empty() && split.size() < wanted) {
+        Branch b = std::move(split.front());
+        split.pop_front();
+        const int pos = root.FirstUnknown(b, 0);
+        if (pos < 0) {
+            extract(b);
+            return PredecessorStatus::FOUND;
+        }
+        for (int8_t v = 0; v <= 1; ++v) {
+            Branch child = b;
+            if (root.Assign(child, root.VarAt(pos), v)) {
+                split.push_back(std::move(child));
+            }
+        }
+    }
+    if (split.empty()) {
+        return PredecessorStatus::NONE;
+    }
+
+    std::vector<Branch> branches(std::make_move_iterator(split.begin()), std::make_move_iterator(split.end()));
+    std::atomic<std::size_t> nextBranch{0};
+    std::atomic<bool> stop{false};
+    std::mutex resultMtx;
+    bool found = false;
+    pending = static_cast<int>(branches.size());
+
+    auto worker = [&]() {
+        Solver solver(nb, target, opt.ruleBits, gens);
+        struct Decision {
+            int pos;
+            std::size_t mark;
+            bool triedOne;
+        };
+        std::vector<Decision> stack;
+        uint64_t local = 0;
+
+        for (;;) {
+            const std::size_t bi = nextBranch.fetch_add(1);
+            if (bi >= branches.size() || stop) {
+                break;
+            }
+            Branch &b = branches[bi];
+            stack.clear();
+
+            // Depth-first search over the decision order, 0 before 1.
+            bool ok = true;
+            for (;;) {
+                if (++local % Cfg::Predecessor::NODES_PER_FLUSH == 0) {
+                    nodes += Cfg::Predecessor::NODES_PER_FLUSH;
+                    if (static_cast<int>(stack.size()) > deepest) {
+                        deepest = static_cast<int>(stack.size());
+                    }
+                    if (!stop && Expired()) {
+                        timedOut = true;
+                        stop = true;
+                    }
+                    if (stop) {
+                        break;
+                    }
+                }
+                if (ok) {
+                    const int pos = solver.FirstUnknown(b, stack.empty() ? 0 : stack.back().pos + 1);
+                    if (pos < 0) {
+                        std::lock_guard<std::mutex> lock(resultMtx);
+                        if (!found) {
+                            found = true;
+                            extract(b);
+                        }
+                        stop = true;
+                        break;
+                    }
+                    stack.push_back(Decision{pos, b.trail.size(), false});
+                    ok = solver.Assign(b, solver.VarAt(pos), 0);
+                    continue;
+                }
+
+                // Backtrack to the deepest decision that still has the value 1 to try.
+                while (!stack.empty() && stack.back().triedOne) {
+                    solver.Undo(b, stack.back().mark);
+                    stack.pop_back();
+                }
+                if (stack.empty()) {
+                    break;
+                }
+                Decision &d = stack.back();
+                solver.Undo(b, d.mark);
+                d.triedOne = true;
+                ok = solver.Assign(b, solver.VarAt(d.pos), 1);
+            }
+            --pending;
+        }
+        nodes += local % Cfg::Predecessor::NODES_PER_FLUSH;
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+
+    auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(Cfg::Predecessor::PROGRESS_SECONDS);
+    while (pending > 0 && !stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(Cfg::Predecessor::POLL_MS));
+        if (Expired()) {
+            timedOut = true;
+            stop = true;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (onProgress && now >= nextReport) {
+            PredecessorProgress p;
+            p.nodes = nodes;
+            p.deepest = deepest;
+            p.pendingBranches = pending;
+            p.elapsedSec = std::chrono::duration<double>(now - start).count();
+            onProgress(p);
+            nextReport = now + std::chrono::seconds(Cfg::Predecessor::PROGRESS_SECONDS);
+        }
+    }
+    for (std::thread &t : pool) {
+        t.join();
+    }
+
+    if (found) {
+        return PredecessorStatus::FOUND;
+    }
+    return timedOut ? PredecessorStatus::TIMEOUT : PredecessorStatus::NONE;
+}
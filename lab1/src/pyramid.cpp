@@ -0,0 +1,236 @@
+#include "pyramid.h"
+#include "automaton.h"
+#include "config.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr int BASE = Cfg::Pyramid::BASE_SHIFT;
+constexpr int BLOCK = 1 << BASE;
+constexpr uint64_t BYTE_ONES = 0x0101010101010101ull;
+
+// Live cells in [x0, x1) x [y0, y1), read straight from the byte grid.
+uint32_t CountCells(const Automaton &a, int x0, int y0, int x1, int y1)
+{
+    const uint8_t *g = a.Data().data();
+    uint32_t n = 0;
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t *row = g + Utils::Index(0, y, a.Width());
+        for (int x = x0; x < x1; ++x) {
+            n += row[x] ? 1u : 0u;
+        }
+    }
+    return n;
+}
+}  // namespace
+
+uint32_t DensityPyramid::Count(int index, int bx, int by) const
+{
+    const Level &lv = levels[index];
+    return lv.counts[Utils::Index(bx, by, lv.w)];
+}
+
+void DensityPyramid::Rebuild(const Automaton &a)
+{
+    w = a.Width();
+    h = a.Height();
+    levels.clear();
+    for (int k = BASE;; ++k) {
+        Level lv;
+        lv.w = (w + (1 << k) - 1) >> k;
+        lv.h = (h + (1 << k) - 1) >> k;
+        lv.counts.assign(static_cast<std::size_t>(lv.w) * lv.h, 0);
+        levels.push_back(std::move(lv));
+        if (levels.back().w == 1 && levels.back().h == 1) {
+            break;
+        }
+    }
+
+    CountBaseBlocks(a, 0, 0, levels[0].w, levels[0].h);
+    for (int k = 1; k < Levels(); ++k) {
+        SumChildren(k, 0, 0, levels[k].w, levels[k].h);
+    }
+}
+
+void DensityPyramid::CountBaseBlocks(const Automaton &a, int bx0, int by0, int bx1, int by1)
+{
+    const uint8_t *g = a.Data().data();
+    Level &lv = levels[0];
+    for (int by = by0; by < by1; ++by) {
+        const int y0 = by * BLOCK;
+        const int y1 = std::min(y0 + BLOCK, h);
+        for (int bx = bx0; bx < bx1; ++bx) {
+            const int x0 = bx * BLOCK;
+            if (x0 + BLOCK > w) {
+                lv.counts[Utils::Index(bx, by, lv.w)] = CountCells(a, x0, y0, w, y1);
+                continue;
+            }
+            // Eight 0/1 bytes summed with one multiply: the top byte collects them all.
+            uint32_t n = 0;
+            for (int y = y0; y < y1; ++y) {
+                uint64_t v = 0;
+                std::memcpy(&v, g + Utils::Index(x0, y, w), sizeof(v));
+                n += static_cast<uint32_t>(((v & BYTE_ONES) * BYTE_ONES) >> 56);
+            }
+            lv.counts[Utils::Index(bx, by, lv.w)] = n;
+        }
+    }
+}
+
+void DensityPyramid::SumChildren(int k, int bx0, int by0, int bx1, int by1)
+{
+    const Level &child = levels[k - 1];
+    Level &lv = levels[k];
+    for (int by = by0; by < by1; ++by) {
+        for (int bx = bx0; bx < bx1; ++bx) {
+            uint32_t n = 0;
+            for (int cy = 2 * by; cy < std::min(2 * by + 2, child.h); ++cy) {
+                for (int cx = 2 * bx; cx < std::min(2 * bx + 2, child.w); ++cx) {
+                    n += child.counts[Utils::Index(cx, cy, child.w)];
+                }
+            }
+            lv.counts[Utils::Index(bx, by, lv.w)] = n;
+        }
+    }
+}
+
+void DensityPyramid::Update(const Automaton &a)
+{
+    if (a.Width() != w || a.Height() != h || levels.empty()) {
+        Rebuild(a);
+        builtVersion = a.Version();
+        return;
+    }
+    if (a.Version() == builtVersion) {
+        return;
+    }
+
+    // Changed tiles as rectangles of base blocks, then their ancestors level by level.
+    constexpr int TILE_BLOCKS_SHIFT = Cfg::Pyramid::TILE_SHIFT - BASE;
+    std::vector<std::pair<int, int>> dirty;
+    for (int ty = 0; ty < a.TilesY(); ++ty) {
+        for (int tx = 0; tx < a.TilesX(); ++tx) {
+            if (a.TileStamp(tx, ty) > builtVersion) {
+                dirty.emplace_back(tx, ty);
+            }
+        }
+    }
+    builtVersion = a.Version();
+    if (dirty.empty()) {
+        return;
+    }
+
+    for (int k = 0; k < Levels(); ++k) {
+        const int shift = TILE_BLOCKS_SHIFT - k;
+        if (shift >= 0) {
+            // Each tile covers 2^shift x 2^shift blocks of this level.
+            for (const auto &t : dirty) {
+                const int bx0 = t.first << shift;
+                const int by0 = t.second << shift;
+                const int bx1 = std::min(bx0 + (1 << shift), levels[k].w);
+                const int by1 = std::min(by0 + (1 << shift), levels[k].h);
+                if (k == 0) {
+                    CountBaseBlocks(a, bx0, by0, bx1, by1);
+                } else {
+                    SumChildren(k, bx0, by0, bx1, by1);
+                }
+            }
+            continue;
+        }
+        // Above the tile size several dirty tiles share a block; recount each block once.
+        std::vector<std::pair<int, int>> blocks;
+        blocks.reserve(dirty.size());
+        for (const auto &t : dirty) {
+            blocks.emplace_back(t.first >> -shift, t.second >> -shift);
+        }
+        std::sort(blocks.begin(), blocks.end());
+        blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+        for (const auto &b : blocks) {
+            SumChildren(k, b.first, b.second, b.first + 1, b.second + 1);
+        }
+    }
+}
+
+void DensityPyramid::Resample(const Automaton &a, int dstW, int dstH, std::vector<uint8_t> &density) const
+{
+    density.assign(static_cast<std::size_t>(std::max(0, dstW)) * std::max(0, dstH), 0);
+    if (dstW <= 0 || dstH <= 0 || levels.empty()) {
+        return;
+    }
+
+    // Pick the level whose blocks are no larger than a pixel's footprint.
+    const double scale = std::max(static_cast<double>(w) / dstW, static_cast<double>(h) / dstH);
+    int k = scale > 1.0 ? static_cast<int>(std::floor(std::log2(scale))) : 0;
+    k = std::min(k, BASE + Levels() - 1);
+
+    // Footprint of every destination column and row in cells, widened to whole blocks.
+    struct Span {
+        int c0, c1;  // cells
+        int b0, b1;  // blocks at level k, inclusive
+    };
+    auto spans = [k](int cells, int dst) {
+        std::vector<Span> out(dst);
+        for (int p = 0; p < dst; ++p) {
+            Span &s = out[p];
+            s.c0 = static_cast<int>(static_cast<long long>(p) * cells / dst);
+            s.c1 = std::max(s.c0 + 1, static_cast<int>(static_cast<long long>(p + 1) * cells / dst));
+            s.b0 = s.c0 >> k;
+            s.b1 = (s.c1 - 1) >> k;
+        }
+        return out;
+    };
+    const std::vector<Span> cols = spans(w, dstW);
+    const std::vector<Span> rows = spans(h, dstH);
+
+    if (k < BASE) {
+        // Fine zoom: sum the few grid rows under each destination row once, then every pixel
+        // adds up fewer than 2^BASE column sums.
+        const uint8_t *g = a.Data().data();
+        std::vector<uint32_t> colSum(w);
+        for (int py = 0; py < dstH; ++py) {
+            const Span &ry = rows[py];
+            std::fill(colSum.begin(), colSum.end(), 0u);
+            for (int y = ry.c0; y < ry.c1; ++y) {
+                const uint8_t *row = g + Utils::Index(0, y, w);
+                for (int x = 0; x < w; ++x) {
+                    colSum[x] += row[x] ? 1u : 0u;
+                }
+            }
+            uint8_t *out = density.data() + static_cast<std::size_t>(py) * dstW;
+            for (int px = 0; px < dstW; ++px) {
+                const Span &rx = cols[px];
+                uint64_t live = 0;
+                for (int x = rx.c0; x < rx.c1; ++x) {
+                    live += colSum[x];
+                }
+                const uint64_t area = static_cast<uint64_t>(rx.c1 - rx.c0) * (ry.c1 - ry.c0);
+                out[px] = static_cast<uint8_t>((live * 255 + area / 2) / area);
+            }
+        }
+        return;
+    }
+
+    const Level &lv = levels[k - BASE];
+    for (int py = 0; py < dstH; ++py) {
+        const Span &ry = rows[py];
+        uint8_t *out = density.data() + static_cast<std::size_t>(py) * dstW;
+        for (int px = 0; px < dstW; ++px) {
+            const Span &rx = cols[px];
+            uint64_t live = 0;
+            uint64_t area = 0;
+            for (int by = ry.b0; by <= ry.b1; ++by) {
+                const int bh = std::min(1 << k, h - (by << k));
+                for (int bx = rx.b0; bx <= rx.b1; ++bx) {
+                    const int bw = std::min(1 << k, w - (bx << k));
+                    live += lv.counts[Utils::Index(bx, by, lv.w)];
+                    area += static_cast<uint64_t>(bw) * bh;
+                }
+            }
+            out[px] = static_cast<uint8_t>((live * 255 + area / 2) / area);
+        }
+    }
+}
@@ -5,60 +5,39 @@
 
 Renderer::Renderer() = default;
 
+namespace
+{
+// COLORREF is 0x00BBGGRR; DIB pixels are 0xAARRGGBB.
+uint32_t ToArgb(COLORREF c)
+{
+    return 0xFF000000u | (uint32_t(GetRValue(c)) << 16) | (uint32_t(GetGValue(c)) << 8) | uint32_t(GetBValue(c));
+}
+}  // namespace
+
 void Renderer::Paint(HDC hdc, const RECT &drawRc, const Automaton &a, COLORREF c0, COLORREF c1, bool showGrid) const
 {
-    const int srcW = a.Width();
-    const int srcH = a.Height();
-    if (srcW <= 0 || srcH <= 0) {
+    const int dstW = drawRc.right - drawRc.left;
+    const int dstH = drawRc.bottom - drawRc.top;
+    if (a.Width() <= 0 || a.Height() <= 0 || dstW <= 0 || dstH <= 0) {
         return;
     }
 
-    std::vector<uint32_t> pix(static_cast<size_t>(srcW) * srcH);
-
-    const uint8_t r0 = GetRValue(c0), g0 = GetGValue(c0), b0 = GetBValue(c0);
-    const uint8_t r1 = GetRValue(c1), g1 = GetGValue(c1), b1 = GetBValue(c1);
-
-    Utils::ForAllCells(a, [&](int x, int y, uint8_t s) {
-        const uint8_t r = s ? r1 : r0;
-        const uint8_t g = s ? g1 : g0;
-        const uint8_t b = s ? b1 : b0;
-        pix[static_cast<size_t>(y) * srcW + x] =
-            (uint32_t(b)) | (uint32_t(g) << 8) | (uint32_t(r) << 16) | 0xFF000000u;
-    });
+    FrameStyle style;
+    style.color0 = ToArgb(c0);
+    style.color1 = ToArgb(c1);
+    style.gridColor = ToArgb(Cfg::Render::GRID_LINE_COLOR);
+    style.showGrid = showGrid;
+    compositor.Compose(a, dstW, dstH, style, frame);
 
     BITMAPINFO bmi{};
     bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = srcW;
-    bmi.bmiHeader.biHeight = -srcH;
+    bmi.bmiHeader.biWidth = dstW;
+    bmi.bmiHeader.biHeight = -dstH;
     bmi.bmiHeader.biPlanes = 1;
     bmi.bmiHeader.biBitCount = 32;
     bmi.bmiHeader.biCompression = BI_RGB;
 
-    const int dstW = drawRc.right - drawRc.left;
-    const int dstH = drawRc.bottom - drawRc.top;
-
-    SetStretchBltMode(hdc, COLORONCOLOR);
-    StretchDIBits(hdc,
-                  drawRc.left, drawRc.top, dstW, dstH,
-                  0, 0, srcW, srcH,
-                  pix.data(), &bmi, DIB_RGB_COLORS, SRCCOPY);
-
-    if (showGrid) {
-        HPEN pen = CreatePen(PS_SOLID, 1, Cfg::Render::GRID_LINE_COLOR);
-        HGDIOBJ old = SelectObject(hdc, pen);
-        for (int x = 1; x < srcW; ++x) {
-            int sx = drawRc.left + static_cast<int>(static_cast<long long>(x) * dstW / srcW);
-            MoveToEx(hdc, sx, drawRc.top, nullptr);
-            LineTo(hdc, sx, drawRc.bottom);
-        }
-        for (int y = 1; y < srcH; ++y) {
-            int sy = drawRc.top + static_cast<int>(static_cast<long long>(y) * dstH / srcH);
-            MoveToEx(hdc, drawRc.left, sy, nullptr);
-            LineTo(hdc, drawRc.right, sy);
-        }
-        SelectObject(hdc, old);
-        DeleteObject(pen);
-    }
+    SetDIBitsToDevice(hdc, drawRc.left, drawRc.top, dstW, dstH, 0, 0, 0, dstH, frame.data(), &bmi, DIB_RGB_COLORS);
 }
 
 bool Renderer::SaveGridBmp(const Automaton &a, const wchar_t *path, int scale, COLORREF c0, COLORREF c1) const
@@ -0,0 +1,365 @@
+#include "rulecircuit.h"
+#include "config.h"
+
+#include <algorithm>
+#include <bitset>
+
+namespace
+{
+
+// Truth tables are indexed by curr << 3 | count, i.e. variable bits (b0, b1, b2, curr).
+constexpr int VARS = 4;
+constexpr int ROWS = 1 << VARS;
+constexpr uint8_t VAR_REG[VARS] = {RuleCircuit::REG_B0, RuleCircuit::REG_B1, RuleCircuit::REG_B2,
+                                   RuleCircuit::REG_CURR};
+
+struct Implicant {
+    uint8_t value{0};
+    uint8_t free{0};  // variables the implicant does not depend on
+
+    bool operator==(const Implicant &o) const
+    {
+        return value == o.value && free == o.free;
+    }
+};
+
+uint16_t Covers(const Implicant &imp)
+{
+    uint16_t m = 0;
+    for (int r = 0; r < ROWS; ++r) {
+        if ((r & ~imp.free) == imp.value) {
+            m |= static_cast<uint16_t>(1u << r);
+        }
+    }
+    return m;
+}
+
+std::vector<Implicant> PrimeImplicants(uint16_t on, uint16_t dc)
+{
+    std::vector<Implicant> cur;
+    for (int r = 0; r < ROWS; ++r) {
+        if (((on | dc) >> r) & 1u) {
+            cur.push_back(Implicant{static_cast<uint8_t>(r), 0});
+        }
+    }
+
+    std::vector<Implicant> primes;
+    while (!cur.empty()) {
+        std::vector<bool> merged(cur.size(), false);
+        std::vector<Implicant> next;
+        for (std::size_t i = 0; i < cur.size(); ++i) {
+            for (std::size_t j = i + 1; j < cur.size(); ++j) {
+                const uint8_t diff = cur[i].value ^ cur[j].value;
+                if (cur[i].free != cur[j].free || std::bitset<8>(diff).count() != 1) {
+                    continue;
+                }
+                merged[i] = merged[j] = true;
+                const Implicant c{static_cast<uint8_t>(cur[i].value & ~diff), static_cast<uint8_t>(cur[i].free | diff)};
+                if (std::find(next.begin(), next.end(), c) == next.end()) {
+                    next.push_back(c);
+                }
+            }
+        }
+        for (std::size_t i = 0; i < cur.size(); ++i) {
+            if (!merged[i]) {
+                primes.push_back(cur[i]);
+            }
+        }
+        cur.swap(next);
+    }
+
+    // Primes made only of don't-cares never help a cover.
+    primes.erase(std::remove_if(primes.begin(), primes.end(),
+                                [on](const Implicant &p) {
+                                    return (Covers(p) & on) == 0;
+                                }),
+                 primes.end());
+    return primes;
+}
+
+class Builder
+{
+public:
+    uint8_t Emit(RuleCircuit::Op op, uint8_t a = 0, uint8_t b = 0)
+    {
+        const uint8_t dst = static_cast<uint8_t>(RuleCircuit::INPUTS + code.size());
+        code.push_back(RuleCircuit::Instr{op, dst, a, b});
+        return dst;
+    }
+
+    uint8_t Term(const Implicant &imp)
+    {
+        int pos = -1;
+        std::vector<uint8_t> neg;
+        for (int v = 0; v < VARS; ++v) {
+            if ((imp.free >> v) & 1u) {
+                continue;
+            }
+            if ((imp.value >> v) & 1u) {
+                pos = pos < 0 ? VAR_REG[v] : Emit(RuleCircuit::Op::AND, static_cast<uint8_t>(pos), VAR_REG[v]);
+            } else {
+                neg.push_back(VAR_REG[v]);
+            }
+        }
+        if (pos >= 0) {
+            for (uint8_t n : neg) {
+                pos = Emit(RuleCircuit::Op::ANDNOT, static_cast<uint8_t>(pos), n);
+            }
+            return static_cast<uint8_t>(pos);
+        }
+        if (neg.empty()) {
+            return Emit(RuleCircuit::Op::ONE);
+        }
+        // ~a & ~b & ... = ~(a | b | ...)
+        uint8_t any = neg[0];
+        for (std::size_t k = 1; k < neg.size(); ++k) {
+            any = Emit(RuleCircuit::Op::OR, any, neg[k]);
+        }
+        return Emit(RuleCircuit::Op::NOT, any);
+    }
+
+    uint8_t Sum(const std::vector<Implicant> &terms, bool invert)
+    {
+        uint8_t r = 0;
+        if (terms.empty()) {
+            r = Emit(RuleCircuit::Op::ZERO);
+        } else {
+            r = Term(terms[0]);
+            for (std::size_t k = 1; k < terms.size(); ++k) {
+                r = Emit(RuleCircuit::Op::OR, r, Term(terms[k]));
+            }
+        }
+        if (!invert) {
+            return r;
+        }
+        if (!code.empty() && code.back().dst == r && code.back().op == RuleCircuit::Op::NOT) {
+            const uint8_t inner = code.back().a;
+            code.pop_back();
+            return inner;
+        }
+        return Emit(RuleCircuit::Op::NOT, r);
+    }
+
+    std::vector<RuleCircuit::Instr> code;
+};
+
+int CostOf(const std::vector<Implicant> &terms, bool invert)
+{
+    Builder b;
+    b.Sum(terms, invert);
+    return static_cast<int>(b.code.size());
+}
+
+// Cheapest set of primes covering `on`: essential primes first, then an exhaustive search over
+// the rest when there are few of them, greedy otherwise.
+std::vector<Implicant> MinimumCover(uint16_t on, uint16_t dc, bool invert)
+{
+    const std::vector<Implicant> primes = PrimeImplicants(on, dc);
+
+    std::vector<Implicant> chosen;
+    uint16_t covered = 0;
+    for (int r = 0; r < ROWS; ++r) {
+        if (!((on >> r) & 1u)) {
+            continue;
+        }
+        int count = 0;
+        const Implicant *only = nullptr;
+        for (const Implicant &p : primes) {
+            if ((Covers(p) >> r) & 1u) {
+                ++count;
+                only = &p;
+            }
+        }
+        if (count == 1 && std::find(chosen.begin(), chosen.end(), *only) == chosen.end()) {
+            chosen.push_back(*only);
+            covered |= Covers(*only);
+        }
+    }
+
+    std::vector<Implicant> rest;
+    for (const Implicant &p : primes) {
+        if (std::find(chosen.begin(), chosen.end(), p) == chosen.end() && (Covers(p) & on & ~covered)) {
+            rest.push_back(p);
+        }
+    }
+    if ((covered & on) == on || rest.empty()) {
+        return chosen;
+    }
+
+    if (static_cast<int>(rest.size()) <= Cfg::Circuit::MAX_EXACT_PRIMES) {
+        std::vector<Implicant> best;
+        int bestCost = -1;
+        for (uint32_t set = 1; set < (1u << rest.size()); ++set) {
+            uint16_t c = covered;
+            for (std::size_t k = 0; k < rest.size(); ++k) {
+                if ((set >> k) & 1u) {
+                    c |= Covers(rest[k]);
+                }
+            }
+            if ((c & on) != on) {
+                continue;
+            }
+            std::vector<Implicant> terms = chosen;
+            for (std::size_t k = 0; k < rest.size(); ++k) {
+                if ((set >> k) & 1u) {
+                    terms.push_back(rest[k]);
+                }
+            }
+            const int cost = CostOf(terms, invert);
+            if (bestCost < 0 || cost < bestCost) {
+                bestCost = cost;
+                best.swap(terms);
+            }
+        }
+        return best;
+    }
+
+    while ((covered & on) != on) {
+        std::size_t pick = 0;
+        std::size_t gain = 0;
+        for (std::size_t k = 0; k < rest.size(); ++k) {
+            const std::size_t g = std::bitset<ROWS>(Covers(rest[k]) & on & ~covered).count();
+            if (g > gain) {
+                gain = g;
+                pick = k;
+            }
+        }
+        chosen.push_back(rest[pick]);
+        covered |= Covers(rest[pick]);
+    }
+    return chosen;
+}
+
+}  // namespace
+
+bool RuleCircuit::Compile(uint16_t ruleBits)
+{
+    uint16_t on = 0;
+    uint16_t dc = 0;
+    for (int curr = 0; curr < 2; ++curr) {
+        for (int count = 0; count < 8; ++count) {
+            const int r = curr << 3 | count;
+            if (count > Cfg::Automaton::NEIGHBORS_VON_NEUMANN) {
+                dc |= static_cast<uint16_t>(1u << r);
+                continue;
+            }
+            const int idxRow = curr * Cfg::Automaton::RULE_ROWS_PER_CURR + count;
+            if ((ruleBits >> (Cfg::Automaton::RULE_TOP_BIT_POS - idxRow)) & 1u) {
+                on |= static_cast<uint16_t>(1u << r);
+            }
+        }
+    }
+    const uint16_t off = static_cast<uint16_t>(~(on | dc));
+
+    Builder direct;
+    const uint8_t rDirect = direct.Sum(MinimumCover(on, dc, false), false);
+    Builder inverse;
+    const uint8_t rInverse = inverse.Sum(MinimumCover(off, dc, true), true);
+
+    const bool useInverse = inverse.code.size() < direct.code.size();
+    code = useInverse ? inverse.code : direct.code;
+    result = useInverse ? rInverse : rDirect;
+    valid = static_cast<int>(code.size()) <= Cfg::Circuit::MAX_OPS;
+    return valid;
+}
+
+void RuleCircuit::Run(const uint64_t *curr,
+                      const uint64_t *b0,
+                      const uint64_t *b1,
+                      const uint64_t *b2,
+                      uint64_t *out,
+                      std::size_t n,
+                      std::vector<uint64_t> &scratch) const
+{
+    if (result < INPUTS) {
+        const uint64_t *src[INPUTS] = {curr, b0, b1, b2};
+        std::copy(src[result], src[result] + n, out);
+        return;
+    }
+
+    scratch.resize(code.size() * n);
+    std::vector<uint64_t *> reg(INPUTS + code.size());
+    reg[REG_CURR] = const_cast<uint64_t *>(curr);
+    reg[REG_B0] = const_cast<uint64_t *>(b0);
+    reg[REG_B1] = const_cast<uint64_t *>(b1);
+    reg[REG_B2] = const_cast<uint64_t *>(b2);
+    for (std::size_t k = 0; k < code.size(); ++k) {
+        reg[INPUTS + k] = scratch.data() + k * n;
+    }
+    reg[result] = out;
+
+    // One instruction at a time over the whole span keeps each inner loop branch-free.
+    for (const Instr &ins : code) {
+        uint64_t *d = reg[ins.dst];
+        const uint64_t *a = reg[ins.a];
+        const uint64_t *b = reg[ins.b];
+        switch (ins.op) {
+            case Op::AND:
+                for (std::size_t j = 0; j < n; ++j) {
+                    d[j] = a[j] & b[j];
+                }
+                break;
+            case Op::OR:
+                for (std::size_t j = 0; j < n; ++j) {
+                    d[j] = a[j] | b[j];
+                }
+                break;
+            case Op::ANDNOT:
+                for (std::size_t j = 0; j < n; ++j) {
+                    d[j] = a[j] & ~b[j];
+                }
+                break;
+            case Op::NOT:
+                for (std::size_t j = 0; j < n; ++j) {
+                    d[j] = ~a[j];
+                }
+                break;
+            case Op::ZERO:
+                std::fill(d, d + n, 0ull);
+                break;
+            case Op::ONE:
+                std::fill(d, d + n, ~0ull);
+                break;
+        }
+    }
+}
+
+std::string RuleCircuit::ToString() const
+{
+    static const char *names[INPUTS] = {"curr", "b0", "b1", "b2"};
+
+    // Precedence: 0 = or, 1 = and, 2 = unary/atom.
+    auto render = [this](auto &self, int r, int prec) -> std::string {
+        if (r < INPUTS) {
+            return names[r];
+        }
+        const Instr &ins = code[r - INPUTS];
+        std::string s;
+        int own = 2;
+        switch (ins.op) {
+            case Op::AND:
+                own = 1;
+                s = self(self, ins.a, 1) + " & " + self(self, ins.b, 1);
+                break;
+            case Op::ANDNOT:
+                own = 1;
+                s = self(self, ins.a, 1) + " & ~" + self(self, ins.b, 2);
+                break;
+            case Op::OR:
+                own = 0;
+                s = self(self, ins.a, 0) + " | " + self(self, ins.b, 0);
+                break;
+            case Op::NOT:
+                s = "~" + self(self, ins.a, 2);
+                break;
+            case Op::ZERO:
+                s = "0";
+                break;
+            case Op::ONE:
+                s = "1";
+                break;
+        }
+        return own < prec ? "(" + s + ")" : s;
+    };
+    return valid ? render(render, result, 0) : std::string();
+}
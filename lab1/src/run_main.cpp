@@ -0,0 +1,278 @@
+#include "automaton.h"
+#include "clusters.h"
+#include "config.h"
+#include "shmring.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void OnSignal(int)
+{
+    stopRequested = 1;
+}
+
+struct RunOptions {
+    int w{Cfg::Automaton::DEFAULT_W};
+    int h{Cfg::Automaton::DEFAULT_H};
+    uint16_t ruleBits{Cfg::Automaton::DEFAULT_RULE};
+    bool wrap{true};
+    UpdateMode mode{UpdateMode::SYNCHRONOUS};
+    double density{0.5};
+    bool haveSeed{false};
+    uint64_t seed{0};
+    long long generations{Cfg::Run::DEFAULT_GENERATIONS};
+    int threads{0};
+    std::string checkpointPath;
+    int checkpointSeconds{Cfg::Run::CHECKPOINT_SECONDS};
+    int clusters{0};  // 0 = no cluster report, else 4 or 8
+    std::string publishName;
+    int publishEvery{1};
+    int publishSlots{Cfg::Publish::DEFAULT_SLOTS};
+};
+
+void PrintUsage()
+{
+    std::printf("Usage:\n");
+    std::printf("  crystali_run [options]\n");
+    std::printf("    --size W H          grid size (default %dx%d)\n", Cfg::Automaton::DEFAULT_W,
+                Cfg::Automaton::DEFAULT_H);
+    std::printf("    --rule N            rule number 0..1023 (default %u)\n", Cfg::Automaton::DEFAULT_RULE);
+    std::printf("    --no-wrap           bounded grid instead of a torus\n");
+    std::printf("    --mode M            sync | random | checkerboard (default sync)\n");
+    std::printf("    --density P         initial live-cell probability (default 0.5)\n");
+    std::printf("    --seed S            random seed (default: time)\n");
+    std::printf("    --gens N            run until iteration N (default %d)\n", Cfg::Run::DEFAULT_GENERATIONS);
+    std::printf("    --threads T         threads for the parallel update modes (default: all cores)\n");
+    std::printf("    --checkpoint FILE   resume from FILE if it exists and save to it periodically\n");
+    std::printf("    --interval S        seconds between checkpoints (default %d)\n", Cfg::Run::CHECKPOINT_SECONDS);
+    std::printf("    --clusters 4|8      report connected clusters of live cells at the end\n");
+    std::printf("    --publish NAME      publish generations to the shared-memory ring NAME\n");
+    std::printf("    --every K           publish every K-th generation (default 1)\n");
+    std::printf("    --slots N           frames kept in the ring (default %d)\n", Cfg::Publish::DEFAULT_SLOTS);
+}
+
+bool ParseInt(const char *s, long long &out)
+{
+    char *end = nullptr;
+    const long long v = std::strtoll(s, &end, 10);
+    if (!end || *end != '\0') {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+bool ParseDouble(const char *s, double &out)
+{
+    char *end = nullptr;
+    const double v = std::strtod(s, &end);
+    if (!end || *end != '\0') {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+bool ParseMode(const std::string &s, UpdateMode &out)
+{
+    if (s == "sync") {
+        out = UpdateMode::SYNCHRONOUS;
+    } else if (s == "random") {
+        out = UpdateMode::RANDOM_SEQUENTIAL;
+    } else if (s == "checkerboard") {
+        out = UpdateMode::CHECKERBOARD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool FileExists(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    std::fclose(f);
+    return true;
+}
+
+// Cluster count and a size histogram in powers of two.
+void PrintClusters(const Automaton &a, int connectivity, int threads)
+{
+    ClusterLabeller labeller;
+    labeller.SetConnectivity(connectivity == 8 ? Connectivity::EIGHT : Connectivity::FOUR);
+    labeller.SetThreads(threads);
+    const auto t0 = std::chrono::steady_clock::now();
+    const int n = labeller.Label(a);
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::vector<int> hist;
+    int largest = 0;
+    for (const Cluster &c : labeller.Clusters()) {
+        std::size_t k = 0;
+        while ((2 << k) <= c.size) {
+            ++k;
+        }
+        if (hist.size() <= k) {
+            hist.resize(k + 1, 0);
+        }
+        ++hist[k];
+        largest = std::max(largest, c.size);
+    }
+    std::printf("%d clusters (%d-connected, %.3f s), largest %d\n", n, connectivity, sec, largest);
+    for (std::size_t k = 0; k < hist.size(); ++k) {
+        if (hist[k]) {
+            std::printf("  size %d..%d: %d\n", 1 << k, (2 << k) - 1, hist[k]);
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    RunOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const int left = argc - i - 1;
+        long long v = 0, v2 = 0;
+        bool ok = true;
+        if (a == "--size" && left >= 2) {
+            ok = ParseInt(argv[i + 1], v) && ParseInt(argv[i + 2], v2) && v > 0 && v2 > 0;
+            opt.w = static_cast<int>(v);
+            opt.h = static_cast<int>(v2);
+            i += 2;
+        } else if (a == "--rule" && left >= 1) {
+            ok = ParseInt(argv[++i], v) && v >= 0 && v < (1 << Cfg::Automaton::RULE_BITS_COUNT);
+            opt.ruleBits = static_cast<uint16_t>(v);
+        } else if (a == "--no-wrap") {
+            opt.wrap = false;
+        } else if (a == "--mode" && left >= 1) {
+            ok = ParseMode(argv[++i], opt.mode);
+        } else if (a == "--density" && left >= 1) {
+            ok = ParseDouble(argv[++i], opt.density) && opt.density >= 0.0 && opt.density <= 1.0;
+        } else if (a == "--seed" && left >= 1) {
+            ok = ParseInt(argv[++i], v);
+            opt.haveSeed = true;
+            opt.seed = static_cast<uint64_t>(v);
+        } else if (a == "--gens" && left >= 1) {
+            ok = ParseInt(argv[++i], opt.generations) && opt.generations >= 0;
+        } else if (a == "--threads" && left >= 1) {
+            ok = ParseInt(argv[++i], v);
+            opt.threads = static_cast<int>(v);
+        } else if (a == "--checkpoint" && left >= 1) {
+            opt.checkpointPath = argv[++i];
+        } else if (a == "--interval" && left >= 1) {
+            ok = ParseInt(argv[++i], v) && v > 0;
+            opt.checkpointSeconds = static_cast<int>(v);
+        } else if (a == "--clusters" && left >= 1) {
+            ok = ParseInt(argv[++i], v) && (v == 4 || v == 8);
+            opt.clusters = static_cast<int>(v);
+        } else if (a == "--publish" && left >= 1) {
+            opt.publishName = argv[++i];
+        } else if (a == "--every" && left >= 1) {
+            ok = ParseInt(argv[++i], v) && v > 0 && v <= std::numeric_limits<int>::max();
+            opt.publishEvery = static_cast<int>(v);
+        } else if (a == "--slots" && left >= 1) {
+            ok = ParseInt(argv[++i], v) && v >= 2 && v <= Cfg::Publish::MAX_SLOTS;
+            opt.publishSlots = static_cast<int>(v);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage();
+            std::fprintf(stderr, "Error: invalid argument %s\n", a.c_str());
+            return 1;
+        }
+    }
+
+    Automaton automaton;
+    std::string err;
+    const bool checkpointing = !opt.checkpointPath.empty();
+    if (checkpointing && FileExists(opt.checkpointPath)) {
+        const auto t0 = std::chrono::steady_clock::now();
+        if (!Snapshot::Load(automaton, opt.checkpointPath, err)) {
+            std::fprintf(stderr, "Error: %s\n", err.c_str());
+            return 2;
+        }
+        const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::printf("resumed %dx%d at iteration %u from %s (%.3f s)\n", automaton.Width(), automaton.Height(),
+                    automaton.Iteration(), opt.checkpointPath.c_str(), sec);
+    } else {
+        automaton.Resize(opt.w, opt.h);
+        automaton.SetRuleBits(opt.ruleBits);
+        automaton.SetWrap(opt.wrap);
+        automaton.SetMode(opt.mode);
+        if (opt.haveSeed) {
+            automaton.SetSeed(opt.seed);
+        }
+        automaton.Randomize(opt.density);
+        automaton.SetInitFromCurrent();
+    }
+    automaton.SetThreads(opt.threads);
+
+    ShmRingWriter ring;
+    const bool publishing = !opt.publishName.empty();
+    if (publishing) {
+        if (!ring.Create(opt.publishName, automaton.Width(), automaton.Height(), opt.publishSlots, err)) {
+            std::fprintf(stderr, "Error: %s\n", err.c_str());
+            return 2;
+        }
+        ring.Publish(automaton);
+        automaton.SetObserver([&ring](const PackedFrame &f) { ring.Publish(f); }, opt.publishEvery);
+    }
+
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    Clock::time_point lastCheckpoint = start;
+    Clock::time_point lastProgress = start;
+    const uint32_t startIter = automaton.Iteration();
+
+    while (static_cast<long long>(automaton.Iteration()) < opt.generations && !stopRequested) {
+        const long long left = opt.generations - static_cast<long long>(automaton.Iteration());
+        automaton.Step(static_cast<int>(std::min<long long>(left, Cfg::Run::BATCH_GENERATIONS)));
+
+        const Clock::time_point now = Clock::now();
+        if (now - lastProgress >= std::chrono::seconds(Cfg::Run::PROGRESS_SECONDS)) {
+            const double sec = std::chrono::duration<double>(now - start).count();
+            std::printf("iteration %u, population %zu, %.1f gens/s\n", automaton.Iteration(), automaton.Population(),
+                        (automaton.Iteration() - startIter) / sec);
+            std::fflush(stdout);
+            lastProgress = now;
+        }
+        if (checkpointing && now - lastCheckpoint >= std::chrono::seconds(opt.checkpointSeconds)) {
+            if (!Snapshot::Save(automaton, opt.checkpointPath, err)) {
+                std::fprintf(stderr, "Error: %s\n", err.c_str());
+                return 2;
+            }
+            lastCheckpoint = now;
+        }
+    }
+
+    if (checkpointing && !Snapshot::Save(automaton, opt.checkpointPath, err)) {
+        std::fprintf(stderr, "Error: %s\n", err.c_str());
+        return 2;
+    }
+    std::printf("%s at iteration %u, population %zu\n", stopRequested ? "interrupted" : "finished",
+                automaton.Iteration(), automaton.Population());
+    if (opt.clusters) {
+        PrintClusters(automaton, opt.clusters, opt.threads);
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "scheduler.h"
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+StepScheduler::StepScheduler() : clock(&StepScheduler::SteadySeconds)
+{
+}
+
+StepScheduler::StepScheduler(Clock clock) : clock(std::move(clock))
+{
+}
+
+double StepScheduler::SteadySeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StepScheduler::Reset()
+{
+    perGen = 0.0;
+    lastBatch = 0;
+    windowStart = -1.0;
+    windowGens = 0;
+    rate = 0.0;
+}
+
+int StepScheduler::Plan() const
+{
+    if (budget <= 0.0 || lastBatch == 0) {
+        return 1;
+    }
+    // A batch may at most grow by MAX_GROWTH per frame, so a stale estimate cannot blow a frame.
+    const double grown = static_cast<double>(lastBatch) * Cfg::Schedule::MAX_GROWTH;
+    double n = grown;
+    if (perGen > 0.0) {
+        n = std::min(grown, std::floor(budget / perGen));
+    }
+    return static_cast<int>(std::clamp(n, 1.0, static_cast<double>(Cfg::Schedule::MAX_GENERATIONS_PER_FRAME)));
+}
+
+int StepScheduler::RunFrame(const std::function<void(int)> &step)
+{
+    const int n = Plan();
+    const double t0 = clock();
+    if (windowStart < 0.0) {
+        windowStart = t0;
+    }
+    step(n);
+    const double t1 = clock();
+
+    // Frames too short for the clock to see leave the estimate alone, and batches keep growing.
+    const double sample = (t1 - t0) / n;
+    if (sample > 0.0) {
+        perGen = perGen > 0.0 ? perGen + Cfg::Schedule::SMOOTHING * (sample - perGen) : sample;
+    }
+    lastBatch = n;
+
+    windowGens += n;
+    if (t1 - windowStart >= Cfg::Schedule::RATE_WINDOW_SECONDS) {
+        rate = static_cast<double>(windowGens) / (t1 - windowStart);
+        windowStart = t1;
+        windowGens = 0;
+    }
+    return n;
+}
@@ -0,0 +1,142 @@
+#include "config.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+
+int failures = 0;
+
+void Check(bool ok, const char *what, int frame)
+{
+    if (!ok) {
+        std::fprintf(stderr, "FAILED: %s (frame %d)\n", what, frame);
+        ++failures;
+    }
+}
+
+// A clock that only moves when a step "runs": each generation costs `cost` seconds.
+struct FakeClock {
+    double now{100.0};
+    double cost{0.0};
+
+    StepScheduler Scheduler(double budget)
+    {
+        StepScheduler s([this] { return now; });
+        s.SetBudget(budget);
+        return s;
+    }
+    void Step(int n)
+    {
+        now += n * cost;
+    }
+};
+
+// Steady cost: every frame runs at least one generation and, once measured, stays within the budget.
+void SteadyCost()
+{
+    FakeClock clock;
+    clock.cost = 1e-6;
+    const double budget = 0.010;
+    StepScheduler s = clock.Scheduler(budget);
+    int last = 0;
+    for (int frame = 0; frame < 40; ++frame) {
+        const double t0 = clock.now;
+        const int n = s.RunFrame([&](int k) { clock.Step(k); });
+        Check(n >= 1, "steady: at least one generation", frame);
+        Check(clock.now - t0 <= budget * (1 + 1e-9), "steady: within budget", frame);
+        Check(last == 0 || n <= last * Cfg::Schedule::MAX_GROWTH, "steady: grows at most MAX_GROWTH", frame);
+        last = n;
+    }
+    Check(last * clock.cost >= budget * 0.999, "steady: fills the budget", 40);
+}
+
+// A generation dearer than the whole budget still runs, one per frame.
+void OverBudget()
+{
+    FakeClock clock;
+    clock.cost = 0.020;
+    StepScheduler s = clock.Scheduler(0.010);
+    for (int frame = 0; frame < 10; ++frame) {
+        Check(s.RunFrame([&](int k) { clock.Step(k); }) == 1, "over budget: one generation", frame);
+    }
+}
+
+// When generations get cheaper the batch grows, but never past the budget.
+void CostDrops()
+{
+    FakeClock clock;
+    clock.cost = 1e-4;
+    const double budget = 0.010;
+    StepScheduler s = clock.Scheduler(budget);
+    for (int frame = 0; frame < 20; ++frame) {
+        s.RunFrame([&](int k) { clock.Step(k); });
+    }
+    clock.cost = 1e-6;
+    for (int frame = 20; frame < 80; ++frame) {
+        const double t0 = clock.now;
+        const int n = s.RunFrame([&](int k) { clock.Step(k); });
+        Check(n >= 1, "cost drop: at least one generation", frame);
+        Check(clock.now - t0 <= budget * (1 + 1e-9), "cost drop: within budget", frame);
+    }
+}
+
+// No budget: exactly one generation per frame.
+void NoBudget()
+{
+    FakeClock clock;
+    clock.cost = 1e-6;
+    StepScheduler s = clock.Scheduler(0.0);
+    for (int frame = 0; frame < 10; ++frame) {
+        Check(s.RunFrame([&](int k) { clock.Step(k); }) == 1, "no budget: one generation", frame);
+    }
+}
+
+// Frames the clock cannot see double the batch up to the cap; Reset starts over.
+void InvisibleFrames()
+{
+    FakeClock clock;
+    StepScheduler s = clock.Scheduler(0.010);
+    int expected = 1;
+    for (int frame = 0; frame < 24; ++frame) {
+        Check(s.RunFrame([&](int k) { clock.Step(k); }) == expected, "invisible: doubles up to the cap", frame);
+        expected = std::min(expected * Cfg::Schedule::MAX_GROWTH, Cfg::Schedule::MAX_GENERATIONS_PER_FRAME);
+    }
+    s.Reset();
+    Check(s.Plan() == 1, "reset: one generation", 24);
+}
+
+// The rate counts generations over the window of fake time.
+void Rate()
+{
+    FakeClock clock;
+    clock.cost = 0.001;
+    StepScheduler s = clock.Scheduler(0.0);
+    int frame = 0;
+    while (clock.now - 100.0 < Cfg::Schedule::RATE_WINDOW_SECONDS) {
+        Check(s.GenerationsPerSecond() == 0.0, "rate: none before the window closes", frame++);
+        s.RunFrame([&](int k) { clock.Step(k); });
+    }
+    const double rate = s.GenerationsPerSecond();
+    Check(rate > 999.0 && rate < 1001.0, "rate: 1000 generations per second", frame);
+}
+
+}  // namespace
+
+int main()
+{
+    SteadyCost();
+    OverBudget();
+    CostDrops();
+    NoBudget();
+    InvisibleFrames();
+    Rate();
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("scheduler: all checks passed\n");
+    return 0;
+}
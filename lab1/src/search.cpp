@@ -0,0 +1,452 @@
+#include "search.h"
+#include "automaton.h"
+#include "config.h"
+#include "ensemble.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+
+struct Shape {
+    int w{0};
+    int h{0};
+    std::vector<uint8_t> cells;
+};
+
+Shape Crop(const std::vector<uint8_t> &cells, int w, const BoundingBox &bb)
+{
+    Shape s;
+    if (bb.Empty()) {
+        return s;
+    }
+    s.w = bb.maxX - bb.minX + 1;
+    s.h = bb.maxY - bb.minY + 1;
+    s.cells.resize(static_cast<std::size_t>(s.w) * s.h);
+    for (int y = 0; y < s.h; ++y) {
+        for (int x = 0; x < s.w; ++x) {
+            s.cells[Utils::Index(x, y, s.w)] = cells[Utils::Index(bb.minX + x, bb.minY + y, w)];
+        }
+    }
+    return s;
+}
+
+// The eight symmetries of the square; t & 4 transposes, t & 1 mirrors x, t & 2 mirrors y.
+Shape Transform(const Shape &s, int t)
+{
+    Shape o;
+    const bool transpose = (t & 4) != 0;
+    o.w = transpose ? s.h : s.w;
+    o.h = transpose ? s.w : s.h;
+    o.cells.resize(s.cells.size());
+    for (int y = 0; y < s.h; ++y) {
+        for (int x = 0; x < s.w; ++x) {
+            int tx = transpose ? y : x;
+            int ty = transpose ? x : y;
+            if (t & 1) {
+                tx = o.w - 1 - tx;
+            }
+            if (t & 2) {
+                ty = o.h - 1 - ty;
+            }
+            o.cells[Utils::Index(tx, ty, o.w)] = s.cells[Utils::Index(x, y, s.w)];
+        }
+    }
+    return o;
+}
+
+std::string KeyOf(const Shape &s)
+{
+    std::string k = std::to_string(s.w) + "x" + std::to_string(s.h) + ":";
+    for (uint8_t c : s.cells) {
+        k += c ? '1' : '0';
+    }
+    return k;
+}
+
+bool KeyLess(const std::string &a, const std::string &b)
+{
+    return a.size() != b.size() ? a.size() < b.size() : a < b;
+}
+
+}  // namespace
+
+PatternSearch::PatternSearch(const SearchOptions &o) : opt(o)
+{
+    margin = opt.maxPeriod + 1;
+    const int cells = opt.boxW * opt.boxH;
+    if (cells > 0 && cells <= Cfg::Search::MAX_BOX_CELLS) {
+        total = 1ull << cells;
+        numChunks = (total + Cfg::Search::CHUNK_SIZE - 1) / Cfg::Search::CHUNK_SIZE;
+    }
+
+    // Box-preserving symmetries other than the identity, as cell permutations.
+    const int W = opt.boxW, H = opt.boxH;
+    for (int t = 1; t < 8; ++t) {
+        if ((t & 4) && W != H) {
+            continue;
+        }
+        std::vector<int> perm(static_cast<std::size_t>(std::max(0, cells)));
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                int tx = (t & 4) ? y : x;
+                int ty = (t & 4) ? x : y;
+                if (t & 1) {
+                    tx = W - 1 - tx;
+                }
+                if (t & 2) {
+                    ty = H - 1 - ty;
+                }
+                perm[Utils::Index(x, y, W)] = Utils::Index(tx, ty, W);
+            }
+        }
+        symmetries.push_back(std::move(perm));
+    }
+}
+
+bool PatternSearch::Validate(std::string &err) const
+{
+    if (opt.boxW < 1 || opt.boxH < 1 || opt.boxW * opt.boxH > Cfg::Search::MAX_BOX_CELLS) {
+        err = "box must have 1.." + std::to_string(Cfg::Search::MAX_BOX_CELLS) + " cells";
+        return false;
+    }
+    if (opt.maxPeriod < 1) {
+        err = "period must be at least 1";
+        return false;
+    }
+    if ((opt.ruleBits >> Cfg::Automaton::RULE_TOP_BIT_POS) & 1u) {
+        err = "rule turns empty cells on, so no finite pattern can be periodic";
+        return false;
+    }
+    return true;
+}
+
+bool PatternSearch::Accept(uint64_t idx) const
+{
+    const int W = opt.boxW, H = opt.boxH;
+    uint64_t row0 = (1ull << W) - 1;
+    uint64_t col0 = 0;
+    for (int y = 0; y < H; ++y) {
+        col0 |= 1ull << (y * W);
+    }
+
+    // Translation: only patterns touching the top row and left column.
+    if (!(idx & row0) || !(idx & col0)) {
+        return false;
+    }
+
+    // Symmetry: only the smallest index among the images of the pattern within the box.
+    for (const std::vector<int> &perm : symmetries) {
+        uint64_t img = 0;
+        for (uint64_t bits = idx; bits; bits &= bits - 1) {
+            img |= 1ull << perm[__builtin_ctzll(bits)];
+        }
+        while (!(img & row0)) {
+            img >>= W;
+        }
+        while (!(img & col0)) {
+            img >>= 1;
+        }
+        if (img < idx) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PatternSearch::Evaluate(Ensemble &e, const std::vector<uint64_t> &cands)
+{
+    const int B = e.Lanes() / Cfg::Ensemble::WORD_BITS;
+    const int n = static_cast<int>(cands.size());
+
+    e.Clear();
+    for (int k = 0; k < n; ++k) {
+        for (uint64_t bits = cands[k]; bits; bits &= bits - 1) {
+            const int i = __builtin_ctzll(bits);
+            e.Set(k, margin + i % opt.boxW, margin + i / opt.boxW, 1);
+        }
+    }
+    const std::vector<uint64_t> initial = e.Words();
+
+    std::vector<uint64_t> pending(B, 0);
+    for (int k = 0; k < n; ++k) {
+        pending[k / Cfg::Ensemble::WORD_BITS] |= 1ull << (k % Cfg::Ensemble::WORD_BITS);
+    }
+
+    std::vector<uint64_t> diff(B);
+    for (int g = 1; g <= opt.maxPeriod; ++g) {
+        e.Step();
+        const std::vector<uint64_t> &words = e.Words();
+        std::fill(diff.begin(), diff.end(), 0);
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            diff[i % B] |= words[i] ^ initial[i];
+        }
+
+        bool any = false;
+        for (int b = 0; b < B; ++b) {
+            const uint64_t match = pending[b] & ~diff[b];
+            for (uint64_t bits = match; bits; bits &= bits - 1) {
+                AddResult(cands[b * Cfg::Ensemble::WORD_BITS + __builtin_ctzll(bits)], g);
+            }
+            pending[b] &= ~match;
+            any = any || pending[b];
+        }
+        if (!any) {
+            break;
+        }
+    }
+}
+
+void PatternSearch::AddResult(uint64_t idx, int period)
+{
+    // Key the result by the smallest canonical form over all phases and symmetries, so every
+    // phase and orientation of an oscillator found in the box collapses to one entry.
+    const int side = std::max(opt.boxW, opt.boxH) + 2 * margin;
+    Automaton a;
+    a.Resize(side, side);
+    a.SetWrap(false);
+    a.SetRuleBits(opt.ruleBits);
+    for (uint64_t bits = idx; bits; bits &= bits - 1) {
+        const int i = __builtin_ctzll(bits);
+        a.Set(margin + i % opt.boxW, margin + i / opt.boxW, 1);
+    }
+
+    std::string best;
+    Shape bestShape;
+    for (int phase = 0; phase < period; ++phase) {
+        const Shape s = Crop(a.Data(), side, a.Bounds());
+        for (int t = 0; t < 8; ++t) {
+            Shape img = Transform(s, t);
+            std::string k = KeyOf(img);
+            if (best.empty() || KeyLess(k, best)) {
+                best = std::move(k);
+                bestShape = std::move(img);
+            }
+        }
+        a.Step();
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (results.find(best) == results.end()) {
+        results[best] = SearchPattern{bestShape.w, bestShape.h, period, std::move(bestShape.cells)};
+    }
+}
+
+void PatternSearch::MarkDone(uint64_t chunk)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    doneAbove.insert(chunk);
+    while (!doneAbove.empty() && *doneAbove.begin() == watermark) {
+        doneAbove.erase(doneAbove.begin());
+        ++watermark;
+    }
+}
+
+void PatternSearch::Worker()
+{
+    Ensemble e;
+    e.Resize(opt.boxW + 2 * margin, opt.boxH + 2 * margin, Cfg::Search::LANES);
+    e.SetWrap(false);
+    e.SetRuleBits(opt.ruleBits);
+
+    std::vector<uint64_t> cands;
+    cands.reserve(static_cast<std::size_t>(e.Lanes()));
+
+    for (;;) {
+        const uint64_t chunk = nextChunk.fetch_add(1);
+        if (chunk >= numChunks) {
+            break;
+        }
+        const uint64_t begin = chunk * Cfg::Search::CHUNK_SIZE;
+        const uint64_t end = std::min(total, begin + Cfg::Search::CHUNK_SIZE);
+        for (uint64_t idx = begin; idx < end; ++idx) {
+            if (!Accept(idx)) {
+                continue;
+            }
+            cands.push_back(idx);
+            if (static_cast<int>(cands.size()) == e.Lanes()) {
+                Evaluate(e, cands);
+                cands.clear();
+            }
+        }
+        if (!cands.empty()) {
+            Evaluate(e, cands);
+            cands.clear();
+        }
+        MarkDone(chunk);
+    }
+}
+
+SearchProgress PatternSearch::Progress() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    SearchProgress p;
+    p.total = total;
+    p.done = std::min(total, (watermark + doneAbove.size()) * Cfg::Search::CHUNK_SIZE);
+    p.found = results.size();
+    return p;
+}
+
+std::vector<SearchPattern> PatternSearch::Results() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<SearchPattern> out;
+    out.reserve(results.size());
+    for (const auto &kv : results) {
+        out.push_back(kv.second);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const SearchPattern &a, const SearchPattern &b) { return a.period < b.period; });
+    return out;
+}
+
+bool PatternSearch::WriteCheckpoint(std::string &err) const
+{
+    if (opt.checkpointPath.empty()) {
+        return true;
+    }
+
+    std::ostringstream os;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        os << "crystali-search 1\n";
+        os << "rule " << opt.ruleBits << " box " << opt.boxW << " " << opt.boxH << " period " << opt.maxPeriod
+           << "\n";
+        os << "next " << std::min(total, watermark * Cfg::Search::CHUNK_SIZE) << "\n";
+        for (const auto &kv : results) {
+            const SearchPattern &p = kv.second;
+            os << "pattern " << p.period << " " << p.w << " " << p.h << " ";
+            for (uint8_t c : p.cells) {
+                os << (c ? '1' : '0');
+            }
+            os << "\n";
+        }
+    }
+
+    // Write next to the target and rename over it, so a crash never leaves a torn checkpoint.
+    const std::string tmp = opt.checkpointPath + ".tmp";
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        ofs << os.str();
+        if (!ofs.good()) {
+            err = "failed to write " + tmp;
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(opt.checkpointPath.c_str());
+#endif
+    if (std::rename(tmp.c_str(), opt.checkpointPath.c_str()) != 0) {
+        err = "failed to rename " + tmp;
+        return false;
+    }
+    return true;
+}
+
+bool PatternSearch::Resume(std::string &err)
+{
+    if (opt.checkpointPath.empty()) {
+        return true;
+    }
+    std::ifstream ifs(opt.checkpointPath);
+    if (!ifs) {
+        return true;
+    }
+
+    std::string magic;
+    int version = 0;
+    std::string kRule, kBox, kPeriod, kNext;
+    unsigned rule = 0;
+    int bw = 0, bh = 0, period = 0;
+    uint64_t nextIdx = 0;
+    ifs >> magic >> version >> kRule >> rule >> kBox >> bw >> bh >> kPeriod >> period >> kNext >> nextIdx;
+    if (!ifs || magic != "crystali-search" || version != 1) {
+        err = "unrecognised checkpoint " + opt.checkpointPath;
+        return false;
+    }
+    if (rule != opt.ruleBits || bw != opt.boxW || bh != opt.boxH || period != opt.maxPeriod) {
+        err = "checkpoint " + opt.checkpointPath + " belongs to a different search";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    std::string tag;
+    while (ifs >> tag) {
+        SearchPattern p;
+        std::string bits;
+        ifs >> p.period >> p.w >> p.h >> bits;
+        if (tag != "pattern" || !ifs || bits.size() != static_cast<std::size_t>(p.w) * p.h) {
+            err = "corrupt checkpoint " + opt.checkpointPath;
+            return false;
+        }
+        for (char c : bits) {
+            p.cells.push_back(c == '1' ? 1u : 0u);
+        }
+        results[KeyOf(Shape{p.w, p.h, p.cells})] = p;
+    }
+    watermark = std::min(numChunks, nextIdx / Cfg::Search::CHUNK_SIZE);
+    nextChunk = watermark;
+    return true;
+}
+
+bool PatternSearch::Run(std::string &err)
+{
+    if (!Validate(err)) {
+        return false;
+    }
+
+    int threads = opt.threads;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    std::mutex doneMtx;
+    std::condition_variable doneCv;
+    int finished = 0;
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&]() {
+            Worker();
+            std::lock_guard<std::mutex> lock(doneMtx);
+            ++finished;
+            doneCv.notify_all();
+        });
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    auto lastCheckpoint = start;
+    bool ok = true;
+    {
+        std::unique_lock<std::mutex> lock(doneMtx);
+        while (finished < threads) {
+            doneCv.wait_for(lock, std::chrono::seconds(Cfg::Search::PROGRESS_SECONDS));
+            if (finished == threads) {
+                break;
+            }
+            const SearchProgress p = Progress();
+            const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+            std::fprintf(stderr, "[search] %llu/%llu candidates, %zu found, %.0fs\n",
+                         static_cast<unsigned long long>(p.done), static_cast<unsigned long long>(p.total), p.found,
+                         secs);
+            if (Clock::now() - lastCheckpoint >= std::chrono::seconds(opt.checkpointSeconds)) {
+                lock.unlock();
+                ok = WriteCheckpoint(err) && ok;
+                lock.lock();
+                lastCheckpoint = Clock::now();
+            }
+        }
+    }
+    for (std::thread &t : pool) {
+        t.join();
+    }
+    return WriteCheckpoint(err) && ok;
+}
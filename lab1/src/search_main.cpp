@@ -0,0 +1,89 @@
+#include "config.h"
+#include "search.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+void PrintUsage()
+{
+    std::printf("Usage:\n");
+    std::printf("  crystali_search [options]\n");
+    std::printf("    --rule N            rule number 0..1023 (default %u)\n", Cfg::Automaton::DEFAULT_RULE);
+    std::printf("    --box W H           search box size (default %dx%d)\n", Cfg::Search::DEFAULT_BOX,
+                Cfg::Search::DEFAULT_BOX);
+    std::printf("    --period P          report periods 1..P (default %d)\n", Cfg::Search::DEFAULT_PERIOD);
+    std::printf("    --threads T         worker threads (default: all cores)\n");
+    std::printf("    --checkpoint FILE   resume from and periodically save to FILE\n");
+    std::printf("    --interval S        seconds between checkpoints (default %d)\n", Cfg::Search::CHECKPOINT_SECONDS);
+}
+
+bool ParseInt(const char *s, int &out)
+{
+    char *end = nullptr;
+    const long v = std::strtol(s, &end, 10);
+    if (!end || *end != '\0') {
+        return false;
+    }
+    out = static_cast<int>(v);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    SearchOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const int left = argc - i - 1;
+        int v = 0;
+        bool ok = true;
+        if (a == "--rule" && left >= 1) {
+            ok = ParseInt(argv[++i], v) && v >= 0 && v < (1 << Cfg::Automaton::RULE_BITS_COUNT);
+            opt.ruleBits = static_cast<uint16_t>(v);
+        } else if (a == "--box" && left >= 2) {
+            ok = ParseInt(argv[i + 1], opt.boxW) && ParseInt(argv[i + 2], opt.boxH);
+            i += 2;
+        } else if (a == "--period" && left >= 1) {
+            ok = ParseInt(argv[++i], opt.maxPeriod);
+        } else if (a == "--threads" && left >= 1) {
+            ok = ParseInt(argv[++i], opt.threads);
+        } else if (a == "--checkpoint" && left >= 1) {
+            opt.checkpointPath = argv[++i];
+        } else if (a == "--interval" && left >= 1) {
+            ok = ParseInt(argv[++i], opt.checkpointSeconds) && opt.checkpointSeconds > 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage();
+            std::fprintf(stderr, "Error: invalid argument %s\n", a.c_str());
+            return 1;
+        }
+    }
+
+    PatternSearch search(opt);
+    std::string err;
+    if (!search.Validate(err) || !search.Resume(err) || !search.Run(err)) {
+        std::fprintf(stderr, "Error: %s\n", err.c_str());
+        return 2;
+    }
+
+    const std::vector<SearchPattern> found = search.Results();
+    for (const SearchPattern &p : found) {
+        std::printf("period %d, %dx%d\n", p.period, p.w, p.h);
+        for (int y = 0; y < p.h; ++y) {
+            for (int x = 0; x < p.w; ++x) {
+                std::putchar(p.cells[static_cast<std::size_t>(y) * p.w + x] ? 'o' : '.');
+            }
+            std::putchar('\n');
+        }
+        std::putchar('\n');
+    }
+    std::printf("%zu patterns\n", found.size());
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include "shmring.h"
+#include "automaton.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+inline std::size_t RoundUp(std::size_t n, std::size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+inline std::size_t HeaderBytes()
+{
+    return RoundUp(sizeof(ShmRingHeader), Cfg::Publish::CACHE_LINE);
+}
+
+inline std::size_t SlotBytes(int h, uint32_t wordsPerRow)
+{
+    return RoundUp(sizeof(ShmSlotHeader) + static_cast<std::size_t>(h) * wordsPerRow * sizeof(uint64_t),
+                   Cfg::Publish::CACHE_LINE);
+}
+
+inline std::size_t SegmentBytes(const ShmRingHeader &hdr)
+{
+    return HeaderBytes() + static_cast<std::size_t>(hdr.slots) * hdr.slotBytes;
+}
+
+// POSIX names start with a slash; Windows ones must not contain any.
+std::string SegmentName(const std::string &name)
+{
+#ifdef _WIN32
+    return name[0] == '/' ? name.substr(1) : name;
+#else
+    return name[0] == '/' ? name : "/" + name;
+#endif
+}
+
+inline uint64_t LoadRelaxed(const uint64_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+inline void StoreRelaxed(uint64_t *p, uint64_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+
+// One grid row of 0/1 bytes into whole words; the multiply gathers byte k into bit 56 + k.
+void PackRow(const uint8_t *row, int w, uint64_t *out)
+{
+    const int words = (w + 63) / 64;
+    for (int k = 0; k < words; ++k) {
+        const int x0 = k * 64;
+        const int n = std::min(64, w - x0);
+        uint64_t word = 0;
+        int x = 0;
+        for (; x + 8 <= n; x += 8) {
+            uint64_t v = 0;
+            std::memcpy(&v, row + x0 + x, 8);
+            word |= ((v * 0x0102040810204080ull) >> 56) << x;
+        }
+        for (; x < n; ++x) {
+            word |= static_cast<uint64_t>(row[x0 + x] & 1u) << x;
+        }
+        StoreRelaxed(out + k, word);
+    }
+}
+
+}  // namespace
+
+ShmRingWriter::~ShmRingWriter()
+{
+    Close();
+}
+
+bool ShmRingWriter::Create(const std::string &segment, int w, int h, int slots, std::string &err)
+{
+    Close();
+    if (segment.empty() || w < 1 || h < 1 || slots < 2) {
+        err = "invalid shared-memory ring parameters";
+        return false;
+    }
+
+    ShmRingHeader layout{};
+    std::memcpy(layout.magic, Cfg::Publish::MAGIC, sizeof(layout.magic));
+    layout.version = Cfg::Publish::VERSION;
+    layout.slots = static_cast<uint32_t>(slots);
+    layout.width = w;
+    layout.height = h;
+    layout.wordsPerRow = static_cast<uint32_t>((w + 63) / 64);
+    layout.headerSize = sizeof(ShmRingHeader);
+    layout.slotBytes = SlotBytes(h, layout.wordsPerRow);
+    const std::size_t bytes = SegmentBytes(layout);
+    const std::string full = SegmentName(segment);
+
+#ifdef _WIN32
+    HANDLE m = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                  static_cast<DWORD>(static_cast<uint64_t>(bytes) >> 32),
+                                  static_cast<DWORD>(bytes & 0xFFFFFFFFu), full.c_str());
+    if (!m) {
+        err = "cannot create shared memory " + full;
+        return false;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(m);
+        err = "shared memory " + full + " is still in use";
+        return false;
+    }
+    void *p = MapViewOfFile(m, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!p) {
+        CloseHandle(m);
+        err = "cannot map shared memory " + full;
+        return false;
+    }
+    mapping = m;
+#else
+    // A stale segment is unlinked rather than reused, so its readers never see a torn layout.
+    shm_unlink(full.c_str());
+    const int fd = shm_open(full.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        err = "cannot create shared memory " + full;
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        close(fd);
+        shm_unlink(full.c_str());
+        err = "cannot size shared memory " + full;
+        return false;
+    }
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(full.c_str());
+        err = "cannot map shared memory " + full;
+        return false;
+    }
+#endif
+
+    name = full;
+    base = static_cast<uint8_t *>(p);
+    size = bytes;
+    hdr = reinterpret_cast<ShmRingHeader *>(base);
+    next = 0;
+    // The segment starts zeroed; the magic goes in last so readers never accept a half-written header.
+    ShmRingHeader init = layout;
+    std::memset(init.magic, 0, sizeof(init.magic));
+    std::memcpy(hdr, &init, sizeof(init));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    std::memcpy(hdr->magic, layout.magic, sizeof(layout.magic));
+    return true;
+}
+
+void ShmRingWriter::Close()
+{
+    if (!base) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(static_cast<HANDLE>(mapping));
+    mapping = nullptr;
+#else
+    munmap(base, size);
+    shm_unlink(name.c_str());
+#endif
+    base = nullptr;
+    hdr = nullptr;
+    size = 0;
+}
+
+ShmSlotHeader *ShmRingWriter::BeginSlot(uint64_t iteration, uint64_t population)
+{
+    const uint64_t f = next;
+    auto *slot = reinterpret_cast<ShmSlotHeader *>(base + HeaderBytes() + (f % hdr->slots) * hdr->slotBytes);
+    StoreRelaxed(&slot->seq, 2 * f + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    StoreRelaxed(&slot->iteration, iteration);
+    StoreRelaxed(&slot->population, population);
+    return slot;
+}
+
+void ShmRingWriter::EndSlot(ShmSlotHeader *slot)
+{
+    const uint64_t f = next++;
+    __atomic_store_n(&slot->seq, 2 * f + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->published, f + 1, __ATOMIC_RELEASE);
+}
+
+bool ShmRingWriter::Publish(const Automaton &a)
+{
+    if (!base || a.Width() != hdr->width || a.Height() != hdr->height) {
+        return false;
+    }
+    ShmSlotHeader *slot = BeginSlot(a.Iteration(), a.Population());
+    uint64_t *bits = reinterpret_cast<uint64_t *>(slot + 1);
+    const uint8_t *grid = a.Data().data();
+    const int w = hdr->width;
+    for (int y = 0; y < hdr->height; ++y) {
+        PackRow(grid + static_cast<std::size_t>(y) * w, w, bits + static_cast<std::size_t>(y) * hdr->wordsPerRow);
+    }
+    EndSlot(slot);
+    return true;
+}
+
+bool ShmRingWriter::Publish(const PackedFrame &frame)
+{
+    if (!base || frame.width != hdr->width || frame.height != hdr->height ||
+        frame.wordsPerRow != static_cast<int>(hdr->wordsPerRow)) {
+        return false;
+    }
+    ShmSlotHeader *slot = BeginSlot(frame.iteration, frame.population);
+    uint64_t *bits = reinterpret_cast<uint64_t *>(slot + 1);
+    const std::size_t words = static_cast<std::size_t>(hdr->height) * hdr->wordsPerRow;
+    for (std::size_t i = 0; i < words; ++i) {
+        StoreRelaxed(bits + i, frame.bits[i]);
+    }
+    EndSlot(slot);
+    return true;
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    Detach();
+}
+
+bool ShmRingReader::Attach(const std::string &segment, std::string &err)
+{
+    Detach();
+    if (segment.empty()) {
+        err = "empty shared memory name";
+        return false;
+    }
+    const std::string full = SegmentName(segment);
+
+#ifdef _WIN32
+    HANDLE m = OpenFileMappingA(FILE_MAP_READ, FALSE, full.c_str());
+    if (!m) {
+        err = "cannot open shared memory " + full;
+        return false;
+    }
+    void *p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info{};
+    if (!p || VirtualQuery(p, &info, sizeof(info)) == 0) {
+        if (p) {
+            UnmapViewOfFile(p);
+        }
+        CloseHandle(m);
+        err = "cannot map shared memory " + full;
+        return false;
+    }
+    mapping = m;
+    const std::size_t bytes = info.RegionSize;
+#else
+    const int fd = shm_open(full.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        err = "cannot open shared memory " + full;
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        err = "cannot stat shared memory " + full;
+        return false;
+    }
+    const std::size_t bytes = static_cast<std::size_t>(st.st_size);
+    void *p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        err = "cannot map shared memory " + full;
+        return false;
+    }
+#endif
+
+    base = static_cast<const uint8_t *>(p);
+    size = bytes;
+    hdr = reinterpret_cast<const ShmRingHeader *>(base);
+
+    bool ok = size >= sizeof(ShmRingHeader) &&
+              std::memcmp(hdr->magic, Cfg::Publish::MAGIC, sizeof(hdr->magic)) == 0;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    ok = ok && hdr->version == Cfg::Publish::VERSION && hdr->headerSize == sizeof(ShmRingHeader) &&
+         hdr->width > 0 && hdr->height > 0 && hdr->slots >= 2 &&
+         hdr->wordsPerRow == static_cast<uint32_t>((hdr->width + 63) / 64) &&
+         hdr->slotBytes == SlotBytes(hdr->height, hdr->wordsPerRow) && SegmentBytes(*hdr) <= size;
+    if (!ok) {
+        Detach();
+        err = full + " is not a generation ring";
+        return false;
+    }
+    // Start at the newest frame rather than replaying the ring.
+    const uint64_t published = __atomic_load_n(&hdr->published, __ATOMIC_ACQUIRE);
+    next = published ? published - 1 : 0;
+    skipped = 0;
+    return true;
+}
+
+void ShmRingReader::Detach()
+{
+    if (!base) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(static_cast<HANDLE>(mapping));
+    mapping = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(base), size);
+#endif
+    base = nullptr;
+    hdr = nullptr;
+    size = 0;
+}
+
+// Seqlock read of one frame: fails if the slot holds another frame or was rewritten meanwhile.
+bool ShmRingReader::TryRead(uint64_t frame, ShmFrame &out) const
+{
+    const auto *slot =
+        reinterpret_cast<const ShmSlotHeader *>(base + HeaderBytes() + (frame % hdr->slots) * hdr->slotBytes);
+    const uint64_t *bits = reinterpret_cast<const uint64_t *>(slot + 1);
+    const uint64_t want = 2 * frame + 2;
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != want) {
+        return false;
+    }
+
+    out.sequence = frame;
+    out.iteration = LoadRelaxed(&slot->iteration);
+    out.population = LoadRelaxed(&slot->population);
+    out.width = hdr->width;
+    out.height = hdr->height;
+    out.wordsPerRow = static_cast<int>(hdr->wordsPerRow);
+    const std::size_t words = static_cast<std::size_t>(hdr->height) * hdr->wordsPerRow;
+    out.bits.resize(words);
+    for (std::size_t i = 0; i < words; ++i) {
+        out.bits[i] = LoadRelaxed(bits + i);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return LoadRelaxed(&slot->seq) == want;
+}
+
+bool ShmRingReader::ReadFrom(uint64_t frame, ShmFrame &out)
+{
+    for (;;) {
+        const uint64_t published = __atomic_load_n(&hdr->published, __ATOMIC_ACQUIRE);
+        if (frame >= published) {
+            return false;
+        }
+        // Frames older than a full ring have been overwritten, or are about to be.
+        const uint64_t oldest = published > hdr->slots ? published - hdr->slots : 0;
+        frame = std::max(frame, oldest);
+        if (TryRead(frame, out)) {
+            skipped += frame - next;
+            next = frame + 1;
+            return true;
+        }
+        ++frame;
+    }
+}
+
+bool ShmRingReader::Next(ShmFrame &out)
+{
+    return base && ReadFrom(next, out);
+}
+
+bool ShmRingReader::Latest(ShmFrame &out)
+{
+    if (!base) {
+        return false;
+    }
+    for (;;) {
+        const uint64_t published = __atomic_load_n(&hdr->published, __ATOMIC_ACQUIRE);
+        if (published <= next) {
+            return false;
+        }
+        const uint64_t frame = published - 1;
+        if (TryRead(frame, out)) {
+            skipped += frame - next;
+            next = frame + 1;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,281 @@
+#include "snapshot.h"
+#include "automaton.h"
+#include "config.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int32_t w;
+    int32_t h;
+    uint16_t ruleBits;
+    uint8_t wrap;
+    uint8_t mode;
+    uint32_t iter;
+    uint64_t seed;
+    uint64_t rngState;
+    uint64_t accept[Cfg::Automaton::RULE_BITS_COUNT];
+    uint64_t words;     // per grid
+    uint64_t checksum;  // over both grids
+};
+
+constexpr uint64_t BYTE_ONES = 0x0101010101010101ull;
+
+uint64_t WordsFor(std::size_t cells)
+{
+    return (static_cast<uint64_t>(cells) + 63) / 64;
+}
+
+// Eight 0/1 bytes to eight bits: the multiply gathers byte k into bit 56 + k.
+void Pack(const std::vector<uint8_t> &cells, std::vector<uint64_t> &out)
+{
+    out.assign(WordsFor(cells.size()), 0);
+    const std::size_t full = cells.size() / 8;
+    for (std::size_t k = 0; k < full; ++k) {
+        uint64_t v = 0;
+        std::memcpy(&v, cells.data() + k * 8, 8);
+        v = (v | (v >> 1) | (v >> 2) | (v >> 3) | (v >> 4) | (v >> 5) | (v >> 6) | (v >> 7)) & BYTE_ONES;
+        out[k / 8] |= ((v * 0x0102040810204080ull) >> 56) << ((k % 8) * 8);
+    }
+    for (std::size_t i = full * 8; i < cells.size(); ++i) {
+        out[i / 64] |= static_cast<uint64_t>(cells[i] != 0) << (i % 64);
+    }
+}
+
+void Unpack(const uint64_t *bits, std::vector<uint8_t> &cells)
+{
+    // Byte value -> its eight bits spread over eight 0/1 bytes.
+    static const auto spread = [] {
+        std::vector<uint64_t> t(256);
+        for (int b = 0; b < 256; ++b) {
+            uint64_t v = 0;
+            for (int k = 0; k < 8; ++k) {
+                v |= static_cast<uint64_t>((b >> k) & 1) << (k * 8);
+            }
+            t[b] = v;
+        }
+        return t;
+    }();
+
+    const std::size_t full = cells.size() / 8;
+    for (std::size_t k = 0; k < full; ++k) {
+        const uint64_t v = spread[(bits[k / 8] >> ((k % 8) * 8)) & 0xFFu];
+        std::memcpy(cells.data() + k * 8, &v, 8);
+    }
+    for (std::size_t i = full * 8; i < cells.size(); ++i) {
+        cells[i] = static_cast<uint8_t>((bits[i / 64] >> (i % 64)) & 1u);
+    }
+}
+
+uint64_t Checksum(const uint64_t *words, uint64_t n, uint64_t h)
+{
+    for (uint64_t i = 0; i < n; ++i) {
+        h = (h ^ words[i]) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+class MappedFile
+{
+public:
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+#else
+        if (data) {
+            munmap(const_cast<uint8_t *>(data), size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    bool Open(const std::string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER sz{};
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+            return false;
+        }
+        size = static_cast<std::size_t>(sz.QuadPart);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            return false;
+        }
+        data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return data != nullptr;
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        struct stat st {};
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+            return false;
+        }
+        size = static_cast<std::size_t>(st.st_size);
+        void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        madvise(p, size, MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t *>(p);
+        return true;
+#endif
+    }
+
+    const uint8_t *data{nullptr};
+    std::size_t size{0};
+
+private:
+#ifdef _WIN32
+    HANDLE file{INVALID_HANDLE_VALUE};
+    HANDLE mapping{nullptr};
+#else
+    int fd{-1};
+#endif
+};
+
+bool WriteAll(std::FILE *f, const void *p, std::size_t n)
+{
+    return std::fwrite(p, 1, n, f) == n;
+}
+
+}  // namespace
+
+bool Snapshot::Save(const Automaton &a, const std::string &path, std::string &err)
+{
+    std::vector<uint64_t> grid, init;
+    Pack(a.grid, grid);
+    Pack(a.init, init);
+
+    SnapshotHeader hdr{};
+    std::memcpy(hdr.magic, Cfg::Snapshot::MAGIC, sizeof(hdr.magic));
+    hdr.version = Cfg::Snapshot::VERSION;
+    hdr.headerSize = sizeof(SnapshotHeader);
+    hdr.w = a.w;
+    hdr.h = a.h;
+    hdr.ruleBits = a.ruleBits;
+    hdr.wrap = a.wrap ? 1u : 0u;
+    hdr.mode = static_cast<uint8_t>(a.mode);
+    hdr.iter = a.iter;
+    hdr.seed = a.seed;
+    hdr.rngState = a.rng.state;
+    for (int k = 0; k < Cfg::Automaton::RULE_BITS_COUNT; ++k) {
+        hdr.accept[k] = a.accept[k];
+    }
+    hdr.words = grid.size();
+    hdr.checksum = Checksum(init.data(), init.size(), Checksum(grid.data(), grid.size(), 0));
+
+    const std::string tmp = path + ".tmp";
+    std::FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        err = "cannot open " + tmp;
+        return false;
+    }
+    bool ok = WriteAll(f, &hdr, sizeof(hdr)) && WriteAll(f, grid.data(), grid.size() * sizeof(uint64_t)) &&
+              WriteAll(f, init.data(), init.size() * sizeof(uint64_t)) && std::fflush(f) == 0;
+    // The data must be on disk before the rename is, or a power loss can leave an empty file.
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        err = "failed to write " + tmp;
+        return false;
+    }
+
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        err = "failed to rename " + tmp;
+        return false;
+    }
+    return true;
+}
+
+bool Snapshot::Load(Automaton &a, const std::string &path, std::string &err)
+{
+    MappedFile file;
+    if (!file.Open(path)) {
+        err = "cannot map " + path;
+        return false;
+    }
+
+    SnapshotHeader hdr{};
+    if (file.size < sizeof(hdr)) {
+        err = path + " is not a snapshot";
+        return false;
+    }
+    std::memcpy(&hdr, file.data, sizeof(hdr));
+    if (std::memcmp(hdr.magic, Cfg::Snapshot::MAGIC, sizeof(hdr.magic)) != 0) {
+        err = path + " is not a snapshot";
+        return false;
+    }
+    if (hdr.version != Cfg::Snapshot::VERSION || hdr.headerSize != sizeof(SnapshotHeader)) {
+        err = path + ": unsupported snapshot version " + std::to_string(hdr.version);
+        return false;
+    }
+    const std::size_t cells = static_cast<std::size_t>(hdr.w) * static_cast<std::size_t>(hdr.h);
+    if (hdr.w < 1 || hdr.h < 1 || hdr.words != WordsFor(cells) ||
+        file.size != sizeof(hdr) + 2 * hdr.words * sizeof(uint64_t) ||
+        hdr.mode > static_cast<uint8_t>(UpdateMode::CHECKERBOARD)) {
+        err = path + ": corrupt snapshot header";
+        return false;
+    }
+
+    // The payload directly follows the 8-byte aligned header in a page-aligned mapping.
+    const uint64_t *grid = reinterpret_cast<const uint64_t *>(file.data + sizeof(hdr));
+    const uint64_t *init = grid + hdr.words;
+    if (Checksum(init, hdr.words, Checksum(grid, hdr.words, 0)) != hdr.checksum) {
+        err = path + ": checksum mismatch";
+        return false;
+    }
+
+    a.Resize(hdr.w, hdr.h);
+    Unpack(grid, a.grid);
+    Unpack(init, a.init);
+    a.SetRuleBits(hdr.ruleBits);
+    a.wrap = hdr.wrap != 0;
+    a.mode = static_cast<UpdateMode>(hdr.mode);
+    for (int k = 0; k < Cfg::Automaton::RULE_BITS_COUNT; ++k) {
+        a.accept[k] = hdr.accept[k];
+    }
+    a.seed = hdr.seed;
+    a.rng.state = hdr.rngState;
+    a.activeValid = false;
+    a.RecountMetrics();
+    a.iter = hdr.iter;
+    return true;
+}
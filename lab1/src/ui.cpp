@@ -70,7 +70,11 @@ void Ui::Create(HWND parent, HINSTANCE inst)
 
     for (int ms : Cfg::Timer::SPEED_OPTIONS) {
         wchar_t buf[32];
-        swprintf(buf, 32, L"%d ms", ms);
+        if (ms == Cfg::Timer::SPEED_MAX) {
+            swprintf(buf, 32, L"Max");
+        } else {
+            swprintf(buf, 32, L"%d ms", ms);
+        }
         SendMessageW(hSpeed, CB_ADDSTRING, 0, (LPARAM)buf);
     }
     SetSpeedDefault();
@@ -1,6 +1,10 @@
 #include "utils.h"
 #include "automaton.h"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 namespace Utils
 {
 
@@ -51,4 +55,28 @@ void ForAllPixels(const Automaton &a, int scale, const std::function<void(int, i
     }
 }
 
+void ParallelFor(int n, int threads, int minPerThread, const std::function<void(int, int)> &fn)
+{
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = std::min(threads, std::max(1, n / std::max(1, minPerThread)));
+    if (threads <= 1) {
+        fn(0, n);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (int t = 1; t < threads; ++t) {
+        const int begin = static_cast<int>(static_cast<int64_t>(n) * t / threads);
+        const int end = static_cast<int>(static_cast<int64_t>(n) * (t + 1) / threads);
+        pool.emplace_back(fn, begin, end);
+    }
+    fn(0, static_cast<int>(static_cast<int64_t>(n) / threads));
+    for (std::thread &t : pool) {
+        t.join();
+    }
+}
+
 }  // namespace utils
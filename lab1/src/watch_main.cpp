@@ -0,0 +1,83 @@
+#include "shmring.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void OnSignal(int)
+{
+    stopRequested = 1;
+}
+
+void PrintUsage()
+{
+    std::printf("Usage:\n");
+    std::printf("  crystali_watch NAME [--latest]\n");
+    std::printf("    NAME                shared-memory ring written by crystali_run --publish NAME\n");
+    std::printf("    --latest            read only the newest frame instead of every frame\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    std::string name;
+    bool latest = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--latest") {
+            latest = true;
+        } else if (name.empty() && a.rfind("--", 0) != 0) {
+            name = a;
+        } else {
+            PrintUsage();
+            std::fprintf(stderr, "Error: invalid argument %s\n", a.c_str());
+            return 1;
+        }
+    }
+    if (name.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    ShmRingReader reader;
+    std::string err;
+    if (!reader.Attach(name, err)) {
+        std::fprintf(stderr, "Error: %s\n", err.c_str());
+        return 2;
+    }
+
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point lastReport = Clock::now();
+    ShmFrame frame;
+    uint64_t frames = 0;
+    while (!stopRequested) {
+        if (!(latest ? reader.Latest(frame) : reader.Next(frame))) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } else {
+            ++frames;
+        }
+        const Clock::time_point now = Clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            const double sec = std::chrono::duration<double>(now - lastReport).count();
+            std::printf("iteration %llu, population %llu, %.1f frames/s, %llu skipped\n",
+                        static_cast<unsigned long long>(frame.iteration),
+                        static_cast<unsigned long long>(frame.population), frames / sec,
+                        static_cast<unsigned long long>(reader.Skipped()));
+            std::fflush(stdout);
+            frames = 0;
+            lastReport = now;
+        }
+    }
+    return 0;
+}
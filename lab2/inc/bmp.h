@@ -1,8 +1,12 @@
 #ifndef BMP_H
 #define BMP_H
 
+#include "mapped_file.h"
 #include "utils.h"
+#include <cstddef>
 #include <cstdint>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -12,6 +16,7 @@ namespace ct
 struct Bgr {
     uint8_t b{0}, g{0}, r{0};
 };
+static_assert(sizeof(Bgr) == 3, "Bgr pixels are read in place from BMP pixel data");
 
 struct Image {
     uint32_t width{0};
@@ -19,8 +24,136 @@ struct Image {
     std::vector<Bgr> pixels;
 };
 
+// Read-only view of `height` rows of `width` pixels, `rowStride` bytes apart starting with the top
+// row at `data`. The stride is negative for bottom-up BMP data and covers row padding, so the
+// pixel array of a mapped file is viewed in place. An Image converts to a contiguous view.
+struct ImageView {
+    const uint8_t *data{nullptr};
+    uint32_t width{0};
+    uint32_t height{0};
+    ptrdiff_t rowStride{0};
+
+    ImageView() = default;
+    ImageView(const uint8_t *d, uint32_t w, uint32_t h, ptrdiff_t stride)
+        : data(d), width(w), height(h), rowStride(stride)
+    {
+    }
+    ImageView(const Image &img)
+        : data(reinterpret_cast<const uint8_t *>(img.pixels.data())),
+          width(img.width),
+          height(img.height),
+          rowStride(3 * static_cast<ptrdiff_t>(img.width))
+    {
+    }
+
+    size_t size() const
+    {
+        return static_cast<size_t>(width) * height;
+    }
+    const Bgr *row(uint32_t y) const
+    {
+        return reinterpret_cast<const Bgr *>(data + static_cast<ptrdiff_t>(y) * rowStride);
+    }
+    bool contiguous() const
+    {
+        return rowStride == 3 * static_cast<ptrdiff_t>(width);
+    }
+    // Rows [y, y + n) as an image of their own.
+    ImageView rows(uint32_t y, uint32_t n) const
+    {
+        return ImageView{data + static_cast<ptrdiff_t>(y) * rowStride, width, n, rowStride};
+    }
+    // Pixels [begin, begin + m) in row-major order as one array: in place when they are stored that
+    // way, otherwise gathered into `scratch`, which must hold m pixels.
+    const Bgr *run(size_t begin, size_t m, Bgr *scratch) const;
+};
+
+enum class BmpCompression : uint32_t {
+    Rgb = 0,
+    Rle8 = 1,
+    Rle4 = 2,
+    Bitfields = 3
+};
+
+// How a BMP stores its pixels: enough to decode it or to write another one the same way.
+struct BmpFormat {
+    uint16_t bitCount{24};  // 1, 4, 8, 16, 24 or 32
+    BmpCompression compression{BmpCompression::Rgb};
+    // Channel masks of 16- and 32-bit pixels; uncompressed ones get the usual 5-5-5 / 8-8-8 masks.
+    uint32_t redMask{0};
+    uint32_t greenMask{0};
+    uint32_t blueMask{0};
+    std::vector<Bgr> palette;  // 1, 4 and 8 bits
+
+    bool paletted() const
+    {
+        return bitCount <= 8;
+    }
+};
+
+// A BMP file mapped into memory. 24-bit pixels are read in place: `view` points into the mapping
+// and is valid while this lives. Every other format is decoded once into `decoded`, which `view`
+// then shows.
+struct MappedBmp {
+    MappedFile file;
+    BmpFormat format;
+    Image decoded;
+    ImageView view;
+
+    // Whether `view` reads the mapping itself, so that pixels are only paged in as they are used.
+    bool inPlace() const
+    {
+        return decoded.pixels.empty();
+    }
+};
+
+// Maps the file and checks its headers; only formats other than 24-bit are read up front.
+// Uncompressed 1/4/8/16/24/32-bit, BI_BITFIELDS 16/32-bit and RLE4/RLE8 files are supported.
+Status openBmp(const std::string &path, MappedBmp &outBmp, std::string &outMessage);
+// Copies a view into an image that can be modified.
+Image copyImage(const ImageView &view);
+
 Status loadBmp(const std::string &path, Image &outImage, std::string &outMessage);
 Status saveBmp(const std::string &path, const Image &img, std::string &outMessage);
+// Saves in `format` instead of 24-bit, e.g. the format the image was loaded from. RLE formats are
+// written uncompressed at the same depth; a paletted format's palette must hold every colour of
+// the image (see collectPalette).
+Status saveBmp(const std::string &path, const Image &img, const BmpFormat &format, std::string &outMessage);
+
+// The distinct colours of an image in ascending order, if there are at most maxColors of them.
+bool collectPalette(const ImageView &img, size_t maxColors, std::vector<Bgr> &outPalette);
+
+class BmpRowEncoder;
+
+// Writes a BMP (24-bit unless opened with a format) a band of rows at a time, so the image never
+// has to be in memory whole.
+// BMP rows are stored bottom-up, so bands go in from the bottom of the image to the top.
+class BmpWriter
+{
+public:
+    BmpWriter();
+    ~BmpWriter();
+
+    Status open(const std::string &path, uint32_t width, uint32_t height, std::string &outMessage);
+    // Writes pixels in `format` (as saveBmp does) instead of 24-bit.
+    Status open(const std::string &path,
+                uint32_t width,
+                uint32_t height,
+                const BmpFormat &format,
+                std::string &outMessage);
+    // Writes `band`, the rows directly above those written so far.
+    Status writeBand(const ImageView &band, std::string &outMessage);
+    // Fails unless every row has been written.
+    Status close(std::string &outMessage);
+
+private:
+    std::ofstream file;
+    std::string path;
+    uint32_t width{0};
+    uint32_t rowsLeft{0};
+    std::vector<uint8_t> row;
+    std::unique_ptr<BmpRowEncoder> encoder;  // null for 24-bit
+};
 
 }  // namespace ct
 
@@ -0,0 +1,78 @@
+#ifndef BMP_ROWS_H
+#define BMP_ROWS_H
+
+#include "bmp.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ct
+{
+
+// Bytes per stored row of `width` pixels at `bitCount` bits, padded to 4 bytes.
+inline size_t bmpRowBytes(uint32_t width, uint16_t bitCount)
+{
+    return (static_cast<size_t>(width) * bitCount + 31) / 32 * 4;
+}
+
+// Whether `mask` is one run of set bits (or empty), as BI_BITFIELDS requires.
+bool validBmpMask(uint32_t mask);
+
+// One colour channel of a 16- or 32-bit pixel: its field is (pixel & mask) >> shift, 0..max,
+// scaled to and from 0..255 with rounding so that 8-bit values survive a round trip.
+struct BmpChannel {
+    uint32_t mask{0};
+    int shift{0};
+    uint32_t max{0};
+    std::vector<uint8_t> toByte;  // field value -> 0..255, for fields of up to 16 bits
+
+    BmpChannel() = default;
+    explicit BmpChannel(uint32_t m);
+    uint8_t decode(uint32_t pixel) const
+    {
+        const uint32_t v = (pixel & mask) >> shift;
+        return toByte.empty() ? static_cast<uint8_t>((uint64_t{v} * 255 + max / 2) / max) : toByte[v];
+    }
+    uint32_t encode(uint8_t c) const
+    {
+        return max == 0 ? 0 : static_cast<uint32_t>((uint64_t{c} * max + 127) / 255) << shift;
+    }
+};
+
+// Converts uncompressed rows of any supported format to Bgr. Tables are built once per
+// image: paletted rows go through the pixels of every possible byte (8 / bitCount of them), 16-bit
+// fields through a lookup per channel, and 32-bit pixels with the usual 8-8-8 masks through an
+// SSSE3 byte shuffle when the CPU has one.
+class BmpRowDecoder
+{
+public:
+    explicit BmpRowDecoder(const BmpFormat &format);
+    void decode(const uint8_t *src, uint32_t width, Bgr *out) const;
+
+private:
+    uint16_t bits;
+    bool bgrx{false};
+    std::vector<Bgr> expand;
+    std::array<BmpChannel, 3> channels;  // r, g, b
+};
+
+// The inverse: Bgr rows to `format`. Paletted formats need every colour written in the palette;
+// 16- and 32-bit pixels get the bits outside the colour masks set, so any alpha reads as opaque.
+class BmpRowEncoder
+{
+public:
+    explicit BmpRowEncoder(const BmpFormat &format);
+    void encode(const Bgr *in, uint32_t width, uint8_t *dst) const;
+
+private:
+    uint16_t bits;
+    uint32_t fill{0};
+    std::unordered_map<uint32_t, uint8_t> index;
+    std::array<BmpChannel, 3> channels;
+};
+
+}  // namespace ct
+
+#endif  // BMP_ROWS_H
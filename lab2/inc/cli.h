@@ -15,7 +15,14 @@ enum class ApplyMode : uint8_t {
     Blend = 1
 };
 
+enum class CliCommand : uint8_t {
+    Transfer = 0,
+    Precompute = 1  // fill the stats cache for a list of sources
+};
+
 struct CliOptions {
+    CliCommand command{CliCommand::Transfer};
+    std::vector<std::string> sources;  // precompute only
     std::string srcPath;
     std::string tgtPath;
     std::string outPrefix;
@@ -26,6 +33,15 @@ struct CliOptions {
     double alpha{1.0};
 
     std::string saveMaskPath;
+
+    int lutGrid{0};  // 0 = exact Lab conversions
+    bool memoColors{true};
+    bool simd{false};       // single-precision batch kernels when no LUT is used
+    int threads{0};         // 0 = one per hardware thread
+    int streamRows{0};      // rows per band of a streamed transfer; 0 = result held in memory
+    bool keepDepth{false};  // write the result with the target's bit depth instead of 24-bit
+
+    std::string statsCacheDir;  // empty = source stats not cached
 };
 
 Result<CliOptions> parseCli(int argc, char **argv);
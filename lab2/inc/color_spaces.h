@@ -15,9 +15,15 @@ struct RgbNorm {
     double r, g, b;
 };
 
+inline constexpr double MIN_VAL = 3.0 / 255.0;           // 0.01176 to avoid log(0)
+inline constexpr double WHITE_COMPRESS = 235.0 / 255.0;  // 0.92157
+
 RgbNorm toRgbNorm(const Bgr &p, bool compressWhite);
 Bgr fromRgbNorm(const RgbNorm &rn, bool expandWhite);
 
+// rgbToLms / lmsToRgb work on log10 LMS; the linear variants are the bare matrices.
+Vec3d rgbToLinearLms(const RgbNorm &rn);
+RgbNorm linearLmsToRgb(const Vec3d &lms);
 Vec3d rgbToLms(const RgbNorm &rn);
 Vec3d lmsToLab(const Vec3d &lms);
 Vec3d labToLms(const Vec3d &lab);
@@ -0,0 +1,50 @@
+#ifndef COLOR_TABLE_H
+#define COLOR_TABLE_H
+
+#include "bmp.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ct
+{
+
+// Memoising per colour pays off once colours repeat this many times on average.
+inline constexpr size_t COLOR_TABLE_MIN_REUSE = 2;
+// Clearing and scanning the 2^24-bit table costs about as much as converting this many pixels.
+inline constexpr size_t COLOR_TABLE_MIN_PIXELS = size_t{1} << 16;
+
+// Distinct colours of an image and how many pixels have each. A colour's key is r << 16 | g << 8 | b;
+// one bit per possible key plus the number of set bits before every 64-bit word give each pixel the
+// index of its colour without hashing.
+struct ColorTable {
+    std::vector<uint64_t> present;  // 2^24 bits
+    std::vector<uint32_t> rank;     // colours before each word of `present`
+    std::vector<Bgr> colors;        // ascending key order
+    std::vector<uint64_t> counts;   // 64-bit: one colour can cover more than 2^32 pixels
+    size_t pixels{0};
+
+    static constexpr uint32_t keyOf(const Bgr &p)
+    {
+        return static_cast<uint32_t>(p.r) << 16 | static_cast<uint32_t>(p.g) << 8 | p.b;
+    }
+
+    size_t indexOf(const Bgr &p) const
+    {
+        const uint32_t key = keyOf(p);
+        const uint64_t below = present[key >> 6] & ((uint64_t{1} << (key & 63)) - 1);
+        return rank[key >> 6] + static_cast<size_t>(__builtin_popcountll(below));
+    }
+
+    // Whether converting per colour instead of per pixel is worth it.
+    bool worthMemoising() const
+    {
+        return pixels != 0 && colors.size() * COLOR_TABLE_MIN_REUSE <= pixels;
+    }
+};
+
+ColorTable buildColorTable(const ImageView &img);
+
+}  // namespace ct
+
+#endif  // COLOR_TABLE_H
@@ -4,8 +4,14 @@
 #include "bmp.h"
 #include "cli.h"
 #include "color_spaces.h"
+#include "color_table.h"
+#include "lab_lut.h"
+#include "planar.h"
 #include "region.h"
+#include "thread_pool.h"
 #include "utils.h"
+#include <functional>
+#include <vector>
 
 namespace ct
 {
@@ -15,20 +21,74 @@ struct Stats {
     Vec3d var{0, 0, 0};
 };
 
-Stats computeLabStats(const Image &img);
+// `lut` selects the table-driven conversions, `simd` the single-precision batch kernels of
+// lab_simd.h (ignored with a LUT); neither uses the exact ones. With a `pool` the work is split
+// into fixed-size chunks whose results are merged in order, so any thread count gives the same
+// answer.
+Stats computeLabStats(const ImageView &img,
+                      const LabLut *lut = nullptr,
+                      bool simd = false,
+                      ThreadPool *pool = nullptr);
+// The same statistics from the image's colour table, converting each distinct colour once.
+Stats computeLabStats(const ColorTable &colors,
+                      const LabLut *lut = nullptr,
+                      bool simd = false,
+                      ThreadPool *pool = nullptr);
 
-Image applyColorTransferLab(const Image &target,
+// Lab planes of an image (l, alpha, beta), converted once so the stats and transfer passes can
+// share them. Double samples hold every conversion exactly, so both passes give the same result
+// as from the image. Worth it with the exact conversions; the SIMD kernels and the LUT convert
+// faster than 24 bytes a pixel can be written and read back.
+PlanarF64 computeLabPlanes(const ImageView &img,
+                           const LabLut *lut = nullptr,
+                           bool simd = false,
+                           ThreadPool *pool = nullptr);
+// Same result as computeLabStats on the image the planes came from.
+Stats computeLabStats(const PlanarF64 &lab, ThreadPool *pool = nullptr);
+
+Image applyColorTransferLab(const ImageView &target,
                             const Stats &srcStats,
                             const Stats &tgtStats,
                             const std::array<bool, 3> &channelMask);
 
-Image applyColorTransferLabMasked(const Image &target,
+// `colors`, when given, must be the colour table of `target`: each distinct colour is then
+// transferred once and pixels are remapped by lookup. Otherwise `targetLab`, when given, must be
+// computeLabPlanes(target) with the same lut and simd and replaces the forward conversion.
+Image applyColorTransferLabMasked(const ImageView &target,
                                   const Stats &srcStats,
                                   const Stats &tgtStats,
                                   const std::array<bool, 3> &channelMask,
                                   const RegionMask *regionMask,
                                   ApplyMode mode,
-                                  double alpha);
+                                  double alpha,
+                                  const LabLut *lut = nullptr,
+                                  const ColorTable *colors = nullptr,
+                                  bool simd = false,
+                                  ThreadPool *pool = nullptr,
+                                  const PlanarF64 *targetLab = nullptr);
+
+// Receives each finished band of a streamed transfer: `y` is the image row of its first row.
+using BandSink = std::function<Status(uint32_t y, const Image &band)>;
+
+// Out-of-core applyColorTransferLabMasked: the target is transferred `bandRows` rows at a time
+// (0 = all at once) and every band goes to `sink` as soon as it is done, bottom band first as BMP
+// stores rows. For a target read in place from a mapped 24-bit BMP, memory use depends on the band
+// height, not on the image size; other formats are decoded whole by openBmp. The region mask of
+// each band is painted from `brushes`; without brushes the whole image is transferred. Bands hold
+// the same pixels as the in-memory transfer.
+Status streamColorTransferLab(const ImageView &target,
+                              const Stats &srcStats,
+                              const Stats &tgtStats,
+                              const std::array<bool, 3> &channelMask,
+                              const std::vector<Brush> &brushes,
+                              ApplyMode mode,
+                              double alpha,
+                              uint32_t bandRows,
+                              const BandSink &sink,
+                              const LabLut *lut = nullptr,
+                              const ColorTable *colors = nullptr,
+                              bool simd = false,
+                              ThreadPool *pool = nullptr);
 
 }  // namespace ct
 
@@ -2,7 +2,10 @@
 #define HISTOGRAM_H
 
 #include "bmp.h"
+#include "planar.h"
+#include "thread_pool.h"
 #include "utils.h"
+#include <vector>
 
 namespace ct
 {
@@ -13,11 +16,29 @@ struct ChannelImages {
     Image ch2;
 };
 
-void buildRgbHistograms(const Image &img, H256 &r, H256 &g, H256 &b);
+// The R, G and B histograms of one image.
+struct RgbHistogramJob {
+    ImageView img;
+    H256 *r{nullptr};
+    H256 *g{nullptr};
+    H256 *b{nullptr};
+};
+
+// All three channels are counted in one pass over the pixels, into several sub-histograms per
+// channel so that repeated colours do not serialise on one counter. Rows are split into chunks
+// for the pool, and the chunks' partial histograms are added up at the end.
+void buildRgbHistograms(const ImageView &img, H256 &r, H256 &g, H256 &b, ThreadPool *pool = nullptr);
+// Adds the image's counts to r, g and b, e.g. one band of a streamed image at a time.
+void accumulateRgbHistograms(const ImageView &img, H256 &r, H256 &g, H256 &b, ThreadPool *pool = nullptr);
+// Several images in one job for the pool, e.g. the target and the result together.
+void buildRgbHistograms(const std::vector<RgbHistogramJob> &jobs, ThreadPool *pool = nullptr);
+void accumulateRgbHistograms(const std::vector<RgbHistogramJob> &jobs, ThreadPool *pool = nullptr);
 
 Status saveHistogramCsv(const std::string &path, const H256 &h, std::string &outMessage);
 
-ChannelImages makeRgbChannelViews(const Image &img);
+// Grey images of the R, G and B channels, e.g. for saving. These are copies; channelView() reads a
+// channel in place.
+ChannelImages makeRgbChannelViews(const ImageView &img);
 
 }  // namespace ct
 
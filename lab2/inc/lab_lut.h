@@ -0,0 +1,102 @@
+#ifndef LAB_LUT_H
+#define LAB_LUT_H
+
+#include "bmp.h"
+#include "color_spaces.h"
+#include "utils.h"
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ct
+{
+
+// Table-driven rgbToLab / labToRgb for the transfer pipeline (compressWhite / expandWhite on).
+//
+// RGB->Lab: exact Lab values on a gridSize^3 lattice, interpolated tetrahedrally. Every byte maps
+// through a 256-entry shaper to a cell and a fraction; the nodes are spaced cubically from the
+// point below which toRgbNorm clamps, so they are densest where log10 bends hardest.
+// Lab->RGB: the only non-linear step is 10^x on each LMS channel, which is separable and sees
+// unbounded input after the transfer, so it gets a 1D table with linear interpolation instead of
+// a 3D one; arguments outside the table fall back to std::pow.
+//
+// Maximum error against the exact path, over all 2^24 colours:
+//   RGB->Lab, any channel:  grid 17: 1.7e-2   grid 33: 4.2e-3   grid 65: 9.3e-4
+//   Lab->RGB:  off by one level in a channel for 0.031% of the colours, never more
+// For scale, one grey level moves l by 3.0e-3 at 250 and by 7.2e-2 at 10.
+struct LabLut {
+    static constexpr double POW10_LO = -4.0;
+    static constexpr double POW10_HI = 1.0;
+    static constexpr int POW10_SIZE = 8192;  // intervals
+    static constexpr double POW10_SCALE = POW10_SIZE / (POW10_HI - POW10_LO);
+
+    int gridSize{0};
+    std::vector<float> nodes;  // gridSize^3 Lab triples, r slowest, b fastest
+    std::array<uint16_t, 256> cell{};
+    std::array<float, 256> frac{};
+    std::vector<double> pow10;  // POW10_SIZE + 1 samples over [POW10_LO, POW10_HI]
+};
+
+inline constexpr int LAB_LUT_DEFAULT_GRID = 33;
+inline constexpr int LAB_LUT_MAX_GRID = 129;
+
+Result<LabLut> makeLabLut(int gridSize);
+
+inline Vec3d rgbToLabLut(const LabLut &lut, const Bgr &p)
+{
+    const size_t sb = 3;
+    const size_t sg = sb * static_cast<size_t>(lut.gridSize);
+    const size_t sr = sg * static_cast<size_t>(lut.gridSize);
+    const float fr = lut.frac[p.r], fg = lut.frac[p.g], fb = lut.frac[p.b];
+    const float *c0 = lut.nodes.data() + lut.cell[p.r] * sr + lut.cell[p.g] * sg + lut.cell[p.b] * sb;
+
+    // The cell splits along its diagonal into six tetrahedra, picked by the order of the fractions.
+    size_t o1, o2;
+    float w0, w1, w2, w3;
+    if (fr >= fg) {
+        if (fg >= fb) {
+            o1 = sr, o2 = sr + sg, w0 = 1 - fr, w1 = fr - fg, w2 = fg - fb, w3 = fb;
+        } else if (fr >= fb) {
+            o1 = sr, o2 = sr + sb, w0 = 1 - fr, w1 = fr - fb, w2 = fb - fg, w3 = fg;
+        } else {
+            o1 = sb, o2 = sr + sb, w0 = 1 - fb, w1 = fb - fr, w2 = fr - fg, w3 = fg;
+        }
+    } else {
+        if (fb >= fg) {
+            o1 = sb, o2 = sg + sb, w0 = 1 - fb, w1 = fb - fg, w2 = fg - fr, w3 = fr;
+        } else if (fb >= fr) {
+            o1 = sg, o2 = sg + sb, w0 = 1 - fg, w1 = fg - fb, w2 = fb - fr, w3 = fr;
+        } else {
+            o1 = sg, o2 = sr + sg, w0 = 1 - fg, w1 = fg - fr, w2 = fr - fb, w3 = fb;
+        }
+    }
+    const float *c1 = c0 + o1;
+    const float *c2 = c0 + o2;
+    const float *c3 = c0 + sr + sg + sb;
+    return Vec3d{w0 * c0[0] + w1 * c1[0] + w2 * c2[0] + w3 * c3[0], w0 * c0[1] + w1 * c1[1] + w2 * c2[1] + w3 * c3[1],
+                 w0 * c0[2] + w1 * c1[2] + w2 * c2[2] + w3 * c3[2]};
+}
+
+inline double pow10Lut(const LabLut &lut, double x)
+{
+    const double t = (x - LabLut::POW10_LO) * LabLut::POW10_SCALE;
+    if (!(t >= 0.0 && t < LabLut::POW10_SIZE)) {
+        return std::pow(10.0, x);
+    }
+    const int i = static_cast<int>(t);
+    const double f = t - i;
+    return lut.pow10[i] + (lut.pow10[i + 1] - lut.pow10[i]) * f;
+}
+
+inline Bgr labToRgbLut(const LabLut &lut, const Vec3d &lab)
+{
+    const Vec3d lmsLog = labToLms(lab);
+    const Vec3d lms{pow10Lut(lut, lmsLog.x), pow10Lut(lut, lmsLog.y), pow10Lut(lut, lmsLog.z)};
+    return fromRgbNorm(linearLmsToRgb(lms), true);
+}
+
+}  // namespace ct
+
+#endif  // LAB_LUT_H
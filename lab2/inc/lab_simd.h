@@ -0,0 +1,37 @@
+#ifndef LAB_SIMD_H
+#define LAB_SIMD_H
+
+#include "bmp.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace ct
+{
+
+// Batch rgbToLab / labToRgb (compressWhite / expandWhite on) in single precision. Each batch is
+// deinterleaved into R, G, B float planes, pushed through the matrices and polynomial log10 / exp10
+// eight (AVX2 + FMA) or four (SSE2) pixels at a time, and interleaved back. The widest kernel the
+// CPU supports is picked at run time; without x86 SIMD the exact scalar functions are used.
+//
+// Error against the exact path, over all 2^24 colours:
+//   RGB->Lab, any channel: 4.8e-7
+//   Lab->RGB:              off by one level in a channel for 0.027% of the colours, never more
+//                          (values within float rounding of a level boundary)
+enum class SimdLevel : uint8_t {
+    None = 0,
+    Sse2 = 1,
+    Avx2 = 2
+};
+
+// Widest level this CPU runs.
+SimdLevel simdLevel();
+const char *simdLevelName(SimdLevel level);
+
+// Levels above simdLevel() are lowered to it.
+void rgbToLabBatch(const Bgr *in, size_t n, float *l, float *a, float *b, SimdLevel level = simdLevel());
+void labToRgbBatch(const float *l, const float *a, const float *b, size_t n, Bgr *out,
+                   SimdLevel level = simdLevel());
+
+}  // namespace ct
+
+#endif  // LAB_SIMD_H
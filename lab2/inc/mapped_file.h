@@ -0,0 +1,46 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ct
+{
+
+// A whole file mapped read-only. Pages are read in by the OS on first touch and stay in the page
+// cache, so opening costs nothing up front and untouched parts of the file are never read.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    Status open(const std::string &path, std::string &outMessage);
+    void close();
+
+    const uint8_t *data() const
+    {
+        return bytes;
+    }
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    const uint8_t *bytes{nullptr};
+    size_t length{0};
+#ifdef _WIN32
+    void *mapping{nullptr};
+#endif
+};
+
+}  // namespace ct
+
+#endif  // MAPPED_FILE_H
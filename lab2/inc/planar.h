@@ -0,0 +1,171 @@
+#ifndef PLANAR_H
+#define PLANAR_H
+
+#include "bmp.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace ct
+{
+
+// IEEE 754 binary16 sample, converted in software (round to nearest even).
+struct Half {
+    uint16_t bits{0};
+};
+
+Half floatToHalf(float v);
+float halfToFloat(Half h);
+
+// Non-owning view of one channel: `width` x `height` samples, `pixelStride` elements apart within
+// a row and `rowStride` elements between rows. Views alias the storage they were taken from, so a
+// channel of an interleaved Image or a window of a plane costs nothing to make.
+template<typename T>
+struct PlaneView {
+    T *data{nullptr};
+    uint32_t width{0};
+    uint32_t height{0};
+    ptrdiff_t pixelStride{1};
+    ptrdiff_t rowStride{0};
+
+    T *row(uint32_t y) const
+    {
+        return data + static_cast<ptrdiff_t>(y) * rowStride;
+    }
+    T &at(uint32_t x, uint32_t y) const
+    {
+        return row(y)[static_cast<ptrdiff_t>(x) * pixelStride];
+    }
+    bool contiguous() const
+    {
+        return pixelStride == 1 && rowStride == static_cast<ptrdiff_t>(width);
+    }
+    // The w x h window at (x, y), clipped to the view.
+    PlaneView sub(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const
+    {
+        PlaneView v = *this;
+        x = x < width ? x : width;
+        y = y < height ? y : height;
+        v.data = data + static_cast<ptrdiff_t>(y) * rowStride + static_cast<ptrdiff_t>(x) * pixelStride;
+        v.width = w < width - x ? w : width - x;
+        v.height = h < height - y ? h : height - y;
+        return v;
+    }
+    operator PlaneView<const T>() const
+    {
+        return PlaneView<const T>{data, width, height, pixelStride, rowStride};
+    }
+};
+
+// Three planes in one channel-major allocation: R, G, B for colour images, l, alpha, beta for Lab.
+template<typename T>
+struct PlanarImage {
+    uint32_t width{0};
+    uint32_t height{0};
+    std::vector<T> samples;
+
+    PlanarImage() = default;
+    PlanarImage(uint32_t w, uint32_t h) : width(w), height(h), samples(size_t{3} * w * h) {}
+
+    size_t planeSize() const
+    {
+        return static_cast<size_t>(width) * height;
+    }
+    T *plane(int c)
+    {
+        return samples.data() + c * planeSize();
+    }
+    const T *plane(int c) const
+    {
+        return samples.data() + c * planeSize();
+    }
+    PlaneView<T> view(int c)
+    {
+        return PlaneView<T>{plane(c), width, height, 1, static_cast<ptrdiff_t>(width)};
+    }
+    PlaneView<const T> view(int c) const
+    {
+        return PlaneView<const T>{plane(c), width, height, 1, static_cast<ptrdiff_t>(width)};
+    }
+};
+
+using PlanarU8 = PlanarImage<uint8_t>;
+using PlanarF32 = PlanarImage<float>;
+using PlanarF64 = PlanarImage<double>;
+using PlanarF16 = PlanarImage<Half>;
+
+// Channel c (0 = R, 1 = G, 2 = B) of an interleaved image, without copying.
+PlaneView<const uint8_t> channelView(const ImageView &img, int c);
+PlaneView<uint8_t> channelView(Image &img, int c);
+
+// Sample conversions. Floats keep the 0..255 scale of bytes; going back to bytes rounds and clamps.
+inline float sampleToFloat(uint8_t v)
+{
+    return v;
+}
+inline float sampleToFloat(float v)
+{
+    return v;
+}
+inline float sampleToFloat(double v)
+{
+    return static_cast<float>(v);
+}
+inline float sampleToFloat(Half v)
+{
+    return halfToFloat(v);
+}
+
+template<typename T>
+T sampleFromFloat(float v)
+{
+    if constexpr (std::is_same_v<T, uint8_t>) {
+        return clampToByte(v + 0.5);
+    } else if constexpr (std::is_same_v<T, Half>) {
+        return floatToHalf(v);
+    } else {
+        return static_cast<T>(v);
+    }
+}
+
+// Copies src into dst sample by sample, converting the sample type; both must be the same size.
+template<typename Dst, typename Src>
+void copyPlane(const PlaneView<const Src> &src, const PlaneView<Dst> &dst)
+{
+    for (uint32_t y = 0; y < src.height; ++y) {
+        const Src *s = src.row(y);
+        Dst *d = dst.row(y);
+        for (uint32_t x = 0; x < src.width; ++x) {
+            if constexpr (std::is_same_v<Src, Dst>) {
+                d[x * dst.pixelStride] = s[x * src.pixelStride];
+            } else {
+                d[x * dst.pixelStride] = sampleFromFloat<Dst>(sampleToFloat(s[x * src.pixelStride]));
+            }
+        }
+    }
+}
+
+template<typename T>
+PlanarImage<T> toPlanar(const ImageView &img)
+{
+    PlanarImage<T> out(img.width, img.height);
+    for (int c = 0; c < 3; ++c) {
+        copyPlane<T, uint8_t>(channelView(img, c), out.view(c));
+    }
+    return out;
+}
+
+template<typename T>
+Image toImage(const PlanarImage<T> &planes)
+{
+    Image out{planes.width, planes.height, std::vector<Bgr>(planes.planeSize())};
+    for (int c = 0; c < 3; ++c) {
+        copyPlane<uint8_t, T>(planes.view(c), channelView(out, c));
+    }
+    return out;
+}
+
+}  // namespace ct
+
+#endif  // PLANAR_H
@@ -31,8 +31,17 @@ struct RegionMask {
 RegionMask makeEmptyMask(uint32_t width, uint32_t height);
 void applyBrush(RegionMask &m, const Brush &b);
 void applyBrushes(RegionMask &m, const std::vector<Brush> &brushes);
+// Rows [y, y + rows) of the mask the brushes paint on a `width`-wide image, as a mask of its own.
+RegionMask makeBrushMaskRows(uint32_t width, uint32_t y, uint32_t rows, const std::vector<Brush> &brushes);
 
 Status saveMaskBmp(const std::string &path, const RegionMask &m, std::string &outMessage);
+// The same for the brush mask of a width x height image, written `bandRows` rows at a time.
+Status saveMaskBmp(const std::string &path,
+                   uint32_t width,
+                   uint32_t height,
+                   const std::vector<Brush> &brushes,
+                   uint32_t bandRows,
+                   std::string &outMessage);
 
 }  // namespace ct
 
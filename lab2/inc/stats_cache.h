@@ -0,0 +1,46 @@
+#ifndef STATS_CACHE_H
+#define STATS_CACHE_H
+
+#include "color_transfer.h"
+#include "utils.h"
+#include <cstdint>
+#include <string>
+
+namespace ct
+{
+
+// What color_transfer needs from a source image: its Lab statistics and RGB histograms.
+struct SourceStats {
+    Stats stats;
+    H256 r{};
+    H256 g{};
+    H256 b{};
+};
+
+// The conversion settings statistics depend on, e.g. "simd-avx2", "exact-nomemo" or "lut33"; stats
+// computed with other settings are not reused. SIMD levels round differently, so the tag names
+// the level this CPU runs.
+std::string statsCacheTag(int lutGrid, bool simd, bool memoColors);
+
+// Directory of SourceStats, one file per hash of a source file's contents and tag. Each source
+// path also gets a small index file holding its size, modification time and content hash, so a
+// file that has not changed is not read again to find its entry. Entries are written to a
+// temporary file and renamed into place, so concurrent runs sharing a directory are safe.
+class StatsCache
+{
+public:
+    explicit StatsCache(std::string directory);
+
+    // Hash of the file's contents: from the index when size and mtime still match, otherwise read
+    // from the file and recorded.
+    Result<uint64_t> contentHash(const std::string &path) const;
+    bool load(uint64_t hash, const std::string &tag, SourceStats &out) const;
+    Status store(uint64_t hash, const std::string &tag, const SourceStats &s, std::string &outMessage) const;
+
+private:
+    std::string dir;
+};
+
+}  // namespace ct
+
+#endif  // STATS_CACHE_H
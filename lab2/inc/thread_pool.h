@@ -0,0 +1,61 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "utils.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ct
+{
+
+// Fixed set of worker threads that run the chunks of one job at a time. Chunks are handed out in
+// index order from a shared counter, so how work is split never depends on the thread count; a
+// caller that merges per-chunk results in chunk order gets the same answer with any pool size.
+class ThreadPool
+{
+public:
+    // 0 threads = one per hardware thread. The calling thread works too, so n threads start n - 1
+    // workers and a pool of 1 runs everything inline.
+    explicit ThreadPool(unsigned threads = 0);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    unsigned size() const
+    {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    // Calls fn(i, chunks[i]) for every chunk and returns once all have finished. Not reentrant:
+    // one job at a time, and fn must not call back into the pool.
+    void run(const std::vector<Range> &chunks, const std::function<void(size_t, const Range &)> &fn);
+
+private:
+    void workerLoop();
+    void drain();
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::vector<Range> *jobChunks{nullptr};
+    const std::function<void(size_t, const Range &)> *jobFn{nullptr};
+    std::atomic<size_t> nextChunk{0};
+    size_t generation{0};
+    unsigned active{0};
+    bool stopping{false};
+};
+
+// Runs the chunks on `pool`, or in order on the calling thread without one.
+void runChunks(ThreadPool *pool,
+               const std::vector<Range> &chunks,
+               const std::function<void(size_t, const Range &)> &fn);
+
+}  // namespace ct
+
+#endif  // THREAD_POOL_H
@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -67,6 +68,9 @@ std::vector<Range> makeChunks(size_t total, size_t targetChunkSize);
 
 using H256 = std::array<uint32_t, 256>;
 
+// XXH64 of n bytes: fast enough to fingerprint large files, not for anything adversarial.
+uint64_t hashBytes(const uint8_t *data, size_t n, uint64_t seed = 0);
+
 std::string toLower(std::string s);
 bool endsWith(const std::string &s, const std::string &suffix);
 
@@ -1,5 +1,12 @@
 #include "bmp.h"
+#include "bmp_rows.h"
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <new>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
 
 namespace ct
 {
@@ -28,105 +35,463 @@ struct BmpInfoHeader {
 };
 #pragma pack(pop)
 
-static bool is24BitUncompressed(const BmpInfoHeader &ih)
+// Largest image decoded into memory (3 GB of pixels). Uncompressed data is bounded by the file
+// size, but a few bytes of RLE data can claim any size, so the header alone cannot be trusted.
+static constexpr uint64_t BMP_MAX_DECODED_PIXELS = uint64_t{1} << 30;
+
+// Where and how a BMP's pixels are stored.
+struct BmpLayout {
+    uint32_t width{0};
+    uint32_t height{0};
+    bool bottomUp{true};
+    size_t dataOffset{0};
+    size_t rowStride{0};
+    BmpFormat format;
+};
+
+static bool supportedFormat(uint16_t bits, uint32_t compression)
 {
-    return ih.biBitCount == 24 && ih.biCompression == 0;
+    switch (static_cast<BmpCompression>(compression)) {
+        case BmpCompression::Rgb:
+            return bits == 1 || bits == 4 || bits == 8 || bits == 16 || bits == 24 || bits == 32;
+        case BmpCompression::Rle8:
+            return bits == 8;
+        case BmpCompression::Rle4:
+            return bits == 4;
+        case BmpCompression::Bitfields:
+            return bits == 16 || bits == 32;
+        default:
+            return false;
+    }
 }
 
-Status loadBmp(const std::string &path, Image &outImage, std::string &outMessage)
+static uint32_t readU32(const uint8_t *p)
 {
-    FileData fd = readFile(path);
-    if (fd.status != Status::Ok) {
-        outMessage = fd.message;
-        return fd.status;
-    }
-    if (fd.bytes.size() < sizeof(BmpFileHeader) + sizeof(BmpInfoHeader)) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Checks the headers of the BMP in `bytes` and reads its pixel format, masks and palette.
+static Status parseBmp(const uint8_t *bytes, size_t size, BmpLayout &out, std::string &outMessage)
+{
+    if (size < sizeof(BmpFileHeader) + sizeof(BmpInfoHeader)) {
         outMessage = "File too small for BMP headers";
         return Status::ParseError;
     }
 
-    const auto *fh = reinterpret_cast<const BmpFileHeader *>(fd.bytes.data());
-    if (fh->bfType != 0x4D42) {  // 'BM'
+    BmpFileHeader fh;
+    BmpInfoHeader ih;
+    std::memcpy(&fh, bytes, sizeof(fh));
+    std::memcpy(&ih, bytes + sizeof(fh), sizeof(ih));
+    if (fh.bfType != 0x4D42) {  // 'BM'
         outMessage = "Not a BMP file";
         return Status::Unsupported;
     }
-    const auto *ih = reinterpret_cast<const BmpInfoHeader *>(fd.bytes.data() + sizeof(BmpFileHeader));
-    if (!is24BitUncompressed(*ih)) {
-        outMessage = "Only 24-bit uncompressed BMP supported";
+    if (ih.biSize < sizeof(BmpInfoHeader) || ih.biSize > size - sizeof(fh)) {
+        outMessage = "Unsupported BMP info header";
+        return Status::Unsupported;
+    }
+    if (!supportedFormat(ih.biBitCount, ih.biCompression)) {
+        outMessage = "Unsupported BMP format: " + std::to_string(ih.biBitCount) + "-bit, compression " +
+                     std::to_string(ih.biCompression);
         return Status::Unsupported;
     }
-    if (ih->biWidth <= 0 || ih->biHeight == 0) {
+    if (ih.biWidth <= 0 || ih.biHeight == 0 || ih.biHeight == INT32_MIN) {
         outMessage = "Invalid dimensions";
         return Status::ParseError;
     }
 
-    uint32_t width = static_cast<uint32_t>(ih->biWidth);
-    uint32_t height = static_cast<uint32_t>(std::abs(ih->biHeight));
-    bool bottomUp = ih->biHeight > 0;
-    size_t rowStride = ((width * 3u + 3u) / 4u) * 4u;
+    BmpFormat &format = out.format;
+    format.bitCount = ih.biBitCount;
+    format.compression = static_cast<BmpCompression>(ih.biCompression);
+    const bool rle = format.compression == BmpCompression::Rle8 || format.compression == BmpCompression::Rle4;
+    out.width = static_cast<uint32_t>(ih.biWidth);
+    out.height = static_cast<uint32_t>(ih.biHeight > 0 ? ih.biHeight : -ih.biHeight);
+    out.bottomUp = ih.biHeight > 0;
+    out.rowStride = bmpRowBytes(out.width, format.bitCount);
+    if (rle && !out.bottomUp) {
+        outMessage = "RLE BMP cannot be top-down";
+        return Status::ParseError;
+    }
+    const uint64_t pixels = uint64_t{out.width} * out.height;
+    const bool decoded = format.bitCount != 24 || format.compression != BmpCompression::Rgb;
+    if (pixels * 3 > SIZE_MAX || (decoded && pixels > BMP_MAX_DECODED_PIXELS)) {
+        outMessage = "BMP too large: " + std::to_string(out.width) + "x" + std::to_string(out.height);
+        return Status::Overflow;
+    }
+
+    // BI_BITFIELDS masks follow a 40-byte header, or are its next fields in the larger versions.
+    size_t headersEnd = sizeof(fh) + ih.biSize;
+    if (format.compression == BmpCompression::Bitfields) {
+        const size_t masksAt = sizeof(fh) + sizeof(ih);
+        if (size < masksAt + 12) {
+            outMessage = "BMP bit masks outside file";
+            return Status::ParseError;
+        }
+        format.redMask = readU32(bytes + masksAt);
+        format.greenMask = readU32(bytes + masksAt + 4);
+        format.blueMask = readU32(bytes + masksAt + 8);
+        headersEnd = std::max(headersEnd, masksAt + 12);
+        const uint64_t limit = format.bitCount == 16 ? 0xFFFF : 0xFFFFFFFF;
+        for (uint32_t m : {format.redMask, format.greenMask, format.blueMask}) {
+            if (!validBmpMask(m) || m > limit) {
+                outMessage = "Invalid BMP bit masks";
+                return Status::ParseError;
+            }
+        }
+    } else if (format.bitCount == 16) {
+        format.redMask = 0x7C00;
+        format.greenMask = 0x03E0;
+        format.blueMask = 0x001F;
+    } else if (format.bitCount == 32) {
+        format.redMask = 0xFF0000;
+        format.greenMask = 0x00FF00;
+        format.blueMask = 0x0000FF;
+    }
+
+    if (format.paletted()) {
+        const uint32_t maxColors = 1u << format.bitCount;
+        const uint32_t colors = ih.biClrUsed == 0 ? maxColors : std::min(ih.biClrUsed, maxColors);
+        if (headersEnd + size_t{4} * colors > size) {
+            outMessage = "BMP palette outside file";
+            return Status::ParseError;
+        }
+        format.palette.resize(colors);
+        for (uint32_t i = 0; i < colors; ++i) {
+            const uint8_t *e = bytes + headersEnd + size_t{4} * i;
+            format.palette[i] = Bgr{e[0], e[1], e[2]};
+        }
+        headersEnd += size_t{4} * colors;
+    }
 
-    size_t dataOffset = fh->bfOffBits;
-    if (dataOffset + rowStride * height > fd.bytes.size()) {
+    out.dataOffset = fh.bfOffBits;
+    const size_t pixelBytes = rle ? 0 : out.rowStride * out.height;
+    if (out.dataOffset < sizeof(fh) + sizeof(ih) || out.dataOffset > size || pixelBytes > size - out.dataOffset) {
         outMessage = "Pixel data outside file";
         return Status::ParseError;
     }
-    outImage.width = width;
-    outImage.height = height;
-    outImage.pixels.assign(width * height, Bgr{});
-
-    for (uint32_t y = 0; y < height; ++y) {
-        size_t srcY = bottomUp ? (height - 1 - y) : y;
-        const uint8_t *row = fd.bytes.data() + dataOffset + srcY * rowStride;
-        for (uint32_t x = 0; x < width; ++x) {
-            size_t idx = y * width + x;
-            outImage.pixels[idx].b = row[x * 3 + 0];
-            outImage.pixels[idx].g = row[x * 3 + 1];
-            outImage.pixels[idx].r = row[x * 3 + 2];
+    return Status::Ok;
+}
+
+// Run-length encoded 8- or 4-bit data, bottom row first. Runs past the right edge are clipped,
+// and pixels the data skips (end of line early, deltas, end of bitmap) stay black.
+static void decodeRle(const uint8_t *p, size_t n, const BmpLayout &layout, Image &out)
+{
+    const bool rle4 = layout.format.compression == BmpCompression::Rle4;
+    const uint32_t w = layout.width, h = layout.height;
+    std::array<Bgr, 256> palette{};
+    std::copy(layout.format.palette.begin(), layout.format.palette.end(), palette.begin());
+
+    uint32_t x = 0, y = 0;  // y counts rows up from the bottom
+    auto rowAt = [&]() { return &out.pixels[size_t{h - 1 - y} * w]; };
+    size_t i = 0;
+    while (i + 1 < n && y < h) {
+        const uint8_t count = p[i], value = p[i + 1];
+        i += 2;
+        if (count > 0) {
+            // A run of one index (RLE8) or of two alternating ones (RLE4).
+            const uint32_t m = x < w ? std::min<uint32_t>(count, w - x) : 0;
+            if (m > 0 && !rle4) {
+                std::fill_n(rowAt() + x, m, palette[value]);
+            } else if (m > 0) {
+                const Bgr pair[2] = {palette[value >> 4], palette[value & 15]};
+                Bgr *dst = rowAt() + x;
+                for (uint32_t k = 0; k < m; ++k) {
+                    dst[k] = pair[k & 1];
+                }
+            }
+            x += count;
+            continue;
+        }
+        if (value == 0) {  // end of line
+            x = 0;
+            ++y;
+        } else if (value == 1) {  // end of bitmap
+            break;
+        } else if (value == 2) {  // move right and up
+            if (i + 1 >= n) {
+                break;
+            }
+            x += p[i];
+            y += p[i + 1];
+            i += 2;
+        } else {  // `value` indices stored as they are, padded to 16 bits
+            const size_t bytes = rle4 ? (value + 1) / 2 : value;
+            if (i + bytes > n) {
+                break;
+            }
+            const uint32_t m = x < w ? std::min<uint32_t>(value, w - x) : 0;
+            for (uint32_t k = 0; k < m; ++k) {
+                rowAt()[x + k] = palette[rle4 ? (p[i + k / 2] >> (k & 1 ? 0 : 4)) & 15 : p[i + k]];
+            }
+            x += value;
+            i += (bytes + 1) & ~size_t{1};
+        }
+    }
+}
+
+// Pixels of a BMP in any format but 24-bit uncompressed, top row first.
+static Image decodeBmp(const uint8_t *bytes, size_t size, const BmpLayout &layout)
+{
+    Image out{layout.width, layout.height, std::vector<Bgr>(layout.width * size_t{layout.height})};
+    const BmpCompression compression = layout.format.compression;
+    if (compression == BmpCompression::Rle8 || compression == BmpCompression::Rle4) {
+        decodeRle(bytes + layout.dataOffset, size - layout.dataOffset, layout, out);
+        return out;
+    }
+    const BmpRowDecoder decoder(layout.format);
+    for (uint32_t y = 0; y < layout.height; ++y) {
+        const size_t srcY = layout.bottomUp ? layout.height - 1 - y : y;
+        decoder.decode(bytes + layout.dataOffset + srcY * layout.rowStride, layout.width,
+                       &out.pixels[size_t{y} * layout.width]);
+    }
+    return out;
+}
+
+const Bgr *ImageView::run(size_t begin, size_t m, Bgr *scratch) const
+{
+    if (m == 0) {
+        return scratch;
+    }
+    uint32_t y = static_cast<uint32_t>(begin / width);
+    size_t x = begin % width;
+    if (contiguous() || x + m <= width) {
+        return row(y) + x;
+    }
+    for (size_t done = 0; done < m; x = 0, ++y) {
+        const size_t take = std::min<size_t>(m - done, width - x);
+        std::copy_n(row(y) + x, take, scratch + done);
+        done += take;
+    }
+    return scratch;
+}
+
+Status openBmp(const std::string &path, MappedBmp &outBmp, std::string &outMessage)
+{
+    MappedFile file;
+    Status st = file.open(path, outMessage);
+    if (st != Status::Ok) {
+        return st;
+    }
+    BmpLayout layout;
+    st = parseBmp(file.data(), file.size(), layout, outMessage);
+    if (st != Status::Ok) {
+        return st;
+    }
+    if (layout.format.bitCount == 24 && layout.format.compression == BmpCompression::Rgb) {
+        const uint8_t *pixels = file.data() + layout.dataOffset;
+        const auto stride = static_cast<ptrdiff_t>(layout.rowStride);
+        outBmp.view = layout.bottomUp ? ImageView{pixels + (layout.height - 1) * layout.rowStride, layout.width,
+                                                  layout.height, -stride}
+                                      : ImageView{pixels, layout.width, layout.height, stride};
+        outBmp.decoded = Image{};
+    } else {
+        try {
+            outBmp.decoded = decodeBmp(file.data(), file.size(), layout);
+        } catch (const std::bad_alloc &) {
+            outMessage = "Out of memory decoding " + path;
+            return Status::Overflow;
+        } catch (const std::length_error &) {
+            outMessage = "Out of memory decoding " + path;
+            return Status::Overflow;
         }
+        outBmp.view = outBmp.decoded;
+    }
+    outBmp.file = std::move(file);
+    outBmp.format = std::move(layout.format);
+    CT_DEBUG("openBmp: " + path + " " + std::to_string(outBmp.format.bitCount) + "-bit compression=" +
+             std::to_string(static_cast<uint32_t>(outBmp.format.compression)) +
+             (outBmp.decoded.pixels.empty() ? " in place" : " decoded"));
+    return Status::Ok;
+}
+
+Image copyImage(const ImageView &view)
+{
+    Image out{view.width, view.height, {}};
+    out.pixels.reserve(view.size());
+    for (uint32_t y = 0; y < view.height; ++y) {
+        const Bgr *row = view.row(y);
+        out.pixels.insert(out.pixels.end(), row, row + view.width);
+    }
+    return out;
+}
+
+Status loadBmp(const std::string &path, Image &outImage, std::string &outMessage)
+{
+    MappedBmp bmp;
+    const Status st = openBmp(path, bmp, outMessage);
+    if (st != Status::Ok) {
+        return st;
     }
+    outImage = bmp.decoded.pixels.empty() ? copyImage(bmp.view) : std::move(bmp.decoded);
     return Status::Ok;
 }
 
 Status saveBmp(const std::string &path, const Image &img, std::string &outMessage)
 {
-    uint32_t width = img.width;
-    uint32_t height = img.height;
-    size_t rowStride = ((width * 3u + 3u) / 4u) * 4u;
-    size_t pixelBytes = rowStride * height;
+    return saveBmp(path, img, BmpFormat{}, outMessage);
+}
+
+Status saveBmp(const std::string &path, const Image &img, const BmpFormat &format, std::string &outMessage)
+{
+    BmpWriter writer;
+    Status st = writer.open(path, img.width, img.height, format, outMessage);
+    if (st == Status::Ok) {
+        st = writer.writeBand(img, outMessage);
+    }
+    if (st == Status::Ok) {
+        st = writer.close(outMessage);
+    }
+    return st;
+}
+
+bool collectPalette(const ImageView &img, size_t maxColors, std::vector<Bgr> &outPalette)
+{
+    std::unordered_set<uint32_t> seen;
+    for (uint32_t y = 0; y < img.height; ++y) {
+        const Bgr *row = img.row(y);
+        uint32_t last = UINT32_MAX;
+        for (uint32_t x = 0; x < img.width; ++x) {
+            const uint32_t key =
+                static_cast<uint32_t>(row[x].r) << 16 | static_cast<uint32_t>(row[x].g) << 8 | row[x].b;
+            if (key != last) {
+                seen.insert(key);
+                last = key;
+            }
+        }
+        if (seen.size() > maxColors) {
+            return false;
+        }
+    }
+    std::vector<uint32_t> keys(seen.begin(), seen.end());
+    std::sort(keys.begin(), keys.end());
+    outPalette.clear();
+    for (uint32_t key : keys) {
+        outPalette.push_back(
+            Bgr{static_cast<uint8_t>(key), static_cast<uint8_t>(key >> 8), static_cast<uint8_t>(key >> 16)});
+    }
+    return true;
+}
+
+// How `format` is written: RLE data uncompressed, and BI_BITFIELDS only for masks that an
+// uncompressed 16- or 32-bit file does not imply.
+static BmpFormat storedFormat(const BmpFormat &format)
+{
+    BmpFormat f = format;
+    f.compression = BmpCompression::Rgb;
+    if (f.bitCount == 16 || f.bitCount == 32) {
+        const bool usual = f.bitCount == 16
+                               ? f.redMask == 0x7C00 && f.greenMask == 0x03E0 && f.blueMask == 0x001F
+                               : f.redMask == 0xFF0000 && f.greenMask == 0x00FF00 && f.blueMask == 0x0000FF;
+        f.compression = usual ? BmpCompression::Rgb : BmpCompression::Bitfields;
+    } else {
+        f.redMask = f.greenMask = f.blueMask = 0;
+    }
+    if (!f.paletted()) {
+        f.palette.clear();
+    }
+    return f;
+}
+
+BmpWriter::BmpWriter() = default;
+BmpWriter::~BmpWriter() = default;
+
+Status BmpWriter::open(const std::string &filePath, uint32_t w, uint32_t h, std::string &outMessage)
+{
+    return open(filePath, w, h, BmpFormat{}, outMessage);
+}
+
+Status BmpWriter::open(const std::string &filePath,
+                       uint32_t w,
+                       uint32_t h,
+                       const BmpFormat &requested,
+                       std::string &outMessage)
+{
+    const BmpFormat format = storedFormat(requested);
+    if (!supportedFormat(format.bitCount, static_cast<uint32_t>(format.compression)) ||
+        (format.paletted() && (format.palette.empty() || format.palette.size() > (size_t{1} << format.bitCount)))) {
+        outMessage = "Cannot write a " + std::to_string(format.bitCount) + "-bit BMP with this palette: " + filePath;
+        return Status::InvalidArgument;
+    }
+    const bool bitfields = format.compression == BmpCompression::Bitfields;
+    const size_t rowStride = bmpRowBytes(w, format.bitCount);
+    const uint64_t pixelBytes = uint64_t{rowStride} * h;
     BmpFileHeader fh{};
     BmpInfoHeader ih{};
     fh.bfType = 0x4D42;
-    fh.bfOffBits = sizeof(BmpFileHeader) + sizeof(BmpInfoHeader);
-    fh.bfSize = static_cast<uint32_t>(fh.bfOffBits + pixelBytes);
+    fh.bfOffBits = static_cast<uint32_t>(sizeof(BmpFileHeader) + sizeof(BmpInfoHeader) + (bitfields ? 12 : 0) +
+                                         4 * format.palette.size());
+    // Both sizes are 32-bit; past 4 GB they are left 0, which readers accept for uncompressed data.
+    const uint64_t fileBytes = fh.bfOffBits + pixelBytes;
+    fh.bfSize = fileBytes <= UINT32_MAX ? static_cast<uint32_t>(fileBytes) : 0;
 
     ih.biSize = sizeof(BmpInfoHeader);
-    ih.biWidth = static_cast<int32_t>(width);
-    ih.biHeight = static_cast<int32_t>(height);  // bottom-up
+    ih.biWidth = static_cast<int32_t>(w);
+    ih.biHeight = static_cast<int32_t>(h);  // bottom-up
     ih.biPlanes = 1;
-    ih.biBitCount = 24;
-    ih.biCompression = 0;
-    ih.biSizeImage = static_cast<uint32_t>(pixelBytes);
-
-    std::vector<uint8_t> out;
-    out.resize(fh.bfOffBits + pixelBytes);
-    std::memcpy(out.data(), &fh, sizeof(fh));
-    std::memcpy(out.data() + sizeof(fh), &ih, sizeof(ih));
-
-    for (uint32_t y = 0; y < height; ++y) {
-        uint32_t srcY = height - 1 - y;
-        uint8_t *row = out.data() + fh.bfOffBits + y * rowStride;
-        for (uint32_t x = 0; x < width; ++x) {
-            const Bgr &p = img.pixels[srcY * width + x];
-            row[x * 3 + 0] = p.b;
-            row[x * 3 + 1] = p.g;
-            row[x * 3 + 2] = p.r;
-        }
-        for (size_t pad = width * 3; pad < rowStride; ++pad) {
-            row[pad] = 0;
+    ih.biBitCount = format.bitCount;
+    ih.biCompression = static_cast<uint32_t>(format.compression);
+    ih.biSizeImage = pixelBytes <= UINT32_MAX ? static_cast<uint32_t>(pixelBytes) : 0;
+    ih.biClrUsed = static_cast<uint32_t>(format.palette.size());
+
+    file.open(filePath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        outMessage = "Failed to open for write: " + filePath;
+        return Status::IoError;
+    }
+    file.write(reinterpret_cast<const char *>(&fh), sizeof(fh));
+    file.write(reinterpret_cast<const char *>(&ih), sizeof(ih));
+    if (bitfields) {
+        const uint32_t masks[3] = {format.redMask, format.greenMask, format.blueMask};
+        file.write(reinterpret_cast<const char *>(masks), sizeof(masks));
+    }
+    for (const Bgr &c : format.palette) {
+        const uint8_t entry[4] = {c.b, c.g, c.r, 0};
+        file.write(reinterpret_cast<const char *>(entry), sizeof(entry));
+    }
+    path = filePath;
+    width = w;
+    rowsLeft = h;
+    row.assign(rowStride, 0);
+    encoder = format.bitCount == 24 ? nullptr : std::make_unique<BmpRowEncoder>(format);
+    return Status::Ok;
+}
+
+Status BmpWriter::writeBand(const ImageView &band, std::string &outMessage)
+{
+    if (band.width != width || band.height > rowsLeft) {
+        outMessage = "Band does not fit the image: " + path;
+        return Status::InvalidArgument;
+    }
+    for (uint32_t y = band.height; y-- > 0;) {
+        if (encoder) {
+            encoder->encode(band.row(y), width, row.data());
+        } else {
+            std::memcpy(row.data(), band.row(y), size_t{width} * 3);
         }
+        file.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+    rowsLeft -= band.height;
+    if (!file.good()) {
+        outMessage = "Write failed: " + path;
+        return Status::IoError;
     }
+    return Status::Ok;
+}
 
-    return writeFile(path, out, outMessage);
+Status BmpWriter::close(std::string &outMessage)
+{
+    file.close();
+    if (rowsLeft != 0) {
+        outMessage = "Image incomplete: " + path;
+        return Status::IoError;
+    }
+    if (file.fail()) {
+        outMessage = "Write failed: " + path;
+        return Status::IoError;
+    }
+    return Status::Ok;
 }
 
 }  // namespace ct
@@ -0,0 +1,181 @@
+#include "bmp_rows.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CT_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ct
+{
+
+bool validBmpMask(uint32_t mask)
+{
+    if (mask == 0) {
+        return true;
+    }
+    const uint32_t field = mask >> __builtin_ctz(mask);
+    return (field & (field + 1)) == 0;
+}
+
+BmpChannel::BmpChannel(uint32_t m) : mask(m)
+{
+    if (mask == 0) {
+        toByte.assign(1, 0);
+        return;
+    }
+    shift = __builtin_ctz(mask);
+    max = mask >> shift;
+    if (max <= 0xFFFF) {
+        toByte.resize(size_t{max} + 1);
+        for (uint32_t v = 0; v <= max; ++v) {
+            toByte[v] = static_cast<uint8_t>((v * 255 + max / 2) / max);
+        }
+    }
+}
+
+static inline uint32_t readPixel(const uint8_t *p, uint16_t bits)
+{
+    if (bits == 16) {
+        uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void writePixel(uint8_t *p, uint16_t bits, uint32_t v)
+{
+    if (bits == 16) {
+        const uint16_t v16 = static_cast<uint16_t>(v);
+        std::memcpy(p, &v16, sizeof(v16));
+    } else {
+        std::memcpy(p, &v, sizeof(v));
+    }
+}
+
+#ifdef CT_SIMD_X86
+// BGRX to BGR four pixels at a time; returns how many pixels were done. Each store writes 16 bytes
+// for 12 bytes of pixels, so the loop stops while a whole store still fits in the row; the next
+// store or the scalar tail overwrites the extra bytes.
+__attribute__((target("ssse3"))) static uint32_t bgrxToBgrSsse3(const uint8_t *src, uint32_t width, Bgr *out)
+{
+    const __m128i drop = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    uint8_t *dst = reinterpret_cast<uint8_t *>(out);
+    uint32_t x = 0;
+    for (; x + 6 <= width; x += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + size_t{4} * x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + size_t{3} * x), _mm_shuffle_epi8(v, drop));
+    }
+    return x;
+}
+
+static bool haveSsse3()
+{
+    static const bool have = __builtin_cpu_supports("ssse3");
+    return have;
+}
+#endif
+
+BmpRowDecoder::BmpRowDecoder(const BmpFormat &format) : bits(format.bitCount)
+{
+    if (format.paletted()) {
+        // The pixels of every byte value, most significant bits first.
+        const uint32_t perByte = 8 / bits;
+        const uint32_t indexMask = (1u << bits) - 1;
+        expand.resize(256 * perByte);
+        for (uint32_t v = 0; v < 256; ++v) {
+            for (uint32_t k = 0; k < perByte; ++k) {
+                const uint32_t i = (v >> (8 - bits * (k + 1))) & indexMask;
+                expand[v * perByte + k] = i < format.palette.size() ? format.palette[i] : Bgr{};
+            }
+        }
+        return;
+    }
+    bgrx = bits == 32 && format.redMask == 0xFF0000 && format.greenMask == 0xFF00 && format.blueMask == 0xFF;
+    channels = {BmpChannel(format.redMask), BmpChannel(format.greenMask), BmpChannel(format.blueMask)};
+}
+
+void BmpRowDecoder::decode(const uint8_t *src, uint32_t width, Bgr *out) const
+{
+    if (bits <= 8) {
+        const uint32_t perByte = 8 / bits;
+        const uint32_t whole = width / perByte;
+        for (uint32_t i = 0; i < whole; ++i) {
+            std::memcpy(out + size_t{i} * perByte, &expand[size_t{src[i]} * perByte], perByte * sizeof(Bgr));
+        }
+        const uint32_t rest = width - whole * perByte;
+        if (rest) {
+            std::memcpy(out + size_t{whole} * perByte, &expand[size_t{src[whole]} * perByte], rest * sizeof(Bgr));
+        }
+        return;
+    }
+
+    if (bits == 24) {
+        std::memcpy(out, src, size_t{width} * sizeof(Bgr));
+        return;
+    }
+    uint32_t x = 0;
+    if (bgrx) {
+#ifdef CT_SIMD_X86
+        if (haveSsse3()) {
+            x = bgrxToBgrSsse3(src, width, out);
+        }
+#endif
+        for (; x < width; ++x) {
+            out[x] = Bgr{src[4 * x], src[4 * x + 1], src[4 * x + 2]};
+        }
+        return;
+    }
+    const size_t step = bits / 8;
+    for (; x < width; ++x) {
+        const uint32_t v = readPixel(src + x * step, bits);
+        out[x] = Bgr{channels[2].decode(v), channels[1].decode(v), channels[0].decode(v)};
+    }
+}
+
+static inline uint32_t paletteKey(const Bgr &p)
+{
+    return static_cast<uint32_t>(p.r) << 16 | static_cast<uint32_t>(p.g) << 8 | p.b;
+}
+
+BmpRowEncoder::BmpRowEncoder(const BmpFormat &format) : bits(format.bitCount)
+{
+    if (format.paletted()) {
+        for (size_t i = format.palette.size(); i-- > 0;) {
+            index[paletteKey(format.palette[i])] = static_cast<uint8_t>(i);
+        }
+        return;
+    }
+    channels = {BmpChannel(format.redMask), BmpChannel(format.greenMask), BmpChannel(format.blueMask)};
+    const uint32_t all = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    fill = all & ~(format.redMask | format.greenMask | format.blueMask);
+}
+
+void BmpRowEncoder::encode(const Bgr *in, uint32_t width, uint8_t *dst) const
+{
+    if (bits <= 8) {
+        const uint32_t perByte = 8 / bits;
+        std::memset(dst, 0, (size_t{width} * bits + 7) / 8);
+        for (uint32_t x = 0; x < width; ++x) {
+            const auto it = index.find(paletteKey(in[x]));
+            const uint32_t i = it == index.end() ? 0 : it->second;
+            dst[x / perByte] |= static_cast<uint8_t>(i << (8 - bits * (x % perByte + 1)));
+        }
+        return;
+    }
+    if (bits == 24) {
+        std::memcpy(dst, in, size_t{width} * sizeof(Bgr));
+        return;
+    }
+    const size_t step = bits / 8;
+    for (uint32_t x = 0; x < width; ++x) {
+        const uint32_t v =
+            fill | channels[0].encode(in[x].r) | channels[1].encode(in[x].g) | channels[2].encode(in[x].b);
+        writePixel(dst + x * step, bits, v);
+    }
+}
+
+}  // namespace ct
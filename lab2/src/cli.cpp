@@ -1,4 +1,5 @@
 #include "cli.h"
+#include "lab_lut.h"
 #include <cstdio>
 #include <cstdlib>
 
@@ -52,12 +53,26 @@ void printUsage()
 {
     std::printf("Usage:\n");
     std::printf("  color_transfer <source.bmp> <target.bmp> <out_prefix> [labMask]\n");
+    std::printf("  color_transfer precompute <cache_dir> <source.bmp>... [--lut N] [--no-memo] [--simd]\n");
     std::printf("  Optional brushes and options:\n");
     std::printf("    --rect  x y w h         (add rectangular brush)\n");
     std::printf("    --circle cx cy r        (add circular brush)\n");
     std::printf("    --mode  mask|blend      (how to apply inside region; default mask)\n");
     std::printf("    --alpha A               (0..1, for blend mode; default 1.0)\n");
     std::printf("    --save-mask path.bmp    (save region mask as BMP)\n");
+    std::printf("    --lut N                 (table-driven Lab conversions on an N^3 grid, 2..%d; %d is a good\n"
+                "                             trade-off; default exact)\n",
+                LAB_LUT_MAX_GRID, LAB_LUT_DEFAULT_GRID);
+    std::printf("    --no-memo               (convert every pixel even when colours repeat)\n");
+    std::printf("    --simd                  (single-precision SIMD kernels instead of the exact conversions; faster,\n"
+                "                             but a few colours may come out one level off)\n");
+    std::printf("    --threads N             (worker threads for stats and transfer; default one per core)\n");
+    std::printf("    --stream-rows N         (transfer and write the result N rows at a time, for images larger\n"
+                "                             than memory; 24-bit uncompressed BMPs only)\n");
+    std::printf("    --keep-depth            (write the result with the target's bit depth and colour masks;\n"
+                "                             paletted targets keep it only while the colours fit)\n");
+    std::printf("    --stats-cache dir       (reuse source stats stored in dir, keyed by file contents and the\n"
+                "                             conversion options; fill it with precompute)\n");
     std::printf("\nExamples:\n");
     std::printf("  color_transfer a.bmp b.bmp out 111 --rect 10 10 60 40 --circle 100 70 25 --mode blend --alpha 0.6 "
                 "--save-mask out_mask.bmp\n");
@@ -72,12 +87,25 @@ Result<CliOptions> parseCli(int argc, char **argv)
         return r;
     }
     CliOptions opt;
-    opt.srcPath = argv[1];
-    opt.tgtPath = argv[2];
-    opt.outPrefix = argv[3];
-    opt.labMask = parseLabMask(argc >= 5 ? argv[4] : nullptr);
-
     int i = 5;
+    if (std::string(argv[1]) == "precompute") {
+        opt.command = CliCommand::Precompute;
+        opt.statsCacheDir = argv[2];
+        for (i = 3; i < argc && std::string(argv[i]).rfind("--", 0) != 0; ++i) {
+            opt.sources.push_back(argv[i]);
+        }
+        if (opt.sources.empty()) {
+            r.status = Status::InvalidArgument;
+            r.message = "precompute needs at least one source";
+            return r;
+        }
+    } else {
+        opt.srcPath = argv[1];
+        opt.tgtPath = argv[2];
+        opt.outPrefix = argv[3];
+        opt.labMask = parseLabMask(argc >= 5 ? argv[4] : nullptr);
+    }
+
     while (i < argc) {
         std::string a = argv[i];
 
@@ -161,6 +189,79 @@ Result<CliOptions> parseCli(int argc, char **argv)
             i += 2;
             continue;
         }
+        if (a == "--lut") {
+            if (i + 1 >= argc) {
+                r.status = Status::InvalidArgument;
+                r.message = "--lut needs grid size";
+                return r;
+            }
+            int n = 0;
+            if (!parseInt(argv[i + 1], n) || n < 2 || n > LAB_LUT_MAX_GRID) {
+                r.status = Status::InvalidArgument;
+                r.message = "LUT grid size must be 2.." + std::to_string(LAB_LUT_MAX_GRID);
+                return r;
+            }
+            opt.lutGrid = n;
+            i += 2;
+            continue;
+        }
+        if (a == "--no-memo") {
+            opt.memoColors = false;
+            i += 1;
+            continue;
+        }
+        if (a == "--simd") {
+            opt.simd = true;
+            i += 1;
+            continue;
+        }
+        if (a == "--threads") {
+            if (i + 1 >= argc) {
+                r.status = Status::InvalidArgument;
+                r.message = "--threads needs count";
+                return r;
+            }
+            int n = 0;
+            if (!parseInt(argv[i + 1], n) || n < 1) {
+                r.status = Status::InvalidArgument;
+                r.message = "thread count must be at least 1";
+                return r;
+            }
+            opt.threads = n;
+            i += 2;
+            continue;
+        }
+        if (a == "--stream-rows") {
+            if (i + 1 >= argc) {
+                r.status = Status::InvalidArgument;
+                r.message = "--stream-rows needs count";
+                return r;
+            }
+            int n = 0;
+            if (!parseInt(argv[i + 1], n) || n < 1) {
+                r.status = Status::InvalidArgument;
+                r.message = "rows per band must be at least 1";
+                return r;
+            }
+            opt.streamRows = n;
+            i += 2;
+            continue;
+        }
+        if (a == "--keep-depth") {
+            opt.keepDepth = true;
+            i += 1;
+            continue;
+        }
+        if (a == "--stats-cache") {
+            if (i + 1 >= argc) {
+                r.status = Status::InvalidArgument;
+                r.message = "--stats-cache needs directory";
+                return r;
+            }
+            opt.statsCacheDir = argv[i + 1];
+            i += 2;
+            continue;
+        }
 
         r.status = Status::InvalidArgument;
         r.message = "Unknown argument: " + a;
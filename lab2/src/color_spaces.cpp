@@ -6,9 +6,6 @@
 namespace ct
 {
 
-static constexpr double MIN_VAL = 3.0 / 255.0;           // 0.01176 to avoid log(0)
-static constexpr double WHITE_COMPRESS = 235.0 / 255.0;  // 0.92157
-
 RgbNorm toRgbNorm(const Bgr &p, bool compressWhite)
 {
     auto scale = compressWhite ? WHITE_COMPRESS : 1.0;
@@ -31,18 +28,24 @@ Bgr fromRgbNorm(const RgbNorm &rn, bool expandWhite)
 }
 
 // RGB->LMS using matrix from lab
-Vec3d rgbToLms(const RgbNorm &rn)
+Vec3d rgbToLinearLms(const RgbNorm &rn)
 {
     double L = 0.3811 * rn.r + 0.5783 * rn.g + 0.0402 * rn.b;
     double M = 0.1967 * rn.r + 0.7244 * rn.g + 0.0782 * rn.b;
     double S = 0.0241 * rn.r + 0.1288 * rn.g + 0.8444 * rn.b;
-    // log10
-    L = std::log10(std::max(MIN_VAL, L));
-    M = std::log10(std::max(MIN_VAL, M));
-    S = std::log10(std::max(MIN_VAL, S));
     return Vec3d{L, M, S};
 }
 
+Vec3d rgbToLms(const RgbNorm &rn)
+{
+    Vec3d lms = rgbToLinearLms(rn);
+    // log10
+    lms.x = std::log10(std::max(MIN_VAL, lms.x));
+    lms.y = std::log10(std::max(MIN_VAL, lms.y));
+    lms.z = std::log10(std::max(MIN_VAL, lms.z));
+    return lms;
+}
+
 Vec3d lmsToLab(const Vec3d &lms)
 {
     // Multiply by matrix:
@@ -71,17 +74,19 @@ Vec3d labToLms(const Vec3d &lab)
     return Vec3d{logL, logM, logS};
 }
 
+// LMS->RGB using matrix from lab
+RgbNorm linearLmsToRgb(const Vec3d &lms)
+{
+    double r = 4.4679 * lms.x - 3.5873 * lms.y + 0.1193 * lms.z;
+    double g = -1.2186 * lms.x + 2.3809 * lms.y - 0.1624 * lms.z;
+    double b = 0.0497 * lms.x - 0.2439 * lms.y + 1.2045 * lms.z;
+    return RgbNorm{r, g, b};
+}
+
 RgbNorm lmsToRgb(const Vec3d &lmsLog)
 {
     // 10^log10 -> LMS
-    double L = std::pow(10.0, lmsLog.x);
-    double M = std::pow(10.0, lmsLog.y);
-    double S = std::pow(10.0, lmsLog.z);
-    // LMS->RGB using matrix from lab
-    double r = 4.4679 * L - 3.5873 * M + 0.1193 * S;
-    double g = -1.2186 * L + 2.3809 * M - 0.1624 * S;
-    double b = 0.0497 * L - 0.2439 * M + 1.2045 * S;
-    return RgbNorm{r, g, b};
+    return linearLmsToRgb(Vec3d{std::pow(10.0, lmsLog.x), std::pow(10.0, lmsLog.y), std::pow(10.0, lmsLog.z)});
 }
 
 Vec3d rgbToLab(const Bgr &p, bool compressWhite)
@@ -0,0 +1,49 @@
+#include "color_table.h"
+#include "utils.h"
+
+namespace ct
+{
+
+static constexpr size_t KEY_COUNT = size_t{1} << 24;
+
+ColorTable buildColorTable(const ImageView &img)
+{
+    ColorTable t;
+    t.pixels = img.size();
+    t.present.assign(KEY_COUNT / 64, 0);
+    for (uint32_t y = 0; y < img.height; ++y) {
+        const Bgr *row = img.row(y);
+        for (uint32_t x = 0; x < img.width; ++x) {
+            const uint32_t key = ColorTable::keyOf(row[x]);
+            t.present[key >> 6] |= uint64_t{1} << (key & 63);
+        }
+    }
+
+    t.rank.resize(t.present.size());
+    uint32_t unique = 0;
+    for (size_t w = 0; w < t.present.size(); ++w) {
+        t.rank[w] = unique;
+        unique += static_cast<uint32_t>(__builtin_popcountll(t.present[w]));
+    }
+
+    t.colors.reserve(unique);
+    for (size_t w = 0; w < t.present.size(); ++w) {
+        for (uint64_t bits = t.present[w]; bits; bits &= bits - 1) {
+            const uint32_t key = static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits));
+            t.colors.push_back(Bgr{static_cast<uint8_t>(key), static_cast<uint8_t>(key >> 8),
+                                   static_cast<uint8_t>(key >> 16)});
+        }
+    }
+
+    t.counts.assign(unique, 0);
+    for (uint32_t y = 0; y < img.height; ++y) {
+        const Bgr *row = img.row(y);
+        for (uint32_t x = 0; x < img.width; ++x) {
+            t.counts[t.indexOf(row[x])]++;
+        }
+    }
+    CT_DEBUG("buildColorTable: pixels=" + std::to_string(t.pixels) + " unique=" + std::to_string(unique));
+    return t;
+}
+
+}  // namespace ct
@@ -0,0 +1,57 @@
+#include "color_spaces.h"
+#include "color_table.h"
+#include "color_transfer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace ct;
+
+// Builds a colour table for an image with more than 2^32 pixels of one colour and checks the
+// counts and the memoised statistics against the exact ones. The image is a single row repeated
+// (row stride 0), so it needs no memory, but the table still visits every pixel twice: build it
+// with optimisation.
+
+static constexpr uint32_t WIDTH = 65536;
+static constexpr uint32_t HEIGHT = 65538;
+
+static bool near(double got, double want)
+{
+    return std::abs(got - want) <= 1e-9 * std::max(1.0, std::abs(want));
+}
+
+int main()
+{
+    // Every row is WIDTH - 1 pixels of `a` and one of `b`, so `a` covers more than UINT32_MAX pixels.
+    const Bgr a{40, 120, 200}, b{230, 30, 10};
+    std::vector<Bgr> row(WIDTH, a);
+    row.back() = b;
+    const ImageView img(reinterpret_cast<const uint8_t *>(row.data()), WIDTH, HEIGHT, 0);
+    const uint64_t na = uint64_t{WIDTH - 1} * HEIGHT, nb = HEIGHT;
+
+    const ColorTable table = buildColorTable(img);
+    // Ascending key order: b (key 0x0a1ee6) before a (key 0xc87828).
+    if (table.colors.size() != 2 || table.counts[0] != nb || table.counts[1] != na || table.pixels != na + nb) {
+        std::fprintf(stderr, "counts: got %zu colours, %llu / %llu, want %llu / %llu\n", table.colors.size(),
+                     table.counts.empty() ? 0ull : static_cast<unsigned long long>(table.counts[0]),
+                     table.counts.size() < 2 ? 0ull : static_cast<unsigned long long>(table.counts[1]),
+                     static_cast<unsigned long long>(nb), static_cast<unsigned long long>(na));
+        return 1;
+    }
+
+    // Two colours with shares pa and pb: mean pa*A + pb*B, variance pa*pb*(A - B)^2.
+    const Vec3d la = rgbToLab(a, true), lb = rgbToLab(b, true);
+    const double pa = static_cast<double>(na) / static_cast<double>(na + nb), pb = 1.0 - pa;
+    const Vec3d mean{pa * la.x + pb * lb.x, pa * la.y + pb * lb.y, pa * la.z + pb * lb.z};
+    const Vec3d var{pa * pb * (la.x - lb.x) * (la.x - lb.x), pa * pb * (la.y - lb.y) * (la.y - lb.y),
+                    pa * pb * (la.z - lb.z) * (la.z - lb.z)};
+    const Stats s = computeLabStats(table);
+    const bool ok = near(s.mean.x, mean.x) && near(s.mean.y, mean.y) && near(s.mean.z, mean.z) &&
+                    near(s.var.x, var.x) && near(s.var.y, var.y) && near(s.var.z, var.z);
+    std::printf("pixels %llu, mean %.9f %.9f %.9f, var %.9f %.9f %.9f %s\n",
+                static_cast<unsigned long long>(table.pixels), s.mean.x, s.mean.y, s.mean.z, s.var.x, s.var.y,
+                s.var.z, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
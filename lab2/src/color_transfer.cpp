@@ -1,6 +1,9 @@
 #include "color_transfer.h"
+#include "lab_simd.h"
 #include "utils.h"
+#include <algorithm>
 #include <cmath>
+#include <functional>
 #include <numeric>
 
 namespace ct
@@ -11,52 +14,203 @@ static std::string vecToStr(const Vec3d &v)
     return "(" + std::to_string(v.x) + "," + std::to_string(v.y) + "," + std::to_string(v.z) + ")";
 }
 
-static void accumulateLab(const Image &img, Vec3d &sum, Vec3d &sumSq)
+// Pixels handed to the batch kernels at a time.
+static constexpr size_t LAB_BATCH = 1024;
+// Pixels per parallel chunk. Fixed, so that results do not depend on the thread count.
+static constexpr size_t LAB_CHUNK = 64 * LAB_BATCH;
+
+static inline Vec3d toLab(const Bgr &p, const LabLut *lut)
 {
-    sum = {0, 0, 0};
-    sumSq = {0, 0, 0};
     const bool compress = true;
-    for (const auto &p : img.pixels) {
-        Vec3d lab = rgbToLab(p, compress);
-        sum.x += lab.x;
-        sum.y += lab.y;
-        sum.z += lab.z;
-        sumSq.x += lab.x * lab.x;
-        sumSq.y += lab.y * lab.y;
-        sumSq.z += lab.z * lab.z;
+    return lut ? rgbToLabLut(*lut, p) : rgbToLab(p, compress);
+}
+
+// Weight, mean and sum of squared deviations per channel. Each batch is reduced in two passes and
+// batches and chunks are combined with Chan et al.'s pairwise update, so the variance does not
+// come from sumSq / n - mean^2, which cancels badly on large images.
+struct LabMoments {
+    double n{0};
+    Vec3d mean{0, 0, 0};
+    Vec3d m2{0, 0, 0};
+};
+
+static void mergeMoments(LabMoments &into, const LabMoments &other)
+{
+    if (other.n == 0) {
+        return;
+    }
+    if (into.n == 0) {
+        into = other;
+        return;
     }
-    CT_DEBUG("accumulateLab: sum=" + vecToStr(sum) + " sumSq=" + vecToStr(sumSq) +
-             " n=" + std::to_string(img.pixels.size()));
+    const double n = into.n + other.n;
+    const double f = other.n / n;
+    const double g = into.n * other.n / n;
+    auto merge = [f, g](double &mean, double &m2, double otherMean, double otherM2) {
+        const double d = otherMean - mean;
+        mean += d * f;
+        m2 += otherM2 + d * d * g;
+    };
+    merge(into.mean.x, into.m2.x, other.mean.x, other.m2.x);
+    merge(into.mean.y, into.m2.y, other.mean.y, other.m2.y);
+    merge(into.mean.z, into.m2.z, other.mean.z, other.m2.z);
+    into.n = n;
 }
 
-static Vec3d finalizeMean(size_t n, const Vec3d &sum)
+// Moments of m Lab values, each weighted by its count (1 when `counts` is null).
+template<typename T>
+static LabMoments batchMoments(const T *x, const T *y, const T *z, const uint64_t *counts, size_t m)
 {
-    Vec3d m{sum.x / n, sum.y / n, sum.z / n};
-    CT_DEBUG("finalizeMean: n=" + std::to_string(n) + " mean=" + vecToStr(m));
-    return m;
+    LabMoments r;
+    Vec3d sum;
+    for (size_t j = 0; j < m; ++j) {
+        const double w = counts ? static_cast<double>(counts[j]) : 1.0;
+        r.n += w;
+        sum.x += w * x[j];
+        sum.y += w * y[j];
+        sum.z += w * z[j];
+    }
+    if (r.n == 0) {
+        return r;
+    }
+    r.mean = Vec3d{sum.x / r.n, sum.y / r.n, sum.z / r.n};
+    for (size_t j = 0; j < m; ++j) {
+        const double w = counts ? static_cast<double>(counts[j]) : 1.0;
+        const double dx = x[j] - r.mean.x, dy = y[j] - r.mean.y, dz = z[j] - r.mean.z;
+        r.m2.x += w * dx * dx;
+        r.m2.y += w * dy * dy;
+        r.m2.z += w * dz * dz;
+    }
+    return r;
 }
 
-static Vec3d finalizeVar(size_t n, const Vec3d &sum, const Vec3d &sumSq)
+// Moments of the colours in range r, one batch at a time; with `simd` and no LUT through the batch
+// kernels.
+static LabMoments rangeMoments(const ImageView &img,
+                               const uint64_t *counts,
+                               const Range &r,
+                               const LabLut *lut,
+                               bool simd)
 {
-    Vec3d mean = finalizeMean(n, sum);
-    Vec3d v{sumSq.x / n - mean.x * mean.x, sumSq.y / n - mean.y * mean.y, sumSq.z / n - mean.z * mean.z};
-    CT_DEBUG("finalizeVar: var=" + vecToStr(v));
-    return v;
+    LabMoments acc;
+    std::array<float, LAB_BATCH> fl, fa, fb;
+    std::array<double, LAB_BATCH> dl, da, db;
+    std::array<Bgr, LAB_BATCH> scratch;
+    for (size_t begin = r.begin; begin < r.end; begin += LAB_BATCH) {
+        const size_t m = std::min(LAB_BATCH, r.end - begin);
+        const uint64_t *w = counts ? counts + begin : nullptr;
+        const Bgr *px = img.run(begin, m, scratch.data());
+        if (simd && !lut) {
+            rgbToLabBatch(px, m, fl.data(), fa.data(), fb.data());
+            mergeMoments(acc, batchMoments(fl.data(), fa.data(), fb.data(), w, m));
+        } else {
+            for (size_t j = 0; j < m; ++j) {
+                const Vec3d lab = toLab(px[j], lut);
+                dl[j] = lab.x;
+                da[j] = lab.y;
+                db[j] = lab.z;
+            }
+            mergeMoments(acc, batchMoments(dl.data(), da.data(), db.data(), w, m));
+        }
+    }
+    return acc;
 }
 
-Stats computeLabStats(const Image &img)
+// Chunks of n values go to the pool; their moments are merged in chunk order.
+static LabMoments reduceChunks(size_t n, ThreadPool *pool, const std::function<LabMoments(const Range &)> &chunkMoments)
+{
+    const std::vector<Range> chunks = makeChunks(n, LAB_CHUNK);
+    std::vector<LabMoments> parts(chunks.size());
+    runChunks(pool, chunks, [&](size_t i, const Range &r) { parts[i] = chunkMoments(r); });
+    LabMoments total;
+    for (const auto &part : parts) {
+        mergeMoments(total, part);
+    }
+    CT_DEBUG("accumulateLab: n=" + std::to_string(total.n) + " mean=" + vecToStr(total.mean) +
+             " m2=" + vecToStr(total.m2) + " chunks=" + std::to_string(chunks.size()));
+    return total;
+}
+
+static LabMoments accumulateLab(const ImageView &img,
+                                const uint64_t *counts,
+                                const LabLut *lut,
+                                bool simd,
+                                ThreadPool *pool)
+{
+    return reduceChunks(img.size(), pool, [&](const Range &r) { return rangeMoments(img, counts, r, lut, simd); });
+}
+
+static Stats finalizeStats(const LabMoments &m)
 {
-    CT_DEBUG("computeLabStats: begin (w=" + std::to_string(img.width) + ", h=" + std::to_string(img.height) +
-             ", n=" + std::to_string(img.pixels.size()) + ")");
-    Vec3d sum, sumSq;
-    accumulateLab(img, sum, sumSq);
     Stats s;
-    s.mean = finalizeMean(img.pixels.size(), sum);
-    s.var = finalizeVar(img.pixels.size(), sum, sumSq);
+    if (m.n > 0) {
+        s.mean = m.mean;
+        s.var = Vec3d{m.m2.x / m.n, m.m2.y / m.n, m.m2.z / m.n};
+    }
     CT_DEBUG("computeLabStats: mean=" + vecToStr(s.mean) + " var=" + vecToStr(s.var));
     return s;
 }
 
+Stats computeLabStats(const ImageView &img, const LabLut *lut, bool simd, ThreadPool *pool)
+{
+    CT_DEBUG("computeLabStats: begin (w=" + std::to_string(img.width) + ", h=" + std::to_string(img.height) +
+             ", n=" + std::to_string(img.size()) + ")");
+    return finalizeStats(accumulateLab(img, nullptr, lut, simd, pool));
+}
+
+Stats computeLabStats(const ColorTable &colors, const LabLut *lut, bool simd, ThreadPool *pool)
+{
+    CT_DEBUG("computeLabStats: begin (n=" + std::to_string(colors.pixels) +
+             ", unique=" + std::to_string(colors.colors.size()) + ")");
+    // The distinct colours, as a one-row image.
+    const auto unique = static_cast<uint32_t>(colors.colors.size());
+    const ImageView row(reinterpret_cast<const uint8_t *>(colors.colors.data()), unique, 1,
+                        3 * static_cast<ptrdiff_t>(unique));
+    return finalizeStats(accumulateLab(row, colors.counts.data(), lut, simd, pool));
+}
+
+PlanarF64 computeLabPlanes(const ImageView &img, const LabLut *lut, bool simd, ThreadPool *pool)
+{
+    PlanarF64 lab(img.width, img.height);
+    double *l = lab.plane(0), *a = lab.plane(1), *b = lab.plane(2);
+    runChunks(pool, makeChunks(lab.planeSize(), LAB_CHUNK), [&](size_t, const Range &r) {
+        std::array<float, LAB_BATCH> fl, fa, fb;
+        std::array<Bgr, LAB_BATCH> scratch;
+        for (size_t begin = r.begin; begin < r.end; begin += LAB_BATCH) {
+            const size_t m = std::min(LAB_BATCH, r.end - begin);
+            const Bgr *px = img.run(begin, m, scratch.data());
+            if (simd && !lut) {
+                rgbToLabBatch(px, m, fl.data(), fa.data(), fb.data());
+                std::copy(fl.begin(), fl.begin() + m, l + begin);
+                std::copy(fa.begin(), fa.begin() + m, a + begin);
+                std::copy(fb.begin(), fb.begin() + m, b + begin);
+                continue;
+            }
+            for (size_t j = 0; j < m; ++j) {
+                const Vec3d v = toLab(px[j], lut);
+                l[begin + j] = v.x;
+                a[begin + j] = v.y;
+                b[begin + j] = v.z;
+            }
+        }
+    });
+    CT_DEBUG("computeLabPlanes: n=" + std::to_string(lab.planeSize()));
+    return lab;
+}
+
+Stats computeLabStats(const PlanarF64 &lab, ThreadPool *pool)
+{
+    const double *l = lab.plane(0), *a = lab.plane(1), *b = lab.plane(2);
+    return finalizeStats(reduceChunks(lab.planeSize(), pool, [&](const Range &r) {
+        LabMoments acc;
+        for (size_t begin = r.begin; begin < r.end; begin += LAB_BATCH) {
+            const size_t m = std::min(LAB_BATCH, r.end - begin);
+            mergeMoments(acc, batchMoments(l + begin, a + begin, b + begin, nullptr, m));
+        }
+        return acc;
+    }));
+}
+
 static inline double safeStd(double v)
 {
     return std::sqrt(v < 1e-12 ? 1e-12 : v);
@@ -90,28 +244,171 @@ static inline Bgr blendRgb(const Bgr &a, const Bgr &b, double alpha)
     return Bgr{b8, g, r};
 }
 
-static Bgr transferOne(const Bgr &in, const Stats &srcStats, const Stats &tgtStats, const std::array<bool, 3> &mask)
+static Bgr transferOne(const Bgr &in,
+                       const Stats &srcStats,
+                       const Stats &tgtStats,
+                       const std::array<bool, 3> &mask,
+                       const LabLut *lut)
 {
-    const bool compress = true;
     const bool expand = true;
-    Vec3d lab = rgbToLab(in, compress);
-    auto safeStd = [](double v) { return std::sqrt(v < 1e-12 ? 1e-12 : v); };
-    Vec3d outLab = lab;
-    double srcStd0 = safeStd(srcStats.var.x), srcStd1 = safeStd(srcStats.var.y), srcStd2 = safeStd(srcStats.var.z);
-    double tgtStd0 = safeStd(tgtStats.var.x), tgtStd1 = safeStd(tgtStats.var.y), tgtStd2 = safeStd(tgtStats.var.z);
-    if (mask[0]) {
-        outLab.x = (lab.x - tgtStats.mean.x) * (srcStd0 / tgtStd0) + srcStats.mean.x;
+    const Vec3d outLab = transferPixelLab(toLab(in, lut), srcStats, tgtStats, mask);
+    return lut ? labToRgbLut(*lut, outLab) : labToRgb(outLab, expand);
+}
+
+// Transfers up to LAB_BATCH Lab values (overwritten) in float and converts them back to colours
+// with the batch kernels.
+static void transferLabBatched(float *l,
+                               float *a,
+                               float *b,
+                               size_t m,
+                               Bgr *out,
+                               const Stats &srcStats,
+                               const Stats &tgtStats,
+                               const std::array<bool, 3> &mask)
+{
+    // (lab - tgtMean) * ratio + srcMean, folded into lab * scale + shift per channel.
+    const double ratio[3] = {safeStd(srcStats.var.x) / safeStd(tgtStats.var.x),
+                             safeStd(srcStats.var.y) / safeStd(tgtStats.var.y),
+                             safeStd(srcStats.var.z) / safeStd(tgtStats.var.z)};
+    const double srcMean[3] = {srcStats.mean.x, srcStats.mean.y, srcStats.mean.z};
+    const double tgtMean[3] = {tgtStats.mean.x, tgtStats.mean.y, tgtStats.mean.z};
+    float scale[3], shift[3];
+    for (int c = 0; c < 3; ++c) {
+        scale[c] = mask[c] ? static_cast<float>(ratio[c]) : 1.0f;
+        shift[c] = mask[c] ? static_cast<float>(srcMean[c] - tgtMean[c] * ratio[c]) : 0.0f;
     }
-    if (mask[1]) {
-        outLab.y = (lab.y - tgtStats.mean.y) * (srcStd1 / tgtStd1) + srcStats.mean.y;
+    for (size_t j = 0; j < m; ++j) {
+        l[j] = l[j] * scale[0] + shift[0];
+        a[j] = a[j] * scale[1] + shift[1];
+        b[j] = b[j] * scale[2] + shift[2];
     }
-    if (mask[2]) {
-        outLab.z = (lab.z - tgtStats.mean.z) * (srcStd2 / tgtStd2) + srcStats.mean.z;
+    labToRgbBatch(l, a, b, m, out);
+}
+
+// transferOne over n pixels; with `simd` and no LUT the batch kernels do it in float.
+static void transferRun(const Bgr *in,
+                        size_t n,
+                        Bgr *out,
+                        const Stats &srcStats,
+                        const Stats &tgtStats,
+                        const std::array<bool, 3> &mask,
+                        const LabLut *lut,
+                        bool simd)
+{
+    if (lut || !simd) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = transferOne(in[i], srcStats, tgtStats, mask, lut);
+        }
+        return;
     }
-    return labToRgb(outLab, expand);
+
+    std::array<float, LAB_BATCH> l, a, b;
+    for (size_t begin = 0; begin < n; begin += LAB_BATCH) {
+        const size_t m = std::min(LAB_BATCH, n - begin);
+        rgbToLabBatch(in + begin, m, l.data(), a.data(), b.data());
+        transferLabBatched(l.data(), a.data(), b.data(), m, out + begin, srcStats, tgtStats, mask);
+    }
+}
+
+// The same from up to LAB_BATCH cached Lab values, with the same result.
+static void transferLabRun(const double *l,
+                           const double *a,
+                           const double *b,
+                           size_t m,
+                           Bgr *out,
+                           const Stats &srcStats,
+                           const Stats &tgtStats,
+                           const std::array<bool, 3> &mask,
+                           const LabLut *lut,
+                           bool simd)
+{
+    if (lut || !simd) {
+        const bool expand = true;
+        for (size_t j = 0; j < m; ++j) {
+            const Vec3d outLab = transferPixelLab(Vec3d{l[j], a[j], b[j]}, srcStats, tgtStats, mask);
+            out[j] = lut ? labToRgbLut(*lut, outLab) : labToRgb(outLab, expand);
+        }
+        return;
+    }
+    // Planes built with the batch kernels hold floats, so this narrowing is exact.
+    std::array<float, LAB_BATCH> tl, ta, tb;
+    std::transform(l, l + m, tl.data(), [](double v) { return static_cast<float>(v); });
+    std::transform(a, a + m, ta.data(), [](double v) { return static_cast<float>(v); });
+    std::transform(b, b + m, tb.data(), [](double v) { return static_cast<float>(v); });
+    transferLabBatched(tl.data(), ta.data(), tb.data(), m, out, srcStats, tgtStats, mask);
+}
+
+// What every pixel of one transfer shares.
+struct TransferParams {
+    const Stats &srcStats;
+    const Stats &tgtStats;
+    const std::array<bool, 3> &channelMask;
+    ApplyMode mode;
+    double alpha;
+    const LabLut *lut;
+    bool simd;
+};
+
+// The distinct colours of a table, transferred.
+static std::vector<Bgr> transferColorTable(const ColorTable &colors, const TransferParams &p, ThreadPool *pool)
+{
+    std::vector<Bgr> mapped(colors.colors.size());
+    runChunks(pool, makeChunks(mapped.size(), LAB_CHUNK), [&](size_t, const Range &r) {
+        transferRun(&colors.colors[r.begin], r.end - r.begin, &mapped[r.begin], p.srcStats, p.tgtStats,
+                    p.channelMask, p.lut, p.simd);
+    });
+    return mapped;
+}
+
+// Transfers the pixels of `target` into `out`. `regionMask` is null or matches the target; with
+// `mapped` (transferColorTable of `colors`) pixels are looked up, otherwise they are converted, from
+// `targetLab` when given.
+static void transferPixels(const ImageView &target,
+                           Bgr *out,
+                           const TransferParams &p,
+                           const RegionMask *regionMask,
+                           const ColorTable *colors,
+                           const std::vector<Bgr> *mapped,
+                           const PlanarF64 *targetLab,
+                           ThreadPool *pool)
+{
+    const bool memo = mapped != nullptr;
+    const bool blend = regionMask && p.mode == ApplyMode::Blend && p.alpha < 1.0;
+
+    // Every chunk writes only its own pixels. Without a table they are transferred a block at a
+    // time, from the cached Lab planes when given; blocks the region mask leaves untouched are skipped.
+    runChunks(pool, makeChunks(target.size(), LAB_CHUNK), [&](size_t, const Range &r) {
+        std::vector<Bgr> block(memo ? 0 : LAB_BATCH);
+        std::array<Bgr, LAB_BATCH> scratch;
+        for (size_t begin = r.begin; begin < r.end; begin += LAB_BATCH) {
+            const size_t end = std::min(r.end, begin + LAB_BATCH);
+            const Bgr *px = target.run(begin, end - begin, scratch.data());
+            const bool needed = !memo && (!regionMask || std::any_of(regionMask->bytes.begin() + begin,
+                                                                     regionMask->bytes.begin() + end,
+                                                                     [](uint8_t v) { return v != 0; }));
+            if (needed && targetLab) {
+                transferLabRun(targetLab->plane(0) + begin, targetLab->plane(1) + begin, targetLab->plane(2) + begin,
+                               end - begin, block.data(), p.srcStats, p.tgtStats, p.channelMask, p.lut, p.simd);
+            } else if (needed) {
+                transferRun(px, end - begin, block.data(), p.srcStats, p.tgtStats, p.channelMask, p.lut, p.simd);
+            }
+            for (size_t i = begin; i < end; ++i) {
+                if (!regionMask || regionMask->bytes[i]) {
+                    Bgr transferred = memo ? (*mapped)[colors->indexOf(px[i - begin])] : block[i - begin];
+                    if (blend) {
+                        out[i] = blendRgb(transferred, px[i - begin], p.alpha);
+                    } else {
+                        out[i] = transferred;
+                    }
+                } else {
+                    out[i] = px[i - begin];
+                }
+            }
+        }
+    });
 }
 
-Image applyColorTransferLab(const Image &target,
+Image applyColorTransferLab(const ImageView &target,
                             const Stats &srcStats,
                             const Stats &tgtStats,
                             const std::array<bool, 3> &channelMask)
@@ -119,45 +416,94 @@ Image applyColorTransferLab(const Image &target,
     return applyColorTransferLabMasked(target, srcStats, tgtStats, channelMask, nullptr, ApplyMode::Mask, 1.0);
 }
 
-Image applyColorTransferLabMasked(const Image &target,
+Image applyColorTransferLabMasked(const ImageView &target,
                                   const Stats &srcStats,
                                   const Stats &tgtStats,
                                   const std::array<bool, 3> &channelMask,
                                   const RegionMask *regionMask,
                                   ApplyMode mode,
-                                  double alpha)
+                                  double alpha,
+                                  const LabLut *lut,
+                                  const ColorTable *colors,
+                                  bool simd,
+                                  ThreadPool *pool,
+                                  const PlanarF64 *targetLab)
 {
-    Image out{target.width, target.height, std::vector<Bgr>(target.pixels.size())};
+    Image out{target.width, target.height, std::vector<Bgr>(target.size())};
 
     const bool haveMask = (regionMask && regionMask->width == target.width && regionMask->height == target.height &&
                            !regionMask->bytes.empty());
-    const size_t n = target.pixels.size();
+    const size_t n = target.size();
+    const TransferParams p{srcStats, tgtStats, channelMask, mode, clamp(alpha, 0.0, 1.0), lut, simd};
 
-    if (alpha < 0.0) {
-        alpha = 0.0;
-    }
-    if (alpha > 1.0) {
-        alpha = 1.0;
-    }
-
-    for (size_t i = 0; i < n; ++i) {
-        if (!haveMask || regionMask->bytes[i]) {
-            Bgr transferred = transferOne(target.pixels[i], srcStats, tgtStats, channelMask);
-            if (haveMask && mode == ApplyMode::Blend && alpha < 1.0) {
-                out.pixels[i] = blendRgb(transferred, target.pixels[i], alpha);
-            } else {
-                out.pixels[i] = transferred;
-            }
-        } else {
-            out.pixels[i] = target.pixels[i];
-        }
+    // With a colour table every distinct colour is transferred once and pixels look theirs up.
+    const bool memo = colors && colors->pixels == n;
+    const bool cached = !memo && targetLab && targetLab->planeSize() == n;
+    std::vector<Bgr> mapped;
+    if (memo) {
+        mapped = transferColorTable(*colors, p, pool);
     }
+    transferPixels(target, out.pixels.data(), p, haveMask ? regionMask : nullptr, colors, memo ? &mapped : nullptr,
+                   cached ? targetLab : nullptr, pool);
 
 #ifdef ENABLE_DEBUG_LOG
     CT_DEBUG(std::string("applyColorTransferLabMasked: mode=") + (mode == ApplyMode::Mask ? "mask" : "blend") +
-             " alpha=" + std::to_string(alpha) + " haveMask=" + (haveMask ? "yes" : "no"));
+             " alpha=" + std::to_string(p.alpha) + " haveMask=" + (haveMask ? "yes" : "no") +
+             " memo=" + (memo ? "yes" : "no") + " cachedLab=" + (cached ? "yes" : "no") +
+             " simd=" + (simd && !lut ? simdLevelName(simdLevel()) : "off") +
+             " threads=" + std::to_string(pool ? pool->size() : 1));
 #endif
     return out;
 }
 
+Status streamColorTransferLab(const ImageView &target,
+                              const Stats &srcStats,
+                              const Stats &tgtStats,
+                              const std::array<bool, 3> &channelMask,
+                              const std::vector<Brush> &brushes,
+                              ApplyMode mode,
+                              double alpha,
+                              uint32_t bandRows,
+                              const BandSink &sink,
+                              const LabLut *lut,
+                              const ColorTable *colors,
+                              bool simd,
+                              ThreadPool *pool)
+{
+    if (bandRows == 0) {
+        bandRows = target.height;
+    }
+    const TransferParams p{srcStats, tgtStats, channelMask, mode, clamp(alpha, 0.0, 1.0), lut, simd};
+    const bool memo = colors && colors->pixels == target.size();
+    std::vector<Bgr> mapped;
+    if (memo) {
+        mapped = transferColorTable(*colors, p, pool);
+    }
+
+    // One band buffer (and mask) for the whole image, reused from band to band.
+    Image band{target.width, 0, {}};
+    RegionMask mask;
+    uint32_t bands = 0;
+    for (uint32_t end = target.height; end > 0;) {
+        const uint32_t rows = std::min(bandRows, end);
+        end -= rows;
+        band.height = rows;
+        band.pixels.resize(static_cast<size_t>(target.width) * rows);
+        if (!brushes.empty()) {
+            mask = makeBrushMaskRows(target.width, end, rows, brushes);
+        }
+        transferPixels(target.rows(end, rows), band.pixels.data(), p, brushes.empty() ? nullptr : &mask, colors,
+                       memo ? &mapped : nullptr, nullptr, pool);
+        const Status st = sink(end, band);
+        if (st != Status::Ok) {
+            return st;
+        }
+        ++bands;
+    }
+
+    CT_DEBUG("streamColorTransferLab: bands=" + std::to_string(bands) + " bandRows=" + std::to_string(bandRows) +
+             " memo=" + (memo ? "yes" : "no") + " masked=" + (brushes.empty() ? "no" : "yes"));
+    return Status::Ok;
+}
+
 }  // namespace ct
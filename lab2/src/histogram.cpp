@@ -1,20 +1,103 @@
 #include "histogram.h"
+#include <algorithm>
+#include <array>
 
 namespace ct
 {
 
-void buildRgbHistograms(const Image &img, H256 &r, H256 &g, H256 &b)
+// Pixels per parallel chunk (whole rows are taken, at least one).
+static constexpr size_t HIST_CHUNK = 256 * 1024;
+// Copies of each channel's counters. Consecutive pixels count into different copies, so runs of
+// one colour, common in flat areas, do not make every increment wait for the previous store to
+// the same counter.
+static constexpr int HIST_COPIES = 4;
+
+// Counts of one chunk: HIST_COPIES sub-histograms each of B, G and R, 12 KB in all.
+using SubHistograms = std::array<std::array<H256, 3>, HIST_COPIES>;
+
+static void countRow(const Bgr *row, uint32_t width, SubHistograms &h)
+{
+    uint32_t x = 0;
+    for (; x + HIST_COPIES <= width; x += HIST_COPIES) {
+        for (int k = 0; k < HIST_COPIES; ++k) {
+            h[k][0][row[x + k].b]++;
+            h[k][1][row[x + k].g]++;
+            h[k][2][row[x + k].r]++;
+        }
+    }
+    for (; x < width; ++x) {
+        h[0][0][row[x].b]++;
+        h[0][1][row[x].g]++;
+        h[0][2][row[x].r]++;
+    }
+}
+
+void accumulateRgbHistograms(const std::vector<RgbHistogramJob> &jobs, ThreadPool *pool)
 {
-    r.fill(0);
-    g.fill(0);
-    b.fill(0);
-    for (const auto &p : img.pixels) {
-        r[p.r]++;
-        g[p.g]++;
-        b[p.b]++;
+    // Chunks of rows of every image go to the pool together; each chunk sums its sub-histograms
+    // into a partial of its own, and the partials are added to the jobs' histograms afterwards.
+    std::vector<Range> chunks;
+    std::vector<size_t> chunkJob;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const ImageView &img = jobs[j].img;
+        if (img.width == 0) {
+            continue;
+        }
+        const size_t rows = std::max<size_t>(1, HIST_CHUNK / img.width);
+        for (const Range &r : makeChunks(img.height, rows)) {
+            chunks.push_back(r);
+            chunkJob.push_back(j);
+        }
+    }
+
+    std::vector<std::array<H256, 3>> partials(chunks.size());
+    runChunks(pool, chunks, [&](size_t i, const Range &r) {
+        const ImageView &img = jobs[chunkJob[i]].img;
+        SubHistograms sub{};
+        for (size_t y = r.begin; y < r.end; ++y) {
+            countRow(img.row(static_cast<uint32_t>(y)), img.width, sub);
+        }
+        for (int c = 0; c < 3; ++c) {
+            for (int v = 0; v < 256; ++v) {
+                uint32_t n = 0;
+                for (int k = 0; k < HIST_COPIES; ++k) {
+                    n += sub[k][c][v];
+                }
+                partials[i][c][v] = n;
+            }
+        }
+    });
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const RgbHistogramJob &job = jobs[chunkJob[i]];
+        for (int v = 0; v < 256; ++v) {
+            (*job.b)[v] += partials[i][0][v];
+            (*job.g)[v] += partials[i][1][v];
+            (*job.r)[v] += partials[i][2][v];
+        }
     }
 }
 
+void buildRgbHistograms(const std::vector<RgbHistogramJob> &jobs, ThreadPool *pool)
+{
+    for (const RgbHistogramJob &job : jobs) {
+        job.r->fill(0);
+        job.g->fill(0);
+        job.b->fill(0);
+    }
+    accumulateRgbHistograms(jobs, pool);
+}
+
+void buildRgbHistograms(const ImageView &img, H256 &r, H256 &g, H256 &b, ThreadPool *pool)
+{
+    buildRgbHistograms({RgbHistogramJob{img, &r, &g, &b}}, pool);
+}
+
+void accumulateRgbHistograms(const ImageView &img, H256 &r, H256 &g, H256 &b, ThreadPool *pool)
+{
+    accumulateRgbHistograms({RgbHistogramJob{img, &r, &g, &b}}, pool);
+}
+
 Status saveHistogramCsv(const std::string &path, const H256 &h, std::string &outMessage)
 {
     std::vector<uint8_t> data;
@@ -30,21 +113,23 @@ Status saveHistogramCsv(const std::string &path, const H256 &h, std::string &out
     return writeFile(path, data, outMessage);
 }
 
-ChannelImages makeRgbChannelViews(const Image &img)
+static Image greyFromPlane(const PlaneView<const uint8_t> &plane)
 {
-    ChannelImages out;
-    out.ch0 = {img.width, img.height, std::vector<Bgr>(img.pixels.size())};
-    out.ch1 = out.ch0;
-    out.ch2 = out.ch0;
-    for (size_t i = 0; i < img.pixels.size(); ++i) {
-        uint8_t r = img.pixels[i].r;
-        uint8_t g = img.pixels[i].g;
-        uint8_t b = img.pixels[i].b;
-        out.ch0.pixels[i] = Bgr{r, r, r};
-        out.ch1.pixels[i] = Bgr{g, g, g};
-        out.ch2.pixels[i] = Bgr{b, b, b};
+    Image out{plane.width, plane.height, std::vector<Bgr>(static_cast<size_t>(plane.width) * plane.height)};
+    Bgr *dst = out.pixels.data();
+    for (uint32_t y = 0; y < plane.height; ++y) {
+        for (uint32_t x = 0; x < plane.width; ++x) {
+            const uint8_t v = plane.at(x, y);
+            *dst++ = Bgr{v, v, v};
+        }
     }
     return out;
 }
 
+ChannelImages makeRgbChannelViews(const ImageView &img)
+{
+    return ChannelImages{greyFromPlane(channelView(img, 0)), greyFromPlane(channelView(img, 1)),
+                         greyFromPlane(channelView(img, 2))};
+}
+
 }  // namespace ct
@@ -0,0 +1,123 @@
+#include "color_spaces.h"
+#include "lab_lut.h"
+#include "lab_simd.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace ct;
+
+// Compares the SIMD batch kernels and the Lab LUTs with the exact conversions over all 2^24
+// colours, and fails when an error bound documented in lab_simd.h or lab_lut.h is exceeded. A
+// check, not a benchmark; it takes a while, so build it with optimisation.
+
+// One approximate path and the bounds it promises.
+struct Check {
+    std::string name;
+    double labBound;       // largest RGB->Lab error in any channel
+    double offShareBound;  // share of colours whose Lab->RGB result is off by one level
+    SimdLevel level{SimdLevel::None};
+    int lutGrid{0};  // 0 = SIMD kernels at `level`
+};
+
+struct Errors {
+    double lab{0.0};
+    uint64_t off{0};  // colours off by a level in any channel
+    int worst{0};     // largest level difference
+};
+
+static int levelDiff(const Bgr &p, const Bgr &q)
+{
+    return std::max({std::abs(p.r - q.r), std::abs(p.g - q.g), std::abs(p.b - q.b)});
+}
+
+// Errors of `check` over the 65536 colours with red = r.
+static Errors measure(const Check &check, const LabLut *lut, uint32_t r)
+{
+    constexpr size_t n = 65536;
+    std::vector<Bgr> in(n);
+    for (size_t i = 0; i < n; ++i) {
+        in[i] = Bgr{static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(r)};
+    }
+    std::vector<Vec3d> exact(n);
+    std::vector<float> l(n), a(n), b(n);
+    for (size_t i = 0; i < n; ++i) {
+        exact[i] = rgbToLab(in[i], true);
+        l[i] = static_cast<float>(exact[i].x);
+        a[i] = static_cast<float>(exact[i].y);
+        b[i] = static_cast<float>(exact[i].z);
+    }
+
+    Errors e;
+    std::vector<float> fl(n), fa(n), fb(n);
+    std::vector<Bgr> back(n);
+    if (!lut) {
+        rgbToLabBatch(in.data(), n, fl.data(), fa.data(), fb.data(), check.level);
+        labToRgbBatch(l.data(), a.data(), b.data(), n, back.data(), check.level);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const Vec3d lab = lut ? rgbToLabLut(*lut, in[i]) : Vec3d{fl[i], fa[i], fb[i]};
+        e.lab = std::max({e.lab, std::abs(lab.x - exact[i].x), std::abs(lab.y - exact[i].y),
+                          std::abs(lab.z - exact[i].z)});
+        // The kernels take single-precision Lab, so they are held to the exact result for the
+        // same rounded input.
+        const Bgr approx = lut ? labToRgbLut(*lut, exact[i]) : back[i];
+        const Vec3d input = lut ? exact[i] : Vec3d{l[i], a[i], b[i]};
+        const int d = levelDiff(approx, labToRgb(input, true));
+        e.off += d > 0;
+        e.worst = std::max(e.worst, d);
+    }
+    return e;
+}
+
+int main()
+{
+    std::vector<Check> checks;
+    // Bounds as documented in lab_simd.h, for every level this CPU runs.
+    if (simdLevel() >= SimdLevel::Sse2) {
+        checks.push_back(Check{"simd sse2", 4.8e-7, 0.00027, SimdLevel::Sse2, 0});
+    }
+    if (simdLevel() >= SimdLevel::Avx2) {
+        checks.push_back(Check{"simd avx2", 4.8e-7, 0.00027, SimdLevel::Avx2, 0});
+    }
+    // And as documented in lab_lut.h.
+    checks.push_back(Check{"lut 17", 1.7e-2, 0.00031, SimdLevel::None, 17});
+    checks.push_back(Check{"lut 33", 4.2e-3, 0.00031, SimdLevel::None, 33});
+    checks.push_back(Check{"lut 65", 9.3e-4, 0.00031, SimdLevel::None, 65});
+
+    ThreadPool pool;
+    const std::vector<Range> chunks = makeChunks(256, 1);
+    int failed = 0;
+    std::printf("%-10s %12s %12s %10s %6s\n", "path", "rgb->lab", "bound", "off share", "worst");
+    for (const Check &check : checks) {
+        LabLut lut;
+        if (check.lutGrid > 0) {
+            auto built = makeLabLut(check.lutGrid);
+            if (!built.ok()) {
+                std::fprintf(stderr, "LUT error: %s\n", built.message.c_str());
+                return 1;
+            }
+            lut = std::move(built.value);
+        }
+        std::vector<Errors> parts(chunks.size());
+        runChunks(&pool, chunks, [&](size_t i, const Range &range) {
+            parts[i] = measure(check, check.lutGrid > 0 ? &lut : nullptr, static_cast<uint32_t>(range.begin));
+        });
+        Errors e;
+        for (const Errors &p : parts) {
+            e.lab = std::max(e.lab, p.lab);
+            e.off += p.off;
+            e.worst = std::max(e.worst, p.worst);
+        }
+        const double share = static_cast<double>(e.off) / (1u << 24);
+        const bool ok = e.lab <= check.labBound && share <= check.offShareBound && e.worst <= 1;
+        std::printf("%-10s %12.4g %12.4g %9.5f%% %6d %s\n", check.name.c_str(), e.lab, check.labBound, share * 100,
+                    e.worst, ok ? "ok" : "FAILED");
+        failed += !ok;
+    }
+    return failed ? 1 : 0;
+}
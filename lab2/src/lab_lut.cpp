@@ -0,0 +1,67 @@
+#include "lab_lut.h"
+#include <cmath>
+
+namespace ct
+{
+
+// Below this byte value toRgbNorm clamps to MIN_VAL, so Lab is flat there.
+static constexpr double KNEE = 255.0 * MIN_VAL / WHITE_COMPRESS;
+
+static double nodePosition(int k, int gridSize)
+{
+    const double t = static_cast<double>(k) / (gridSize - 1);
+    return KNEE + (255.0 - KNEE) * t * t * t;
+}
+
+static double normAt(double v)
+{
+    return clamp(v / 255.0 * WHITE_COMPRESS, MIN_VAL, WHITE_COMPRESS);
+}
+
+Result<LabLut> makeLabLut(int gridSize)
+{
+    Result<LabLut> r;
+    if (gridSize < 2 || gridSize > LAB_LUT_MAX_GRID) {
+        r.status = Status::InvalidArgument;
+        r.message = "LUT grid size must be 2.." + std::to_string(LAB_LUT_MAX_GRID);
+        return r;
+    }
+    LabLut &lut = r.value;
+    lut.gridSize = gridSize;
+
+    std::vector<double> pos(gridSize);
+    for (int k = 0; k < gridSize; ++k) {
+        pos[k] = nodePosition(k, gridSize);
+    }
+    for (int v = 0; v < 256; ++v) {
+        int k = 0;
+        while (k + 2 < gridSize && pos[k + 1] <= v) {
+            ++k;
+        }
+        lut.cell[v] = static_cast<uint16_t>(k);
+        lut.frac[v] = static_cast<float>(clamp((v - pos[k]) / (pos[k + 1] - pos[k]), 0.0, 1.0));
+    }
+
+    lut.nodes.resize(static_cast<size_t>(gridSize) * gridSize * gridSize * 3);
+    float *out = lut.nodes.data();
+    for (int i = 0; i < gridSize; ++i) {
+        for (int j = 0; j < gridSize; ++j) {
+            for (int k = 0; k < gridSize; ++k) {
+                const Vec3d lab = lmsToLab(rgbToLms(RgbNorm{normAt(pos[i]), normAt(pos[j]), normAt(pos[k])}));
+                *out++ = static_cast<float>(lab.x);
+                *out++ = static_cast<float>(lab.y);
+                *out++ = static_cast<float>(lab.z);
+            }
+        }
+    }
+
+    lut.pow10.resize(LabLut::POW10_SIZE + 1);
+    for (int i = 0; i <= LabLut::POW10_SIZE; ++i) {
+        lut.pow10[i] = std::pow(10.0, LabLut::POW10_LO + i / LabLut::POW10_SCALE);
+    }
+
+    CT_DEBUG("makeLabLut: grid=" + std::to_string(gridSize) + " nodes=" + std::to_string(lut.nodes.size() / 3));
+    return r;
+}
+
+}  // namespace ct
@@ -0,0 +1,364 @@
+#include "lab_simd.h"
+#include "color_spaces.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CT_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ct
+{
+
+// Pixels deinterleaved per kernel pass; the six planes fit comfortably in L1.
+static constexpr size_t CHUNK = 64;
+
+static constexpr float IN_SCALE = static_cast<float>(WHITE_COMPRESS / 255.0);
+static constexpr float OUT_SCALE = static_cast<float>(255.0 / WHITE_COMPRESS);
+static constexpr float MIN_F = static_cast<float>(MIN_VAL);
+
+// The matrices of color_spaces.cpp.
+static constexpr float LMS[3][3] = {
+    {0.3811f, 0.5783f, 0.0402f}, {0.1967f, 0.7244f, 0.0782f}, {0.0241f, 0.1288f, 0.8444f}};
+static constexpr float RGB[3][3] = {
+    {4.4679f, -3.5873f, 0.1193f}, {-1.2186f, 2.3809f, -0.1624f}, {0.0497f, -0.2439f, 1.2045f}};
+static constexpr float INV_SQRT3 = 0.57735026919f;
+static constexpr float INV_SQRT6 = 0.40824829046f;
+static constexpr float INV_SQRT2 = 0.70710678118f;
+
+// log: x = 2^e * m with m in [sqrt(1/2), sqrt(2)), ln(m) = t - t^2/2 + t^3 P(t) for t = m - 1
+// (Cephes logf). exp: 10^x = 2^n * e^r with n = round(x log2(10)), r = x ln(10) - n ln(2) in
+// [-ln(2)/2, ln(2)/2], e^r = 1 + r + r^2 Q(r) (Cephes expf); ln(2) is split so n ln(2) stays exact.
+static constexpr float SQRT2_F = 1.41421356237f;
+static constexpr float LOG10_E = 0.43429448190f;
+static constexpr float LN2_HI = 0.693359375f;
+static constexpr float LN2_LO = -2.12194440e-4f;
+static constexpr float LN10 = 2.30258509299f;
+static constexpr float LOG2_10 = 3.32192809489f;
+// 10^x over- and underflows float past these.
+static constexpr float EXP10_LO = -37.0f;
+static constexpr float EXP10_HI = 38.0f;
+static constexpr float LOG_P[9] = {7.0376836292e-2f,  -1.1514610310e-1f, 1.1676998740e-1f,
+                                   -1.2420140846e-1f, 1.4249322787e-1f,  -1.6668057665e-1f,
+                                   2.0000714765e-1f,  -2.4999993993e-1f, 3.3333331174e-1f};
+static constexpr float EXP_Q[6] = {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+                                   4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+
+// Deinterleaves up to CHUNK pixels into zero-padded planes; returns how many were real.
+static size_t loadPixels(const Bgr *in, size_t n, float *r, float *g, float *b)
+{
+    const size_t m = std::min(n, CHUNK);
+    for (size_t j = 0; j < m; ++j) {
+        r[j] = in[j].r;
+        g[j] = in[j].g;
+        b[j] = in[j].b;
+    }
+    std::fill(r + m, r + CHUNK, 0.0f);
+    std::fill(g + m, g + CHUNK, 0.0f);
+    std::fill(b + m, b + CHUNK, 0.0f);
+    return m;
+}
+
+static size_t loadPlanes(const float *l, const float *a, const float *b, size_t n, float *pl, float *pa, float *pb)
+{
+    const size_t m = std::min(n, CHUNK);
+    std::memcpy(pl, l, m * sizeof(float));
+    std::memcpy(pa, a, m * sizeof(float));
+    std::memcpy(pb, b, m * sizeof(float));
+    std::fill(pl + m, pl + CHUNK, 0.0f);
+    std::fill(pa + m, pa + CHUNK, 0.0f);
+    std::fill(pb + m, pb + CHUNK, 0.0f);
+    return m;
+}
+
+static void storePixels(const int32_t *r, const int32_t *g, const int32_t *b, size_t m, Bgr *out)
+{
+    for (size_t j = 0; j < m; ++j) {
+        out[j] = Bgr{static_cast<uint8_t>(b[j]), static_cast<uint8_t>(g[j]), static_cast<uint8_t>(r[j])};
+    }
+}
+
+#ifdef CT_SIMD_X86
+
+#define CT_TARGET_SSE2 __attribute__((target("sse2")))
+#define CT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+// ---- SSE2, four lanes ----
+
+CT_TARGET_SSE2 static inline __m128 madd4(__m128 a, __m128 b, __m128 c)
+{
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+
+CT_TARGET_SSE2 static inline __m128 log10Sse2(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i bits = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128 m = _mm_castsi128_ps(
+        _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+    const __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(SQRT2_F));
+    m = _mm_or_ps(_mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))), _mm_andnot_ps(big, m));
+    e = _mm_add_ps(e, _mm_and_ps(big, one));
+    const __m128 t = _mm_sub_ps(m, one);
+    const __m128 z = _mm_mul_ps(t, t);
+    __m128 p = _mm_set1_ps(LOG_P[0]);
+    for (int k = 1; k < 9; ++k) {
+        p = madd4(p, t, _mm_set1_ps(LOG_P[k]));
+    }
+    __m128 y = _mm_mul_ps(_mm_mul_ps(t, z), p);
+    y = madd4(e, _mm_set1_ps(LN2_LO), y);
+    y = madd4(z, _mm_set1_ps(-0.5f), y);
+    const __m128 ln = madd4(e, _mm_set1_ps(LN2_HI), _mm_add_ps(t, y));
+    return _mm_mul_ps(ln, _mm_set1_ps(LOG10_E));
+}
+
+CT_TARGET_SSE2 static inline __m128 exp10Sse2(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP10_LO)), _mm_set1_ps(EXP10_HI));
+    const __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(LOG2_10)));
+    const __m128 nf = _mm_cvtepi32_ps(n);
+    __m128 r = _mm_mul_ps(x, _mm_set1_ps(LN10));
+    r = _mm_sub_ps(r, _mm_mul_ps(nf, _mm_set1_ps(LN2_HI)));
+    r = _mm_sub_ps(r, _mm_mul_ps(nf, _mm_set1_ps(LN2_LO)));
+    __m128 q = _mm_set1_ps(EXP_Q[0]);
+    for (int k = 1; k < 6; ++k) {
+        q = madd4(q, r, _mm_set1_ps(EXP_Q[k]));
+    }
+    const __m128 y = madd4(_mm_mul_ps(q, r), r, _mm_add_ps(r, _mm_set1_ps(1.0f)));
+    const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+    return _mm_mul_ps(y, scale);
+}
+
+CT_TARGET_SSE2 static void rgbToLabSse2(const Bgr *in, size_t n, float *l, float *a, float *b)
+{
+    alignas(16) float pr[CHUNK], pg[CHUNK], pb[CHUNK], ol[CHUNK], oa[CHUNK], ob[CHUNK];
+    const __m128 minV = _mm_set1_ps(MIN_F);
+    for (size_t done = 0; done < n; done += CHUNK) {
+        const size_t m = loadPixels(in + done, n - done, pr, pg, pb);
+        for (size_t j = 0; j < CHUNK; j += 4) {
+            const __m128 r = _mm_max_ps(_mm_mul_ps(_mm_load_ps(pr + j), _mm_set1_ps(IN_SCALE)), minV);
+            const __m128 g = _mm_max_ps(_mm_mul_ps(_mm_load_ps(pg + j), _mm_set1_ps(IN_SCALE)), minV);
+            const __m128 bl = _mm_max_ps(_mm_mul_ps(_mm_load_ps(pb + j), _mm_set1_ps(IN_SCALE)), minV);
+            __m128 lms[3];
+            for (int c = 0; c < 3; ++c) {
+                __m128 v = _mm_mul_ps(r, _mm_set1_ps(LMS[c][0]));
+                v = madd4(g, _mm_set1_ps(LMS[c][1]), v);
+                v = madd4(bl, _mm_set1_ps(LMS[c][2]), v);
+                lms[c] = log10Sse2(_mm_max_ps(v, minV));
+            }
+            const __m128 lm = _mm_add_ps(lms[0], lms[1]);
+            _mm_store_ps(ol + j, _mm_mul_ps(_mm_add_ps(lm, lms[2]), _mm_set1_ps(INV_SQRT3)));
+            _mm_store_ps(oa + j, _mm_mul_ps(madd4(lms[2], _mm_set1_ps(-2.0f), lm), _mm_set1_ps(INV_SQRT6)));
+            _mm_store_ps(ob + j, _mm_mul_ps(_mm_sub_ps(lms[0], lms[1]), _mm_set1_ps(INV_SQRT2)));
+        }
+        std::memcpy(l + done, ol, m * sizeof(float));
+        std::memcpy(a + done, oa, m * sizeof(float));
+        std::memcpy(b + done, ob, m * sizeof(float));
+    }
+}
+
+CT_TARGET_SSE2 static void labToRgbSse2(const float *l, const float *a, const float *b, size_t n, Bgr *out)
+{
+    alignas(16) float pl[CHUNK], pa[CHUNK], pb[CHUNK];
+    alignas(16) int32_t orr[CHUNK], og[CHUNK], ob[CHUNK];
+    int32_t *outPlanes[3] = {orr, og, ob};
+    // Clamped after scaling: the white point times OUT_SCALE rounds to just below 255 in float.
+    const __m128 max255 = _mm_set1_ps(255.0f);
+    for (size_t done = 0; done < n; done += CHUNK) {
+        const size_t m = loadPlanes(l + done, a + done, b + done, n - done, pl, pa, pb);
+        for (size_t j = 0; j < CHUNK; j += 4) {
+            const __m128 vl = _mm_mul_ps(_mm_load_ps(pl + j), _mm_set1_ps(INV_SQRT3));
+            const __m128 va = _mm_mul_ps(_mm_load_ps(pa + j), _mm_set1_ps(INV_SQRT6));
+            const __m128 vb = _mm_mul_ps(_mm_load_ps(pb + j), _mm_set1_ps(INV_SQRT2));
+            const __m128 la = _mm_add_ps(vl, va);
+            const __m128 lms[3] = {exp10Sse2(_mm_add_ps(la, vb)), exp10Sse2(_mm_sub_ps(la, vb)),
+                                   exp10Sse2(madd4(va, _mm_set1_ps(-2.0f), vl))};
+            for (int c = 0; c < 3; ++c) {
+                __m128 v = _mm_mul_ps(lms[0], _mm_set1_ps(RGB[c][0]));
+                v = madd4(lms[1], _mm_set1_ps(RGB[c][1]), v);
+                v = madd4(lms[2], _mm_set1_ps(RGB[c][2]), v);
+                v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, _mm_set1_ps(OUT_SCALE)), _mm_setzero_ps()), max255);
+                _mm_store_si128(reinterpret_cast<__m128i *>(outPlanes[c] + j), _mm_cvttps_epi32(v));
+            }
+        }
+        storePixels(orr, og, ob, m, out + done);
+    }
+}
+
+// ---- AVX2 + FMA, eight lanes; same steps as above ----
+
+CT_TARGET_AVX2 static inline __m256 log10Avx2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(
+        _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+    const __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(SQRT2_F), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    e = _mm256_add_ps(e, _mm256_and_ps(big, one));
+    const __m256 t = _mm256_sub_ps(m, one);
+    const __m256 z = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_set1_ps(LOG_P[0]);
+    for (int k = 1; k < 9; ++k) {
+        p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LOG_P[k]));
+    }
+    __m256 y = _mm256_mul_ps(_mm256_mul_ps(t, z), p);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(LN2_LO), y);
+    y = _mm256_fmadd_ps(z, _mm256_set1_ps(-0.5f), y);
+    const __m256 ln = _mm256_fmadd_ps(e, _mm256_set1_ps(LN2_HI), _mm256_add_ps(t, y));
+    return _mm256_mul_ps(ln, _mm256_set1_ps(LOG10_E));
+}
+
+CT_TARGET_AVX2 static inline __m256 exp10Avx2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP10_LO)), _mm256_set1_ps(EXP10_HI));
+    const __m256i n = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(LOG2_10)));
+    const __m256 nf = _mm256_cvtepi32_ps(n);
+    __m256 r = _mm256_mul_ps(x, _mm256_set1_ps(LN10));
+    r = _mm256_fnmadd_ps(nf, _mm256_set1_ps(LN2_HI), r);
+    r = _mm256_fnmadd_ps(nf, _mm256_set1_ps(LN2_LO), r);
+    __m256 q = _mm256_set1_ps(EXP_Q[0]);
+    for (int k = 1; k < 6; ++k) {
+        q = _mm256_fmadd_ps(q, r, _mm256_set1_ps(EXP_Q[k]));
+    }
+    const __m256 y = _mm256_fmadd_ps(_mm256_mul_ps(q, r), r, _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+    return _mm256_mul_ps(y, scale);
+}
+
+CT_TARGET_AVX2 static void rgbToLabAvx2(const Bgr *in, size_t n, float *l, float *a, float *b)
+{
+    alignas(32) float pr[CHUNK], pg[CHUNK], pb[CHUNK], ol[CHUNK], oa[CHUNK], ob[CHUNK];
+    const __m256 minV = _mm256_set1_ps(MIN_F);
+    for (size_t done = 0; done < n; done += CHUNK) {
+        const size_t m = loadPixels(in + done, n - done, pr, pg, pb);
+        for (size_t j = 0; j < CHUNK; j += 8) {
+            const __m256 r = _mm256_max_ps(_mm256_mul_ps(_mm256_load_ps(pr + j), _mm256_set1_ps(IN_SCALE)), minV);
+            const __m256 g = _mm256_max_ps(_mm256_mul_ps(_mm256_load_ps(pg + j), _mm256_set1_ps(IN_SCALE)), minV);
+            const __m256 bl = _mm256_max_ps(_mm256_mul_ps(_mm256_load_ps(pb + j), _mm256_set1_ps(IN_SCALE)), minV);
+            __m256 lms[3];
+            for (int c = 0; c < 3; ++c) {
+                __m256 v = _mm256_mul_ps(r, _mm256_set1_ps(LMS[c][0]));
+                v = _mm256_fmadd_ps(g, _mm256_set1_ps(LMS[c][1]), v);
+                v = _mm256_fmadd_ps(bl, _mm256_set1_ps(LMS[c][2]), v);
+                lms[c] = log10Avx2(_mm256_max_ps(v, minV));
+            }
+            const __m256 lm = _mm256_add_ps(lms[0], lms[1]);
+            _mm256_store_ps(ol + j, _mm256_mul_ps(_mm256_add_ps(lm, lms[2]), _mm256_set1_ps(INV_SQRT3)));
+            const __m256 am = _mm256_fmadd_ps(lms[2], _mm256_set1_ps(-2.0f), lm);
+            _mm256_store_ps(oa + j, _mm256_mul_ps(am, _mm256_set1_ps(INV_SQRT6)));
+            _mm256_store_ps(ob + j, _mm256_mul_ps(_mm256_sub_ps(lms[0], lms[1]), _mm256_set1_ps(INV_SQRT2)));
+        }
+        std::memcpy(l + done, ol, m * sizeof(float));
+        std::memcpy(a + done, oa, m * sizeof(float));
+        std::memcpy(b + done, ob, m * sizeof(float));
+    }
+}
+
+CT_TARGET_AVX2 static void labToRgbAvx2(const float *l, const float *a, const float *b, size_t n, Bgr *out)
+{
+    alignas(32) float pl[CHUNK], pa[CHUNK], pb[CHUNK];
+    alignas(32) int32_t orr[CHUNK], og[CHUNK], ob[CHUNK];
+    int32_t *outPlanes[3] = {orr, og, ob};
+    const __m256 max255 = _mm256_set1_ps(255.0f);
+    for (size_t done = 0; done < n; done += CHUNK) {
+        const size_t m = loadPlanes(l + done, a + done, b + done, n - done, pl, pa, pb);
+        for (size_t j = 0; j < CHUNK; j += 8) {
+            const __m256 vl = _mm256_mul_ps(_mm256_load_ps(pl + j), _mm256_set1_ps(INV_SQRT3));
+            const __m256 va = _mm256_mul_ps(_mm256_load_ps(pa + j), _mm256_set1_ps(INV_SQRT6));
+            const __m256 vb = _mm256_mul_ps(_mm256_load_ps(pb + j), _mm256_set1_ps(INV_SQRT2));
+            const __m256 la = _mm256_add_ps(vl, va);
+            const __m256 lms[3] = {exp10Avx2(_mm256_add_ps(la, vb)), exp10Avx2(_mm256_sub_ps(la, vb)),
+                                   exp10Avx2(_mm256_fmadd_ps(va, _mm256_set1_ps(-2.0f), vl))};
+            for (int c = 0; c < 3; ++c) {
+                __m256 v = _mm256_mul_ps(lms[0], _mm256_set1_ps(RGB[c][0]));
+                v = _mm256_fmadd_ps(lms[1], _mm256_set1_ps(RGB[c][1]), v);
+                v = _mm256_fmadd_ps(lms[2], _mm256_set1_ps(RGB[c][2]), v);
+                v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, _mm256_set1_ps(OUT_SCALE)), _mm256_setzero_ps()),
+                                  max255);
+                _mm256_store_si256(reinterpret_cast<__m256i *>(outPlanes[c] + j), _mm256_cvttps_epi32(v));
+            }
+        }
+        storePixels(orr, og, ob, m, out + done);
+    }
+}
+
+#endif  // CT_SIMD_X86
+
+static SimdLevel detectSimdLevel()
+{
+#ifdef CT_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SimdLevel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SimdLevel::Sse2;
+    }
+#endif
+    return SimdLevel::None;
+}
+
+SimdLevel simdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+    switch (level) {
+        case SimdLevel::Avx2:
+            return "avx2";
+        case SimdLevel::Sse2:
+            return "sse2";
+        default:
+            return "none";
+    }
+}
+
+void rgbToLabBatch(const Bgr *in, size_t n, float *l, float *a, float *b, SimdLevel level)
+{
+    level = std::min(level, simdLevel());
+#ifdef CT_SIMD_X86
+    if (level == SimdLevel::Avx2) {
+        rgbToLabAvx2(in, n, l, a, b);
+        return;
+    }
+    if (level == SimdLevel::Sse2) {
+        rgbToLabSse2(in, n, l, a, b);
+        return;
+    }
+#endif
+    const bool compress = true;
+    for (size_t i = 0; i < n; ++i) {
+        const Vec3d lab = rgbToLab(in[i], compress);
+        l[i] = static_cast<float>(lab.x);
+        a[i] = static_cast<float>(lab.y);
+        b[i] = static_cast<float>(lab.z);
+    }
+}
+
+void labToRgbBatch(const float *l, const float *a, const float *b, size_t n, Bgr *out, SimdLevel level)
+{
+    level = std::min(level, simdLevel());
+#ifdef CT_SIMD_X86
+    if (level == SimdLevel::Avx2) {
+        labToRgbAvx2(l, a, b, n, out);
+        return;
+    }
+    if (level == SimdLevel::Sse2) {
+        labToRgbSse2(l, a, b, n, out);
+        return;
+    }
+#endif
+    const bool expand = true;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = labToRgb(Vec3d{l[i], a[i], b[i]}, expand);
+    }
+}
+
+}  // namespace ct
@@ -3,11 +3,106 @@
 #include "color_transfer.h"
 #include "histogram.h"
 #include "region.h"
+#include "stats_cache.h"
+#include "thread_pool.h"
 #include "utils.h"
 #include <cstdio>
+#include <utility>
 
 using namespace ct;
 
+enum class StatsOrigin : uint8_t {
+    Computed = 0,
+    Cached = 1,
+    Stored = 2  // computed, then added to the cache
+};
+
+static SourceStats computeSourceStats(const ImageView &img, const CliOptions &opt, const LabLut *lut, ThreadPool &pool)
+{
+    // Images with few distinct colours are converted once per colour.
+    ColorTable colors;
+    if (opt.memoColors && img.size() >= COLOR_TABLE_MIN_PIXELS) {
+        colors = buildColorTable(img);
+    }
+    SourceStats s;
+    s.stats = colors.worthMemoising() ? computeLabStats(colors, lut, opt.simd, &pool)
+                                      : computeLabStats(img, lut, opt.simd, &pool);
+    buildRgbHistograms(img, s.r, s.g, s.b, &pool);
+    return s;
+}
+
+// Only 24-bit BMPs are read in place; any other format would be decoded whole, which streaming
+// is meant to avoid.
+static std::string streamFormatError(const std::string &path, const BmpFormat &format)
+{
+    const char *kind = format.compression == BmpCompression::Bitfields ? " with bit fields"
+                       : format.compression == BmpCompression::Rgb     ? ""
+                                                                       : " RLE";
+    return "--stream-rows needs 24-bit uncompressed BMPs, " + path + " is " + std::to_string(format.bitCount) +
+           "-bit" + kind;
+}
+
+// Stats of the source at `path`: from the stats cache when it has them, otherwise computed from
+// the image and stored there. A failed store is reported in `msg` but is not an error.
+static Status sourceStats(const std::string &path,
+                          const CliOptions &opt,
+                          const LabLut *lut,
+                          ThreadPool &pool,
+                          SourceStats &out,
+                          StatsOrigin &origin,
+                          std::string &msg)
+{
+    origin = StatsOrigin::Computed;
+    const bool useCache = !opt.statsCacheDir.empty();
+    const StatsCache cache(opt.statsCacheDir);
+    const std::string tag = statsCacheTag(opt.lutGrid, opt.simd, opt.memoColors);
+    Result<uint64_t> hash;
+    if (useCache) {
+        hash = cache.contentHash(path);
+        if (!hash.ok()) {
+            msg = hash.message;
+            return hash.status;
+        }
+        if (cache.load(hash.value, tag, out)) {
+            origin = StatsOrigin::Cached;
+            return Status::Ok;
+        }
+    }
+
+    // The source is only read, so its pixels are used straight from the mapped file.
+    MappedBmp bmp;
+    const Status st = openBmp(path, bmp, msg);
+    if (st != Status::Ok) {
+        return st;
+    }
+    if (opt.streamRows > 0 && !bmp.inPlace()) {
+        msg = streamFormatError(path, bmp.format);
+        return Status::Unsupported;
+    }
+    out = computeSourceStats(bmp.view, opt, lut, pool);
+    if (useCache && cache.store(hash.value, tag, out, msg) == Status::Ok) {
+        origin = StatsOrigin::Stored;
+    }
+    return Status::Ok;
+}
+
+static int precompute(const CliOptions &opt, const LabLut *lut, ThreadPool &pool)
+{
+    int failed = 0;
+    for (const auto &path : opt.sources) {
+        SourceStats s;
+        StatsOrigin origin;
+        std::string msg;
+        if (sourceStats(path, opt, lut, pool, s, origin, msg) != Status::Ok || origin == StatsOrigin::Computed) {
+            std::fprintf(stderr, "%s: %s\n", path.c_str(), msg.c_str());
+            ++failed;
+            continue;
+        }
+        std::printf("%s: %s\n", path.c_str(), origin == StatsOrigin::Cached ? "cached" : "stored");
+    }
+    return failed ? 2 : 0;
+}
+
 int main(int argc, char **argv)
 {
     auto parsed = parseCli(argc, argv);
@@ -18,54 +113,147 @@ int main(int argc, char **argv)
     }
     const CliOptions &opt = parsed.value;
 
-    Image srcImg, tgtImg;
+    LabLut lut;
+    const LabLut *lutPtr = nullptr;
+    if (opt.lutGrid > 0) {
+        auto built = makeLabLut(opt.lutGrid);
+        if (!built.ok()) {
+            std::fprintf(stderr, "LUT error: %s\n", built.message.c_str());
+            return 1;
+        }
+        lut = std::move(built.value);
+        lutPtr = &lut;
+    }
+
+    ThreadPool pool(static_cast<unsigned>(opt.threads));
+
+    if (opt.command == CliCommand::Precompute) {
+        return precompute(opt, lutPtr, pool);
+    }
+
+    SourceStats src;
+    StatsOrigin srcOrigin;
     std::string msg;
-    if (loadBmp(opt.srcPath, srcImg, msg) != Status::Ok) {
+    if (sourceStats(opt.srcPath, opt, lutPtr, pool, src, srcOrigin, msg) != Status::Ok) {
         std::fprintf(stderr, "Source load error: %s\n", msg.c_str());
         return 2;
     }
-    if (loadBmp(opt.tgtPath, tgtImg, msg) != Status::Ok) {
+    if (!opt.statsCacheDir.empty() && srcOrigin == StatsOrigin::Computed) {
+        std::fprintf(stderr, "Warning: source stats not cached: %s\n", msg.c_str());
+    }
+    const Stats &srcStats = src.stats;
+
+    MappedBmp tgtBmp;
+    if (openBmp(opt.tgtPath, tgtBmp, msg) != Status::Ok) {
         std::fprintf(stderr, "Target load error: %s\n", msg.c_str());
         return 3;
     }
+    if (opt.streamRows > 0 && !tgtBmp.inPlace()) {
+        std::fprintf(stderr, "Target load error: %s\n", streamFormatError(opt.tgtPath, tgtBmp.format).c_str());
+        return 3;
+    }
+    const ImageView tgtImg = tgtBmp.view;
 
-    Stats srcStats = computeLabStats(srcImg);
-    Stats tgtStats = computeLabStats(tgtImg);
+    ColorTable tgtColors;
+    if (opt.memoColors && tgtImg.size() >= COLOR_TABLE_MIN_PIXELS) {
+        tgtColors = buildColorTable(tgtImg);
+    }
+    const bool memoTgt = tgtColors.worthMemoising();
 
-    RegionMask mask;
-    RegionMask *maskPtr = nullptr;
-    if (!opt.brushes.empty()) {
-        mask = makeEmptyMask(tgtImg.width, tgtImg.height);
-        applyBrushes(mask, opt.brushes);
-        maskPtr = &mask;
-        if (!opt.saveMaskPath.empty()) {
-            saveMaskBmp(opt.saveMaskPath, mask, msg);
-        }
+    // Otherwise exact conversions of the target are done once and shared by both passes, unless
+    // brushes limit the transfer to part of the image or it is streamed.
+    const bool stream = opt.streamRows > 0;
+    const uint32_t bandRows = static_cast<uint32_t>(opt.streamRows);
+    PlanarF64 tgtLab;
+    const bool cacheTgt = !stream && !memoTgt && !opt.simd && !lutPtr && opt.brushes.empty();
+    if (cacheTgt) {
+        tgtLab = computeLabPlanes(tgtImg, lutPtr, opt.simd, &pool);
     }
 
-    Image resImg =
-        applyColorTransferLabMasked(tgtImg, srcStats, tgtStats, opt.labMask, maskPtr, opt.applyMode, opt.alpha);
+    Stats tgtStats = memoTgt    ? computeLabStats(tgtColors, lutPtr, opt.simd, &pool)
+                     : cacheTgt ? computeLabStats(tgtLab, &pool)
+                                : computeLabStats(tgtImg, lutPtr, opt.simd, &pool);
 
-    if (saveBmp(opt.outPrefix + "_result.bmp", resImg, msg) != Status::Ok) {
-        std::fprintf(stderr, "Save result error: %s\n", msg.c_str());
-        return 4;
+    // With --keep-depth the result is written like the target; a palette is rebuilt from the
+    // result's own colours, so a too colourful result is written 24-bit instead. Streamed targets
+    // are always 24-bit.
+    BmpFormat outFormat;
+    if (opt.keepDepth) {
+        outFormat = tgtBmp.format;
+        outFormat.palette.clear();
+    }
+
+    // The target's and the result's histograms are built together: per band when streaming, in
+    // one job over both images otherwise.
+    H256 tgtR, tgtG, tgtB;
+    H256 resR, resG, resB;
+    if (stream) {
+        // Bands of the result are written as they are done; the mask is painted per band too.
+        if (!opt.brushes.empty() && !opt.saveMaskPath.empty()) {
+            saveMaskBmp(opt.saveMaskPath, tgtImg.width, tgtImg.height, opt.brushes, bandRows, msg);
+        }
+        for (H256 *h : {&tgtR, &tgtG, &tgtB, &resR, &resG, &resB}) {
+            h->fill(0);
+        }
+        BmpWriter writer;
+        Status st = writer.open(opt.outPrefix + "_result.bmp", tgtImg.width, tgtImg.height, outFormat, msg);
+        if (st == Status::Ok) {
+            st = streamColorTransferLab(
+                tgtImg, srcStats, tgtStats, opt.labMask, opt.brushes, opt.applyMode, opt.alpha, bandRows,
+                [&](uint32_t y, const Image &band) {
+                    accumulateRgbHistograms({{tgtImg.rows(y, band.height), &tgtR, &tgtG, &tgtB},
+                                             {band, &resR, &resG, &resB}},
+                                            &pool);
+                    return writer.writeBand(band, msg);
+                },
+                lutPtr, memoTgt ? &tgtColors : nullptr, opt.simd, &pool);
+        }
+        if (st == Status::Ok) {
+            st = writer.close(msg);
+        }
+        if (st != Status::Ok) {
+            std::fprintf(stderr, "Save result error: %s\n", msg.c_str());
+            return 4;
+        }
+    } else {
+        RegionMask mask;
+        RegionMask *maskPtr = nullptr;
+        if (!opt.brushes.empty()) {
+            mask = makeEmptyMask(tgtImg.width, tgtImg.height);
+            applyBrushes(mask, opt.brushes);
+            maskPtr = &mask;
+            if (!opt.saveMaskPath.empty()) {
+                saveMaskBmp(opt.saveMaskPath, mask, msg);
+            }
+        }
+
+        Image resImg = applyColorTransferLabMasked(tgtImg, srcStats, tgtStats, opt.labMask, maskPtr, opt.applyMode,
+                                                   opt.alpha, lutPtr, memoTgt ? &tgtColors : nullptr, opt.simd,
+                                                   &pool, cacheTgt ? &tgtLab : nullptr);
+
+        if (outFormat.paletted() && !collectPalette(resImg, size_t{1} << outFormat.bitCount, outFormat.palette)) {
+            std::fprintf(stderr, "Warning: result has more than %zu colours; writing 24-bit\n",
+                         size_t{1} << outFormat.bitCount);
+            outFormat = BmpFormat{};
+        }
+        if (saveBmp(opt.outPrefix + "_result.bmp", resImg, outFormat, msg) != Status::Ok) {
+            std::fprintf(stderr, "Save result error: %s\n", msg.c_str());
+            return 4;
+        }
+        buildRgbHistograms({{tgtImg, &tgtR, &tgtG, &tgtB}, {resImg, &resR, &resG, &resB}}, &pool);
     }
 
-    H256 r, g, b;
-    buildRgbHistograms(srcImg, r, g, b);
-    saveHistogramCsv(opt.outPrefix + "_src_r.csv", r, msg);
-    saveHistogramCsv(opt.outPrefix + "_src_g.csv", g, msg);
-    saveHistogramCsv(opt.outPrefix + "_src_b.csv", b, msg);
+    saveHistogramCsv(opt.outPrefix + "_src_r.csv", src.r, msg);
+    saveHistogramCsv(opt.outPrefix + "_src_g.csv", src.g, msg);
+    saveHistogramCsv(opt.outPrefix + "_src_b.csv", src.b, msg);
 
-    buildRgbHistograms(tgtImg, r, g, b);
-    saveHistogramCsv(opt.outPrefix + "_tgt_r.csv", r, msg);
-    saveHistogramCsv(opt.outPrefix + "_tgt_g.csv", g, msg);
-    saveHistogramCsv(opt.outPrefix + "_tgt_b.csv", b, msg);
+    saveHistogramCsv(opt.outPrefix + "_tgt_r.csv", tgtR, msg);
+    saveHistogramCsv(opt.outPrefix + "_tgt_g.csv", tgtG, msg);
+    saveHistogramCsv(opt.outPrefix + "_tgt_b.csv", tgtB, msg);
 
-    buildRgbHistograms(resImg, r, g, b);
-    saveHistogramCsv(opt.outPrefix + "_res_r.csv", r, msg);
-    saveHistogramCsv(opt.outPrefix + "_res_g.csv", g, msg);
-    saveHistogramCsv(opt.outPrefix + "_res_b.csv", b, msg);
+    saveHistogramCsv(opt.outPrefix + "_res_r.csv", resR, msg);
+    saveHistogramCsv(opt.outPrefix + "_res_g.csv", resG, msg);
+    saveHistogramCsv(opt.outPrefix + "_res_b.csv", resB, msg);
 
 #ifdef ENABLE_DEBUG_LOG
     {
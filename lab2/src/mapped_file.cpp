@@ -0,0 +1,135 @@
+#include "mapped_file.h"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ct
+{
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other) {
+        close();
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+#ifdef _WIN32
+        std::swap(mapping, other.mapping);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+Status MappedFile::open(const std::string &path, std::string &outMessage)
+{
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        outMessage = "Cannot open file: " + path;
+        return Status::IoError;
+    }
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        outMessage = "Cannot stat file: " + path;
+        return Status::IoError;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return Status::Ok;
+    }
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!map) {
+        outMessage = "Cannot map file: " + path;
+        return Status::IoError;
+    }
+    void *view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(map);
+        outMessage = "Cannot map file: " + path;
+        return Status::IoError;
+    }
+    mapping = map;
+    bytes = static_cast<const uint8_t *>(view);
+    length = static_cast<size_t>(size.QuadPart);
+    return Status::Ok;
+}
+
+void MappedFile::close()
+{
+    if (bytes) {
+        UnmapViewOfFile(bytes);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    bytes = nullptr;
+    length = 0;
+    mapping = nullptr;
+}
+
+#else
+
+Status MappedFile::open(const std::string &path, std::string &outMessage)
+{
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        outMessage = "Cannot open file: " + path;
+        return Status::IoError;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        outMessage = "Cannot stat file: " + path;
+        return Status::IoError;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        return Status::Ok;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file referenced on its own.
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        outMessage = "Cannot map file: " + path;
+        return Status::IoError;
+    }
+    bytes = static_cast<const uint8_t *>(view);
+    length = size;
+    return Status::Ok;
+}
+
+void MappedFile::close()
+{
+    if (bytes) {
+        munmap(const_cast<uint8_t *>(bytes), length);
+    }
+    bytes = nullptr;
+    length = 0;
+}
+
+#endif
+
+}  // namespace ct
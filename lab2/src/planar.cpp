@@ -0,0 +1,70 @@
+#include "planar.h"
+#include <cmath>
+#include <cstring>
+
+namespace ct
+{
+
+static_assert(sizeof(Bgr) == 3, "channel views step through Image pixels three bytes at a time");
+
+Half floatToHalf(float v)
+{
+    uint32_t x;
+    std::memcpy(&x, &v, sizeof x);
+    const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+    const uint32_t mag = x & 0x7fffffff;
+    if (mag >= 0x7f800000) {
+        // Infinity stays infinity; NaN stays a (quiet) NaN.
+        return Half{static_cast<uint16_t>(sign | 0x7c00 | (mag > 0x7f800000 ? 0x0200 : 0))};
+    }
+    if (mag >= 0x477ff000) {
+        // 65520 and up round past the largest half.
+        return Half{static_cast<uint16_t>(sign | 0x7c00)};
+    }
+    if (mag < 0x38800000) {
+        // Below 2^-14 the half is subnormal: a multiple of 2^-24, rounded to nearest even by the FPU.
+        float a;
+        std::memcpy(&a, &mag, sizeof a);
+        return Half{static_cast<uint16_t>(sign | static_cast<uint16_t>(std::nearbyint(a * 16777216.0f)))};
+    }
+    uint32_t h = ((mag >> 23) - 127 + 15) << 10 | (mag & 0x7fffff) >> 13;
+    const uint32_t rest = mag & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) {
+        ++h;  // a carry out of the mantissa correctly bumps the exponent
+    }
+    return Half{static_cast<uint16_t>(sign | h)};
+}
+
+float halfToFloat(Half h)
+{
+    const uint32_t sign = static_cast<uint32_t>(h.bits & 0x8000) << 16;
+    const uint32_t exp = (h.bits >> 10) & 0x1f;
+    const uint32_t mant = h.bits & 0x3ff;
+    if (exp == 0) {
+        const float v = static_cast<float>(mant) * (1.0f / 16777216.0f);
+        return sign ? -v : v;
+    }
+    const uint32_t bits = exp == 31 ? sign | 0x7f800000 | mant << 13 : sign | (exp - 15 + 127) << 23 | mant << 13;
+    float v;
+    std::memcpy(&v, &bits, sizeof v);
+    return v;
+}
+
+// Bgr is stored b, g, r; channel c = 0 (R) sits at byte 2.
+static ptrdiff_t channelOffset(int c)
+{
+    return 2 - c;
+}
+
+PlaneView<const uint8_t> channelView(const ImageView &img, int c)
+{
+    return PlaneView<const uint8_t>{img.data + channelOffset(c), img.width, img.height, 3, img.rowStride};
+}
+
+PlaneView<uint8_t> channelView(Image &img, int c)
+{
+    uint8_t *base = reinterpret_cast<uint8_t *>(img.pixels.data());
+    return PlaneView<uint8_t>{base + channelOffset(c), img.width, img.height, 3, 3 * static_cast<ptrdiff_t>(img.width)};
+}
+
+}  // namespace ct
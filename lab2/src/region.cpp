@@ -1,4 +1,5 @@
 #include "region.h"
+#include <algorithm>
 #include <cmath>
 
 namespace ct
@@ -68,7 +69,18 @@ void applyBrushes(RegionMask &m, const std::vector<Brush> &brushes)
     }
 }
 
-Status saveMaskBmp(const std::string &path, const RegionMask &m, std::string &outMessage)
+RegionMask makeBrushMaskRows(uint32_t width, uint32_t y, uint32_t rows, const std::vector<Brush> &brushes)
+{
+    RegionMask m = makeEmptyMask(width, rows);
+    for (Brush b : brushes) {
+        b.y -= static_cast<int>(y);
+        b.cy -= static_cast<int>(y);
+        applyBrush(m, b);
+    }
+    return m;
+}
+
+static Image maskToImage(const RegionMask &m)
 {
     Image img;
     img.width = m.width;
@@ -78,7 +90,36 @@ Status saveMaskBmp(const std::string &path, const RegionMask &m, std::string &ou
         uint8_t v = m.bytes[i] ? 255 : 0;
         img.pixels[i] = Bgr{v, v, v};
     }
-    return saveBmp(path, img, outMessage);
+    return img;
+}
+
+Status saveMaskBmp(const std::string &path, const RegionMask &m, std::string &outMessage)
+{
+    return saveBmp(path, maskToImage(m), outMessage);
+}
+
+Status saveMaskBmp(const std::string &path,
+                   uint32_t width,
+                   uint32_t height,
+                   const std::vector<Brush> &brushes,
+                   uint32_t bandRows,
+                   std::string &outMessage)
+{
+    if (bandRows == 0) {
+        bandRows = height;
+    }
+    BmpWriter writer;
+    Status st = writer.open(path, width, height, outMessage);
+    // Bottom band first, as the rows are stored.
+    for (uint32_t end = height; st == Status::Ok && end > 0;) {
+        const uint32_t rows = std::min(bandRows, end);
+        end -= rows;
+        st = writer.writeBand(maskToImage(makeBrushMaskRows(width, end, rows, brushes)), outMessage);
+    }
+    if (st == Status::Ok) {
+        st = writer.close(outMessage);
+    }
+    return st;
 }
 
 }  // namespace ct
@@ -0,0 +1,207 @@
+#include "stats_cache.h"
+#include "lab_simd.h"
+#include "mapped_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace ct
+{
+
+namespace fs = std::filesystem;
+
+static const std::string ENTRY_MAGIC = "ct-source-stats 1";
+static const std::string INDEX_MAGIC = "ct-source-path 1";
+
+std::string statsCacheTag(int lutGrid, bool simd, bool memoColors)
+{
+    std::string tag = lutGrid > 0 ? "lut" + std::to_string(lutGrid)
+                      : simd      ? std::string("simd-") + simdLevelName(simdLevel())
+                                  : "exact";
+    return memoColors ? tag : tag + "-nomemo";
+}
+
+static std::string hex64(uint64_t v)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+
+// Doubles are stored as hex floats, which read back exactly.
+static std::string hexDouble(double v)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%a", v);
+    return buf;
+}
+
+static bool parseHexDouble(const std::string &s, double &out)
+{
+    char *end = nullptr;
+    out = std::strtod(s.c_str(), &end);
+    return end && *end == '\0' && end != s.c_str();
+}
+
+struct FileStamp {
+    uint64_t size{0};
+    int64_t mtime{0};
+};
+
+static bool stampOf(const fs::path &p, FileStamp &out)
+{
+    std::error_code ec;
+    out.size = fs::file_size(p, ec);
+    if (ec) {
+        return false;
+    }
+    out.mtime = static_cast<int64_t>(fs::last_write_time(p, ec).time_since_epoch().count());
+    return !ec;
+}
+
+// Writes `text` through a temporary file and a rename, so readers see the old file or the new one.
+static Status writeAtomically(const fs::path &path, const std::string &text, std::string &outMessage)
+{
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec) {
+        outMessage = "Cannot create cache directory: " + path.parent_path().string();
+        return Status::IoError;
+    }
+    std::random_device rd;
+    const fs::path tmp = path.string() + ".tmp" + hex64(uint64_t{rd()} << 32 | rd());
+    const Status st = writeFile(tmp.string(), std::vector<uint8_t>(text.begin(), text.end()), outMessage);
+    if (st == Status::Ok) {
+        fs::rename(tmp, path, ec);
+    }
+    if (st != Status::Ok || ec) {
+        std::error_code ignored;
+        fs::remove(tmp, ignored);
+        outMessage = st != Status::Ok ? outMessage : "Cannot write " + path.string();
+        return Status::IoError;
+    }
+    return Status::Ok;
+}
+
+StatsCache::StatsCache(std::string directory) : dir(std::move(directory)) {}
+
+Result<uint64_t> StatsCache::contentHash(const std::string &path) const
+{
+    Result<uint64_t> r;
+    std::error_code ec;
+    const fs::path abs = fs::absolute(path, ec).lexically_normal();
+    FileStamp stamp;
+    if (ec || !stampOf(abs, stamp)) {
+        r.status = Status::IoError;
+        r.message = "Cannot open file: " + path;
+        return r;
+    }
+    const std::string key = abs.string();
+    const fs::path indexPath =
+        fs::path(dir) / (hex64(hashBytes(reinterpret_cast<const uint8_t *>(key.data()), key.size())) + ".path");
+
+    FileData index = readFile(indexPath.string());
+    if (index.status == Status::Ok) {
+        std::istringstream in(std::string(index.bytes.begin(), index.bytes.end()));
+        std::string magic, hash, indexed;
+        FileStamp seen;
+        std::getline(in, magic);
+        in >> seen.size >> seen.mtime >> hash >> std::ws;
+        std::getline(in, indexed);
+        if (in && magic == INDEX_MAGIC && indexed == key && seen.size == stamp.size && seen.mtime == stamp.mtime) {
+            r.value = std::strtoull(hash.c_str(), nullptr, 16);
+            CT_DEBUG("StatsCache: " + key + " unchanged, hash " + hash);
+            return r;
+        }
+    }
+
+    MappedFile file;
+    r.status = file.open(abs.string(), r.message);
+    if (!r.ok()) {
+        return r;
+    }
+    r.value = hashBytes(file.data(), file.size());
+    CT_DEBUG("StatsCache: hashed " + key + " (" + std::to_string(file.size()) + " bytes): " + hex64(r.value));
+
+    // Only a file that did not change while it was read is recorded. Failing to record costs a
+    // rehash next time, nothing more.
+    FileStamp after;
+    if (stampOf(abs, after) && after.size == stamp.size && after.mtime == stamp.mtime) {
+        std::string ignored;
+        writeAtomically(indexPath,
+                        INDEX_MAGIC + "\n" + std::to_string(stamp.size) + " " + std::to_string(stamp.mtime) + " " +
+                            hex64(r.value) + "\n" + key + "\n",
+                        ignored);
+    }
+    return r;
+}
+
+static fs::path entryPath(const std::string &dir, uint64_t hash, const std::string &tag)
+{
+    return fs::path(dir) / (hex64(hash) + "-" + tag + ".stats");
+}
+
+static bool readVec(std::istream &in, const char *label, Vec3d &v)
+{
+    std::string name, x, y, z;
+    return (in >> name >> x >> y >> z) && name == label && parseHexDouble(x, v.x) && parseHexDouble(y, v.y) &&
+           parseHexDouble(z, v.z);
+}
+
+static bool readHistogram(std::istream &in, const char *label, H256 &h)
+{
+    std::string name;
+    if (!(in >> name) || name != label) {
+        return false;
+    }
+    for (auto &count : h) {
+        if (!(in >> count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StatsCache::load(uint64_t hash, const std::string &tag, SourceStats &out) const
+{
+    FileData fd = readFile(entryPath(dir, hash, tag).string());
+    if (fd.status != Status::Ok) {
+        return false;
+    }
+    std::istringstream in(std::string(fd.bytes.begin(), fd.bytes.end()));
+    std::string magic, name, entryTag;
+    std::getline(in, magic);
+    SourceStats s;
+    const bool ok = magic == ENTRY_MAGIC && (in >> name >> entryTag) && name == "tag" && entryTag == tag &&
+                    readVec(in, "mean", s.stats.mean) && readVec(in, "var", s.stats.var) &&
+                    readHistogram(in, "r", s.r) && readHistogram(in, "g", s.g) && readHistogram(in, "b", s.b);
+    if (!ok) {
+        CT_DEBUG("StatsCache: ignoring malformed entry " + entryPath(dir, hash, tag).string());
+        return false;
+    }
+    out = s;
+    return true;
+}
+
+Status StatsCache::store(uint64_t hash, const std::string &tag, const SourceStats &s, std::string &outMessage) const
+{
+    std::string text = ENTRY_MAGIC + "\ntag " + tag + "\n";
+    text += "mean " + hexDouble(s.stats.mean.x) + " " + hexDouble(s.stats.mean.y) + " " + hexDouble(s.stats.mean.z) +
+            "\n";
+    text += "var " + hexDouble(s.stats.var.x) + " " + hexDouble(s.stats.var.y) + " " + hexDouble(s.stats.var.z) + "\n";
+    const std::pair<const char *, const H256 *> histograms[] = {{"r", &s.r}, {"g", &s.g}, {"b", &s.b}};
+    for (const auto &[label, h] : histograms) {
+        text += label;
+        for (uint32_t count : *h) {
+            text += " " + std::to_string(count);
+        }
+        text += "\n";
+    }
+    return writeAtomically(entryPath(dir, hash, tag), text, outMessage);
+}
+
+}  // namespace ct
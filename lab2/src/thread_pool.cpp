@@ -0,0 +1,102 @@
+#include "thread_pool.h"
+
+namespace ct
+{
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    workers.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+    CT_DEBUG("ThreadPool: threads=" + std::to_string(threads));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : workers) {
+        t.join();
+    }
+}
+
+void ThreadPool::drain()
+{
+    const size_t count = jobChunks->size();
+    for (size_t i = nextChunk.fetch_add(1); i < count; i = nextChunk.fetch_add(1)) {
+        (*jobFn)(i, (*jobChunks)[i]);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    size_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            wake.wait(lk, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        drain();
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (--active == 0) {
+                done.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::run(const std::vector<Range> &chunks, const std::function<void(size_t, const Range &)> &fn)
+{
+    if (workers.empty() || chunks.size() < 2) {
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            fn(i, chunks[i]);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        jobChunks = &chunks;
+        jobFn = &fn;
+        nextChunk.store(0);
+        active = static_cast<unsigned>(workers.size());
+        ++generation;
+    }
+    wake.notify_all();
+    drain();
+    // Every worker checks in before returning, so none can still be looking at this job when the
+    // next one starts.
+    std::unique_lock<std::mutex> lk(mtx);
+    done.wait(lk, [&] { return active == 0; });
+    jobChunks = nullptr;
+    jobFn = nullptr;
+}
+
+void runChunks(ThreadPool *pool,
+               const std::vector<Range> &chunks,
+               const std::function<void(size_t, const Range &)> &fn)
+{
+    if (pool) {
+        pool->run(chunks, fn);
+        return;
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        fn(i, chunks[i]);
+    }
+}
+
+}  // namespace ct
@@ -76,6 +76,78 @@ std::vector<Range> makeChunks(size_t total, size_t targetChunkSize)
     return out;
 }
 
+static constexpr uint64_t XXH_P1 = 11400714785074694791ULL;
+static constexpr uint64_t XXH_P2 = 14029467366897019727ULL;
+static constexpr uint64_t XXH_P3 = 1609587929392839161ULL;
+static constexpr uint64_t XXH_P4 = 9650029242287828579ULL;
+static constexpr uint64_t XXH_P5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+    return rotl64(acc + input * XXH_P2, 31) * XXH_P1;
+}
+
+static inline uint64_t xxhMerge(uint64_t h, uint64_t v)
+{
+    return (h ^ xxhRound(0, v)) * XXH_P1 + XXH_P4;
+}
+
+uint64_t hashBytes(const uint8_t *data, size_t n, uint64_t seed)
+{
+    const uint8_t *p = data;
+    const uint8_t *const end = data + n;
+    uint64_t h;
+    if (n >= 32) {
+        uint64_t v1 = seed + XXH_P1 + XXH_P2, v2 = seed + XXH_P2, v3 = seed, v4 = seed - XXH_P1;
+        for (; end - p >= 32; p += 32) {
+            v1 = xxhRound(v1, read64(p));
+            v2 = xxhRound(v2, read64(p + 8));
+            v3 = xxhRound(v3, read64(p + 16));
+            v4 = xxhRound(v4, read64(p + 24));
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxhMerge(xxhMerge(xxhMerge(xxhMerge(h, v1), v2), v3), v4);
+    } else {
+        h = seed + XXH_P5;
+    }
+    h += n;
+    for (; end - p >= 8; p += 8) {
+        h = rotl64(h ^ xxhRound(0, read64(p)), 27) * XXH_P1 + XXH_P4;
+    }
+    if (end - p >= 4) {
+        h = rotl64(h ^ (read32(p) * XXH_P1), 23) * XXH_P2 + XXH_P3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h = rotl64(h ^ (*p * XXH_P5), 11) * XXH_P1;
+    }
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
 std::string toLower(std::string s)
 {
     std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return char(std::tolower(c)); });